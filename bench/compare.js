@@ -0,0 +1,51 @@
+// Compares two result files from bench/index.js, e.g. from the last release
+// and from the working tree:
+//
+//   node bench/compare.js before.json after.json [--threshold 0.1]
+//
+// Prints the change in p50 latency for every case in both files, and exits
+// with 1 if any case got slower by more than the threshold (10% by default).
+var fs = require('fs');
+
+var args = process.argv.slice(2)
+  , threshold = 0.1;
+
+var t = args.indexOf('--threshold');
+if (t !== -1) {
+  threshold = +args[t + 1];
+  args.splice(t, 2);
+}
+
+if (args.length !== 2) {
+  console.error('usage: node bench/compare.js before.json after.json [--threshold 0.1]');
+  process.exit(2);
+}
+
+function load(file){
+  var byName = {};
+  JSON.parse(fs.readFileSync(file, 'utf8')).results.forEach(function(r){
+    if (!r.error && r.latency) byName[r.suite + '/' + r.name] = r;
+  });
+  return byName;
+}
+
+var before = load(args[0])
+  , after = load(args[1])
+  , regressions = [];
+
+var changes = Object.keys(after).filter(function(name){
+  return before[name];
+}).map(function(name){
+  var change = after[name].latency.p50 / before[name].latency.p50 - 1;
+  if (change > threshold) regressions.push(name);
+  return {
+    name: name
+  , before: before[name].latency.p50
+  , after: after[name].latency.p50
+  , change: change
+  };
+});
+
+console.log(JSON.stringify({threshold: threshold, changes: changes,
+    regressions: regressions}, null, 2));
+process.exitCode = regressions.length ? 1 : 0;
@@ -0,0 +1,40 @@
+// findContours on an edge image, then per-contour metrics
+var Suite = require('./harness').Suite;
+
+var SOURCE = __dirname + '/../examples/files/coin1.jpg';
+
+module.exports = function(cv, cb){
+  cv.readImage(SOURCE, function(err, im){
+    if (err) return cb(err);
+
+    im.convertGrayscale();
+    im.canny(5, 300);
+
+    var contours = im.findContours()
+      , perContour = {contours: contours.size()}
+      , suite = new Suite('contours');
+
+    suite
+      .add('findContours', perContour, Suite.sync(function(){
+        im.clone().findContours();
+      }))
+      .add('metrics one call per contour', perContour, Suite.sync(function(){
+        for (var i = 0; i < contours.size(); i++) {
+          contours.area(i);
+          contours.arcLength(i, true);
+          contours.boundingRect(i);
+          contours.minAreaRect(i);
+          contours.isConvex(i);
+        }
+      }))
+      .add('metrics computeAll', perContour, Suite.sync(function(){
+        contours.computeAll({area: true, arcLength: true, bbox: true,
+            minAreaRect: true, isConvex: true});
+      }))
+      .add('toTypedArrays', perContour, Suite.sync(function(){
+        contours.toTypedArrays();
+      }));
+
+    cb(null, suite);
+  });
+};
@@ -0,0 +1,25 @@
+// Haar cascade face detection
+var Suite = require('./harness').Suite;
+
+var SOURCE = __dirname + '/../examples/files/mona.png'
+  , CASCADE = __dirname + '/../data/haarcascade_frontalface_alt.xml';
+
+module.exports = function(cv, cb){
+  cv.readImage(SOURCE, function(err, im){
+    if (err) return cb(err);
+
+    var classifier = new cv.CascadeClassifier(CASCADE)
+      , pixels = {pixels: im.width() * im.height()}
+      , suite = new Suite('detect');
+
+    suite
+      .add('detectMultiScale', {units: pixels}, function(done){
+        classifier.detectMultiScale(im, done);
+      })
+      .add('detectMultiScaleBatch x4', {units: {images: 4}}, function(done){
+        classifier.detectMultiScaleBatch([im, im, im, im], {}, done);
+      });
+
+    cb(null, suite);
+  });
+};
@@ -0,0 +1,156 @@
+// A small benchmark harness. Each case is run for a number of warmup
+// iterations, then timed for `iterations` runs one at a time (latency) and
+// again with `concurrency` runs in flight (throughput, for async cases).
+
+var DEFAULTS = {
+  warmup: 3
+, iterations: 30
+, concurrency: 1
+};
+
+function now(){
+  var t = process.hrtime();
+  return t[0] * 1e3 + t[1] / 1e6;
+}
+
+function percentile(sorted, p){
+  if (!sorted.length) return 0;
+  return sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))];
+}
+
+function summarize(samples){
+  var sorted = samples.slice().sort(function(a, b){ return a - b; })
+    , total = samples.reduce(function(a, b){ return a + b; }, 0);
+
+  return {
+    iterations: samples.length
+  , mean: total / samples.length
+  , min: sorted[0]
+  , p50: percentile(sorted, 0.5)
+  , p99: percentile(sorted, 0.99)
+  , max: sorted[sorted.length - 1]
+  };
+}
+
+// Calls fn(cb) `count` times, at most `concurrency` at once, and calls
+// done(err, samples) with the duration of each call in milliseconds.
+function runMany(fn, count, concurrency, done){
+  var started = 0
+    , finished = 0
+    , samples = []
+    , failed = false;
+
+  if (count <= 0) return done(null, samples);
+
+  function next(){
+    if (failed || started >= count) return;
+    started++;
+    var start = now();
+    fn(function(err){
+      if (failed) return;
+      if (err){
+        failed = true;
+        return done(err);
+      }
+      samples.push(now() - start);
+      if (++finished === count) return done(null, samples);
+      // Don't grow the stack on synchronous cases
+      setImmediate(next);
+    });
+  }
+
+  for (var i = 0; i < Math.min(concurrency, count); i++) next();
+}
+
+function Suite(name){
+  this.name = name;
+  this.cases = [];
+}
+
+// fn(cb) runs one iteration and calls cb(err). `units` optionally names
+// what an iteration processes (e.g. {pixels: w * h}) to report throughput
+// in those units per second as well as iterations per second.
+Suite.prototype.add = function(name, opts, fn){
+  if (typeof opts === 'function'){
+    fn = opts;
+    opts = {};
+  }
+  this.cases.push({name: name, opts: opts, fn: fn});
+  return this;
+};
+
+// Wraps a synchronous iteration as fn(cb)
+Suite.sync = function(fn){
+  return function(cb){
+    try {
+      fn();
+    } catch (e) {
+      return cb(e);
+    }
+    cb();
+  };
+};
+
+Suite.prototype.run = function(options, done){
+  var self = this
+    , results = []
+    , i = 0;
+
+  function next(){
+    if (i >= self.cases.length) return done(null, results);
+    var c = self.cases[i++]
+      , opts = {};
+
+    [DEFAULTS, options, c.opts].forEach(function(o){
+      Object.keys(o || {}).forEach(function(k){ opts[k] = o[k]; });
+    });
+
+    if (options.filter && !options.filter.test(self.name + '/' + c.name)) {
+      return next();
+    }
+
+    runCase(c, opts, function(err, result){
+      result.suite = self.name;
+      if (err) result.error = err.message || String(err);
+      results.push(result);
+      if (options.progress) options.progress(result);
+      next();
+    });
+  }
+
+  next();
+};
+
+function runCase(c, opts, done){
+  var result = {name: c.name};
+
+  runMany(c.fn, opts.warmup, 1, function(err){
+    if (err) return done(err, result);
+
+    runMany(c.fn, opts.iterations, 1, function(err, samples){
+      if (err) return done(err, result);
+      result.latency = summarize(samples);
+      result.opsPerSec = 1000 / result.latency.mean;
+
+      if (opts.concurrency <= 1) return finish();
+
+      var start = now();
+      runMany(c.fn, opts.iterations, opts.concurrency, function(err){
+        if (err) return done(err, result);
+        result.concurrency = opts.concurrency;
+        result.opsPerSec = opts.iterations * 1000 / (now() - start);
+        finish();
+      });
+    });
+  });
+
+  function finish(){
+    Object.keys(opts.units || {}).forEach(function(unit){
+      result[unit + 'PerSec'] = opts.units[unit] * result.opsPerSec;
+    });
+    done(null, result);
+  }
+}
+
+exports.Suite = Suite;
+exports.now = now;
@@ -0,0 +1,46 @@
+// readImage decode and toBuffer encode, from files and from Buffers
+var fs = require('fs')
+  , Suite = require('./harness').Suite;
+
+var JPEG = __dirname + '/../examples/files/car1.jpg'
+  , PNG = __dirname + '/../examples/files/mona.png';
+
+module.exports = function(cv, cb){
+  var jpeg = fs.readFileSync(JPEG)
+    , png = fs.readFileSync(PNG);
+
+  cv.readImage(jpeg, function(err, im){
+    if (err) return cb(err);
+
+    var pixels = {pixels: im.width() * im.height()}
+      , suite = new Suite('image');
+
+    suite
+      .add('readImage jpeg file', {units: pixels}, function(done){
+        cv.readImage(JPEG, done);
+      })
+      .add('readImage jpeg buffer', {units: pixels}, function(done){
+        cv.readImage(jpeg, done);
+      })
+      .add('readImage jpeg buffer reduce 4', {units: pixels}, function(done){
+        cv.readImage(jpeg, {reduce: 4}, done);
+      })
+      .add('readImage png buffer', function(done){
+        cv.readImage(png, done);
+      })
+      .add('readImages jpeg x8', {units: {images: 8}}, function(done){
+        cv.readImages([jpeg, jpeg, jpeg, jpeg, jpeg, jpeg, jpeg, jpeg], done);
+      })
+      .add('toBuffer jpeg', {units: pixels}, Suite.sync(function(){
+        im.toBuffer({ext: '.jpg'});
+      }))
+      .add('toBuffer png', {units: pixels}, Suite.sync(function(){
+        im.toBuffer({ext: '.png'});
+      }))
+      .add('toBufferAsync jpeg', {units: pixels}, function(done){
+        im.toBufferAsync({ext: '.jpg'}, done);
+      });
+
+    cb(null, suite);
+  });
+};
@@ -0,0 +1,44 @@
+// Filters and conversions. Methods that work in place run on a clone of the
+// source, so "clone" is measured too, as the baseline to subtract.
+var Suite = require('./harness').Suite;
+
+var SOURCE = __dirname + '/../examples/files/car1.jpg';
+
+module.exports = function(cv, cb){
+  cv.readImage(SOURCE, function(err, im){
+    if (err) return cb(err);
+
+    var pixels = {pixels: im.width() * im.height()}
+      , half = [Math.round(im.width() / 2), Math.round(im.height() / 2)]
+      , suite = new Suite('imgproc');
+
+    suite
+      .add('clone', {units: pixels}, Suite.sync(function(){
+        im.clone();
+      }))
+      .add('gaussianBlur 5x5', {units: pixels}, Suite.sync(function(){
+        im.clone().gaussianBlur([5, 5]);
+      }))
+      .add('resize half', {units: pixels}, Suite.sync(function(){
+        im.clone().resize(half[0], half[1]);
+      }))
+      .add('cvtColor BGR2GRAY', {units: pixels}, Suite.sync(function(){
+        im.clone().cvtColor('CV_BGR2GRAY');
+      }))
+      .add('gaussianBlurAsync 5x5', {units: pixels}, function(done){
+        im.clone().gaussianBlurAsync([5, 5], done);
+      })
+      .add('resizeAsync half', {units: pixels}, function(done){
+        im.clone().resizeAsync(half[0], half[1], done);
+      })
+      .add('cvtColorAsync BGR2GRAY', {units: pixels}, function(done){
+        im.clone().cvtColorAsync('CV_BGR2GRAY', done);
+      })
+      .add('pipeline gray blur canny', {units: pixels}, function(done){
+        cv.pipeline().convertGrayscale().gaussianBlur([5, 5]).canny(5, 300)
+          .run(im, done);
+      });
+
+    cb(null, suite);
+  });
+};
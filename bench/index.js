@@ -0,0 +1,86 @@
+// Runs the benchmarks and prints the results as JSON on stdout, with
+// progress on stderr:
+//
+//   npm run bench -- [--iterations n] [--concurrency n] [--threads n]
+//                    [--filter regexp] [--out file] [suite...]
+//
+// Every case reports its latency in milliseconds (mean, min, p50, p99, max)
+// and its throughput in operations per second, plus pixels, frames, etc.
+// per second where that makes sense. Compare two runs with bench/compare.js.
+var fs = require('fs')
+  , os = require('os')
+  , cv = require('../lib/opencv');
+
+var SUITES = ['image', 'imgproc', 'detect', 'contours', 'video'];
+
+function parseArgs(argv){
+  var args = {suites: [], options: {}};
+  for (var i = 0; i < argv.length; i++) {
+    switch (argv[i]) {
+      case '--iterations': args.options.iterations = +argv[++i]; break;
+      case '--concurrency': args.options.concurrency = +argv[++i]; break;
+      case '--threads': args.threads = +argv[++i]; break;
+      case '--filter': args.options.filter = new RegExp(argv[++i]); break;
+      case '--out': args.out = argv[++i]; break;
+      default: args.suites.push(argv[i]);
+    }
+  }
+  if (!args.suites.length) args.suites = SUITES;
+  return args;
+}
+
+function main(){
+  var args = parseArgs(process.argv.slice(2))
+    , results = []
+    , i = 0;
+
+  if (args.threads) cv.setNumThreads(args.threads);
+
+  args.options.progress = function(result){
+    process.stderr.write(result.suite + '/' + result.name + ': ' +
+        (result.error ? 'error: ' + result.error :
+          result.opsPerSec.toFixed(1) + ' ops/s, p50 ' +
+          result.latency.p50.toFixed(2) + ' ms') + '\n');
+  };
+
+  function next(){
+    if (i >= args.suites.length) return finish();
+    var name = args.suites[i++];
+
+    require('./' + name)(cv, function(err, suite){
+      if (err) {
+        results.push({suite: name, error: err.message || String(err)});
+        return next();
+      }
+      suite.run(args.options, function(err, suiteResults){
+        results = results.concat(suiteResults);
+        next();
+      });
+    });
+  }
+
+  function finish(){
+    var report = {
+      date: new Date().toISOString()
+    , node: process.version
+    , platform: process.platform
+    , arch: process.arch
+    , cpus: os.cpus().length
+    , cpu: os.cpus().length ? os.cpus()[0].model : undefined
+    , threads: cv.getNumThreads()
+    , results: results
+    };
+    var json = JSON.stringify(report, null, 2) + '\n';
+
+    if (args.out) {
+      fs.writeFileSync(args.out, json);
+    } else {
+      process.stdout.write(json);
+    }
+    process.exitCode = results.some(function(r){ return r.error; }) ? 1 : 0;
+  }
+
+  next();
+}
+
+main();
@@ -0,0 +1,60 @@
+// Reading every frame of a short video. An iteration is the whole file.
+var Suite = require('./harness').Suite;
+
+var SOURCE = __dirname + '/../examples/files/motion.mov';
+
+function readAll(video, done){
+  video.read(function next(err, mat){
+    if (err) return done(err);
+    if (mat.empty()) return done();
+    video.read(next);
+  });
+}
+
+module.exports = function(cv, cb){
+  var frames = 0
+    , probe = new cv.VideoCapture(SOURCE);
+
+  probe.read(function count(err, mat){
+    if (err) return cb(err);
+    if (!mat.empty()) {
+      frames++;
+      return probe.read(count);
+    }
+    probe.release();
+
+    var perFrame = {units: {frames: frames}, iterations: 5, warmup: 1}
+      , suite = new Suite('video');
+
+    suite
+      .add('VideoCapture read', perFrame, function(done){
+        var video = new cv.VideoCapture(SOURCE);
+        readAll(video, function(err){
+          video.release();
+          done(err);
+        });
+      })
+      .add('VideoCapture read prefetched', perFrame, function(done){
+        var video = new cv.VideoCapture(SOURCE);
+        // 'block' so that every frame is read, as in the case above
+        video.startPrefetch({size: 4, policy: 'block'});
+        readAll(video, function(err){
+          video.stopPrefetch();
+          video.release();
+          done(err);
+        });
+      })
+      .add('VideoStream', perFrame, function(done){
+        var video = new cv.VideoCapture(SOURCE);
+        video.toStream()
+          .on('error', done)
+          .on('end', function(){
+            video.release();
+            done();
+          })
+          .resume();
+      });
+
+    cb(null, suite);
+  });
+};
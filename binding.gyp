@@ -5,12 +5,20 @@
 
       "sources": [
         "src/init.cc",
+        "src/AsyncBaseWorker.cc",
+        "src/ThreadPool.cc",
+        "src/OpStats.cc",
+        "src/OpTrace.cc",
         "src/Matrix.cc",
+        "src/MatrixPool.cc",
+        "src/MatOp.cc",
+        "src/Pipeline.cc",
         "src/OpenCV.cc",
         "src/CascadeClassifierWrap.cc",
         "src/Contours.cc",
         "src/Point.cc",
         "src/VideoCaptureWrap.cc",
+        "src/FramePrefetcher.cc",
         "src/CamShift.cc",
         "src/HighGUI.cc",
         "src/FaceRecognizer.cc",
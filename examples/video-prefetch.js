@@ -0,0 +1,25 @@
+var path = require('path'),
+    cv = require('../lib/opencv');
+
+// When opening a file, the full path must be passed to opencv
+var vid = new cv.VideoCapture(path.join(__dirname, 'files', 'motion.mov'));
+
+// Decode on a background thread while frames are processed here
+vid.startPrefetch({size: 8, policy: 'block'});
+
+var x = 0;
+var iter = function(){
+  vid.read(function(err, mat){
+    if (err) throw err;
+    if (mat.empty()){
+      vid.stopPrefetch();
+      return console.log('done,', x, 'frames');
+    }
+
+    x++;
+    mat.convertGrayscale();
+    console.log('>>', x, ': queued', vid.queueDepth());
+    iter();
+  });
+}
+iter();
@@ -1,5 +1,6 @@
-var Stream = require('stream').Stream
-  , Buffers = require('buffers')
+var Readable = require('stream').Readable
+  , Writable = require('stream').Writable
+  , Transform = require('stream').Transform
   , util = require('util')
   , path = require('path');
 
@@ -13,9 +14,16 @@ var Matrix = cv.Matrix
   , VideoStream;
 
 
+// Returns a promise when called without a callback
 Matrix.prototype.detectObject = function(classifier, opts, cb){
   var face_cascade;
+  if (typeof opts === 'function'){
+    cb = opts;
+    opts = null;
+  }
   opts = opts || {};
+  // One CascadeClassifier per file is enough: it keeps an instance per
+  // concurrent detection natively
   cv._detectObjectClassifiers = cv._detectObjectClassifiers || {};
 
   if (!(face_cascade = cv._detectObjectClassifiers[classifier])){
@@ -23,71 +31,148 @@ Matrix.prototype.detectObject = function(classifier, opts, cb){
     cv._detectObjectClassifiers[classifier] = face_cascade;
   }
 
-  face_cascade.detectMultiScale(this, cb, opts.scale, opts.neighbors
+  return face_cascade.detectMultiScale(this, cb, opts.scale, opts.neighbors
     , opts.min && opts.min[0], opts.min && opts.min[1]);
 }
 
 
-Matrix.prototype.inspect = function(){
-  var size = (this.size()||[]).join('x');
-  return "[ Matrix " + size + " ]";
+// Encodes the matrix on a worker thread and returns a Readable stream of the
+// encoded image, e.g. im.encodeStream({ext: '.jpg'}).pipe(res). Takes the
+// options of toBuffer, plus `chunkSize` (default 64KiB): the encoded Buffer
+// comes from native code without a copy and is pushed in slices of that size,
+// which share its memory.
+Matrix.prototype.encodeStream = function(opts){
+  opts = opts || {};
+  var stream = new Readable()
+    , chunkSize = opts.chunkSize || 65536
+    , encoded = null
+    , offset = 0
+    , reading = false;
+
+  function push(){
+    while (offset < encoded.length){
+      var chunk = encoded.slice(offset, offset + chunkSize);
+      offset += chunk.length;
+      if (!stream.push(chunk)) return;
+    }
+    stream.push(null);
+  }
+
+  stream._read = function(){
+    if (encoded) return push();
+    reading = true;
+  }
+
+  // Start encoding right away, rather than on the first read
+  this.toBufferAsync(opts).then(function(buf){
+    encoded = buf;
+    if (reading) push();
+  }, function(err){
+    stream.emit('error', err);
+  });
+
+  return stream;
 }
 
 
-ImageStream = cv.ImageStream = function(){
-  this.writable = true;
+// cv.pipeline() records Matrix operations and runs them all natively, in one
+// worker job, when `run` is called. The source matrix is left untouched;
+// intermediates are reused between steps and only the result comes back:
+//
+//   cv.pipeline().convertGrayscale().gaussianBlur([5, 5]).canny(5, 300)
+//     .dilate(2).findContours().run(im, function(err, contours){ ... })
+var Pipeline = cv.Pipeline = function(){
+  this.ops = [];
 }
-util.inherits(ImageStream, Stream);
 
+;['convertGrayscale', 'convertHSVscale', 'cvtColor', 'gaussianBlur'
+  , 'medianBlur', 'bilateralFilter', 'canny', 'dilate', 'erode', 'threshold'
+  , 'adaptiveThreshold', 'resize', 'warpAffine', 'warpPerspective', 'flip'
+  , 'equalizeHist', 'findContours'
+].forEach(function(name){
+  Pipeline.prototype[name] = function(){
+    this.ops.push({name: name, args: Array.prototype.slice.call(arguments)});
+    return this;
+  }
+});
 
-ImageStream.prototype.write = function(buf){
-  var self = this;
-  cv.readImage(buf, function(err, matrix){
-    if (err) return self.emit('error', err);
-    self.emit('data', matrix);
-  });
+// Returns a promise when called without a callback
+Pipeline.prototype.run = function(matrix, cb){
+  return cv._runPipeline(matrix, this.ops, cb);
+}
+
+cv.pipeline = function(){
+  return new Pipeline();
 }
 
 
-ImageDataStream = cv.ImageDataStream = function(){
-  this.data = Buffers([]);
-  this.writable = true;
+Matrix.prototype.inspect = function(){
+  return "[ Matrix " + this.rows + "x" + this.cols + " ]";
 }
-util.inherits(ImageDataStream, Stream);
 
 
-ImageDataStream.prototype.write = function(buf){
-  this.data.push(buf);
-  return true;
+// The streams below are object mode streams: each chunk is one image, frame
+// or detection. Work runs natively on worker threads, one chunk at a time, so
+// a slow consumer holds back the producer once `highWaterMark` chunks (4 by
+// default) are buffered, instead of piling up frames in memory.
+function streamOptions(opts){
+  return {objectMode: true, highWaterMark: opts.highWaterMark || 4};
+}
+
+
+// Transform: complete encoded images (Buffers) in, Matrices out. `opts` are
+// also passed to readImage, e.g. {maxDimension: 320} for thumbnails.
+ImageStream = cv.ImageStream = function(opts){
+  this.opts = opts || {};
+  Transform.call(this, streamOptions(this.opts));
+}
+util.inherits(ImageStream, Transform);
+
+
+ImageStream.prototype._transform = function(buf, encoding, cb){
+  cv.readImage(buf, this.opts, cb);
 }
 
 
-ImageDataStream.prototype.end = function(b){
+// Writable: takes the bytes of one image, in any number of chunks, and emits
+// 'load' with the decoded Matrix once it is ended.
+ImageDataStream = cv.ImageDataStream = function(opts){
   var self = this;
-  if (b) ImageStream.prototype.write.call(this, b);
+  this.opts = opts || {};
+  this.data = [];
+  Writable.call(this);
 
-  var buf = this.data.toBuffer();
-  cv.readImage(buf, function(err, im){
-    if (err) return self.emit('error', err);
-    self.emit('load', im);
+  this.on('finish', function(){
+    cv.readImage(Buffer.concat(self.data), self.opts, function(err, im){
+      self.data = [];
+      if (err) return self.emit('error', err);
+      self.emit('load', im);
+    });
   });
 }
+util.inherits(ImageDataStream, Writable);
 
 
+ImageDataStream.prototype._write = function(buf, encoding, cb){
+  this.data.push(buf);
+  cb();
+}
+
+
+// Transform: Matrices in, {objects, matrix} out, where `objects` are the
+// detections in `matrix`. `opts` are {scale, neighbors, min: [w, h]}.
 ObjectDetectionStream = cv.ObjectDetectionStream = function(cascade, opts){
   this.classifier = new cv.CascadeClassifier(cascade);
   this.opts = opts || {};
-  this.readable = true;
-  this.writable = true;
+  Transform.call(this, streamOptions(this.opts));
 }
-util.inherits(ObjectDetectionStream, Stream);
+util.inherits(ObjectDetectionStream, Transform);
 
 
-ObjectDetectionStream.prototype.write = function(m){
-  var self = this;
+ObjectDetectionStream.prototype._transform = function(m, encoding, cb){
   this.classifier.detectMultiScale(m, function(err, objs){
-    if (err) return self.emit('error', err);
-    self.emit('data', objs, m);
+    if (err) return cb(err);
+    cb(null, {objects: objs, matrix: m});
   }
   , this.opts.scale
   , this.opts.neighbors
@@ -96,42 +181,29 @@ ObjectDetectionStream.prototype.write = function(m){
 }
 
 
-VideoStream = cv.VideoStream = function(src){
+// Readable: the frames of a VideoCapture (or of a file or device to open).
+// Frames are only read while the consumer keeps up; the stream ends with the
+// video.
+VideoStream = cv.VideoStream = function(src, opts){
   if (!(src instanceof VideoCapture)) src = new VideoCapture(src);
   this.video = src;
-  this.readable = true;
-  this.paused = false;
+  Readable.call(this, streamOptions(opts || {}));
 }
-util.inherits(VideoStream, Stream);
+util.inherits(VideoStream, Readable);
 
 
-VideoStream.prototype.read = function(){
+VideoStream.prototype._read = function(){
   var self = this;
-  var frame = function(){
-    self.video.read(function(err, mat){
-      if (err) return self.emit('error', err);
-      self.emit('data', mat);
-      if (!self.paused) process.nextTick(frame);
-    })
-  }
-
-  frame();
-}
-
-
-VideoStream.prototype.pause = function(){
-  this.paused = true;
-}
-
-
-VideoStream.prototype.resume = function(){
-  this.paused = false;
-  this.read();
+  this.video.read(function(err, mat){
+    if (err) return self.emit('error', err);
+    if (mat.empty()) return self.push(null);
+    self.push(mat);
+  });
 }
 
 
-VideoCapture.prototype.toStream = function(){
-  return new VideoStream(this);
+VideoCapture.prototype.toStream = function(opts){
+  return new VideoStream(this, opts);
 }
 
 
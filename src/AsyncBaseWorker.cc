@@ -0,0 +1,133 @@
+#include "AsyncBaseWorker.h"
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include <nan.h>
+
+AsyncBaseWorker::AsyncBaseWorker(Nan::Callback *callback) :
+    Nan::AsyncWorker(callback),
+    errorFirst(true) {
+  if (callback == NULL) {
+    Nan::HandleScope scope;
+#if NODE_MAJOR_VERSION >= 4
+    Local<Promise::Resolver> resolver =
+        Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+#else
+    Local<Promise::Resolver> resolver =
+        Promise::Resolver::New(v8::Isolate::GetCurrent());
+#endif
+    SaveToPersistent("resolver", resolver);
+  }
+}
+
+Local<Value> AsyncBaseWorker::Queue(AsyncBaseWorker *worker) {
+  Nan::EscapableHandleScope scope;
+
+  Local<Value> promise = Nan::Undefined();
+  if (worker->callback == NULL) {
+    promise = worker->GetFromPersistent("resolver").As<Promise::Resolver>()->GetPromise();
+  }
+
+  ThreadPool::Queue(worker);
+
+  return scope.Escape(promise);
+}
+
+cv::Mat AsyncBaseWorker::PinMatrix(const std::string &key, Local<Object> matrix) {
+  Nan::HandleScope scope;
+
+  Matrix *im = Nan::ObjectWrap::Unwrap<Matrix>(matrix);
+  SaveToPersistent(key.c_str(), matrix);
+  if (imageSize.area() == 0) {
+    imageSize = im->mat.size();
+  }
+  // A matrix over user memory doesn't own its data; release() drops the
+  // matrix's hold on that buffer, so the worker holds it too.
+  if (!im->backing.IsEmpty()) {
+    SaveToPersistent((key + ".backing").c_str(), Nan::New(im->backing));
+  }
+
+  return im->mat;
+}
+
+Local<Value> AsyncBaseWorker::Result() {
+  Nan::EscapableHandleScope scope;
+  return scope.Escape(Nan::Undefined());
+}
+
+void AsyncBaseWorker::HandleOKCallback() {
+  Nan::HandleScope scope;
+
+  Local<Value> result = Result();
+
+  if (callback == NULL) {
+    Settle(true, result);
+    return;
+  }
+
+  Local<Value> argv[] = {
+    Nan::Null(),
+    result
+  };
+
+  Nan::TryCatch try_catch;
+  if (errorFirst) {
+    callback->Call(2, argv);
+  } else {
+    callback->Call(1, argv + 1);
+  }
+  if (try_catch.HasCaught()) {
+    Nan::FatalException(try_catch);
+  }
+}
+
+void AsyncBaseWorker::HandleErrorCallback() {
+  Nan::HandleScope scope;
+
+  Local<Value> error = Nan::Error(ErrorMessage());
+
+  if (callback == NULL) {
+    Settle(false, error);
+    return;
+  }
+
+  Local<Value> argv[] = {
+    error
+  };
+
+  Nan::TryCatch try_catch;
+  callback->Call(1, argv);
+  if (try_catch.HasCaught()) {
+    Nan::FatalException(try_catch);
+  }
+}
+
+void AsyncBaseWorker::Settle(bool resolve, Local<Value> value) {
+  Local<Promise::Resolver> resolver =
+      GetFromPersistent("resolver").As<Promise::Resolver>();
+
+#if NODE_MAJOR_VERSION >= 10
+  // Runs the microtask and nextTick queues on exit, like a MakeCallback would,
+  // so `then` handlers fire right away.
+  node::CallbackScope callback_scope(v8::Isolate::GetCurrent(),
+      Nan::New<Object>(), node::async_context());
+#endif
+
+#if NODE_MAJOR_VERSION >= 4
+  Local<Context> context = Nan::GetCurrentContext();
+  if (resolve) {
+    resolver->Resolve(context, value).IsJust();
+  } else {
+    resolver->Reject(context, value).IsJust();
+  }
+#else
+  if (resolve) {
+    resolver->Resolve(value);
+  } else {
+    resolver->Reject(value);
+  }
+#endif
+
+#if NODE_MAJOR_VERSION < 10
+  v8::Isolate::GetCurrent()->RunMicrotasks();
+#endif
+}
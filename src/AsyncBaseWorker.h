@@ -0,0 +1,50 @@
+#include "OpenCV.h"
+
+// Base class for the async workers in node-opencv.
+//
+// A worker delivers its result either to a Node-style callback, as
+// `callback(err, result)`, or, when it was created without a callback, by
+// settling a Promise that `Queue` hands back to JS. Subclasses implement
+// `Execute` as usual and override `Result` to build the value on the main
+// thread; errors set with `SetErrorMessage` become the callback's `err` or
+// the promise's rejection.
+class AsyncBaseWorker: public Nan::AsyncWorker {
+public:
+  // `callback` may be NULL, in which case the worker settles a promise.
+  explicit AsyncBaseWorker(Nan::Callback *callback);
+
+  // Queues the worker on node-opencv's ThreadPool. Returns the promise to return to JS, or undefined when
+  // the worker reports to a callback.
+  static Local<Value> Queue(AsyncBaseWorker *worker);
+
+  // The size of the image the worker works on, for tracing; empty if unknown
+  cv::Size ImageSize() const { return imageSize; }
+
+protected:
+  // Builds the result passed to the callback or promise. Runs on the main
+  // thread once `Execute` has succeeded.
+  virtual Local<Value> Result();
+
+  // Keeps a Matrix, and the buffer it may be built over, alive until the
+  // worker is destroyed, and returns a header for its current data. Workers
+  // read the returned cv::Mat, so JS can release or reassign the matrix (or
+  // start more work on it) while they run. The header shares the matrix's
+  // buffer without copying it. Sync methods that transform the image give
+  // the matrix a new buffer rather than write into it, so the worker keeps
+  // reading the data it started with; drawing and pixel setters still write
+  // in place.
+  cv::Mat PinMatrix(const std::string &key, Local<Object> matrix);
+
+  void HandleOKCallback();
+  void HandleErrorCallback();
+
+  // Some older APIs call back with only the result and no error argument.
+  bool errorFirst;
+
+  // Set by PinMatrix from the first matrix pinned; workers that produce an
+  // image (decoding, video reads) set it in Execute.
+  cv::Size imageSize;
+
+private:
+  void Settle(bool resolve, Local<Value> value);
+};
@@ -1,5 +1,6 @@
 #include "BackgroundSubtractor.h"
 #include "Matrix.h"
+#include "OpStats.h"
 #include <iostream>
 #include <nan.h>
 
@@ -20,10 +21,10 @@ void BackgroundSubtractorWrap::Init(Local<Object> target) {
   ctor->InstanceTemplate()->SetInternalFieldCount(1);
   ctor->SetClassName(Nan::New("BackgroundSubtractor").ToLocalChecked());
 
-  Nan::SetMethod(ctor, "createMOG", CreateMOG);
-  Nan::SetPrototypeMethod(ctor, "applyMOG", ApplyMOG);
+  OpStats::SetMethod(ctor, "BackgroundSubtractor.createMOG", CreateMOG);
+  OpStats::SetPrototypeMethod(ctor, "BackgroundSubtractor.applyMOG", ApplyMOG);
 
-  target->Set(Nan::New("BackgroundSubtractor").ToLocalChecked(), ctor->GetFunction());
+  Nan::Set(target, Nan::New("BackgroundSubtractor").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 }
 
 NAN_METHOD(BackgroundSubtractorWrap::New) {
@@ -56,7 +57,7 @@ NAN_METHOD(BackgroundSubtractorWrap::CreateMOG) {
   //   DOUBLE_FROM_ARGS(noiseSigma, 3)
   // }
 
-  Local<Object> n = Nan::New(BackgroundSubtractorWrap::constructor)->GetFunction()->NewInstance();
+  Local<Object> n = Nan::NewInstance(Nan::GetFunction(Nan::New(BackgroundSubtractorWrap::constructor)).ToLocalChecked()).ToLocalChecked();
 
   cv::Ptr<cv::BackgroundSubtractor> bg;
   BackgroundSubtractorWrap *pt = new BackgroundSubtractorWrap(bg);
@@ -74,24 +75,24 @@ NAN_METHOD(BackgroundSubtractorWrap::ApplyMOG) {
   if (info.Length() == 0) {
     argv[0] = Nan::New("Input image missing").ToLocalChecked();
     argv[1] = Nan::Null();
-    cb->Call(Nan::GetCurrentContext()->Global(), 2, argv);
+    Nan::Call(cb, Nan::GetCurrentContext()->Global(), 2, argv);
     return;
   }
 
   try {
     Local<Object> fgMask =
-        Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+        Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(fgMask);
 
     cv::Mat mat;
     if (Buffer::HasInstance(info[0])) {
-      uint8_t *buf = (uint8_t *) Buffer::Data(info[0]->ToObject());
-      unsigned len = Buffer::Length(info[0]->ToObject());
+      uint8_t *buf = (uint8_t *) Buffer::Data(Nan::To<Object>(info[0]).ToLocalChecked());
+      unsigned len = Buffer::Length(Nan::To<Object>(info[0]).ToLocalChecked());
       cv::Mat *mbuf = new cv::Mat(len, 1, CV_64FC1, buf);
       mat = cv::imdecode(*mbuf, -1);
       //mbuf->release();
     } else {
-      Matrix *_img = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+      Matrix *_img = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
       mat = (_img->mat).clone();
     }
 
@@ -103,13 +104,14 @@ NAN_METHOD(BackgroundSubtractorWrap::ApplyMOG) {
     self->subtractor->operator()(mat, _fgMask);
 
     img->mat = _fgMask;
+    img->SyncExternalMemory();
     mat.release();
 
     argv[0] = Nan::Null();
     argv[1] = fgMask;
 
     Nan::TryCatch try_catch;
-    cb->Call(Nan::GetCurrentContext()->Global(), 2, argv);
+    Nan::Call(cb, Nan::GetCurrentContext()->Global(), 2, argv);
 
     if (try_catch.HasCaught()) {
       Nan::FatalException(try_catch);
@@ -1,17 +1,19 @@
 #include "Calib3D.h"
 #include "Matrix.h"
+#include "OpStats.h"
 
 inline Local<Object> matrixFromMat(cv::Mat &input) {
   Local<Object> matrixWrap =
-      Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+      Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *matrix = Nan::ObjectWrap::Unwrap<Matrix>(matrixWrap);
   matrix->mat = input;
+  matrix->SyncExternalMemory();
 
   return matrixWrap;
 }
 
 inline cv::Mat matFromMatrix(Local<Value> matrix) {
-  Matrix* m = Nan::ObjectWrap::Unwrap<Matrix>(matrix->ToObject());
+  Matrix* m = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(matrix).ToLocalChecked());
   return m->mat;
 }
 
@@ -19,10 +21,10 @@ inline cv::Size sizeFromArray(Local<Value> jsArray) {
   cv::Size patternSize;
 
   if (jsArray->IsArray()) {
-    Local<Object> v8sz = jsArray->ToObject();
+    Local<Object> v8sz = Nan::To<Object>(jsArray).ToLocalChecked();
 
-    patternSize = cv::Size(v8sz->Get(0)->IntegerValue(),
-        v8sz->Get(1)->IntegerValue());
+    patternSize = cv::Size(Nan::To<int64_t>(Nan::Get(v8sz, 0).ToLocalChecked()).FromJust(),
+        Nan::To<int64_t>(Nan::Get(v8sz, 1).ToLocalChecked()).FromJust());
   } else {
     JSTHROW_TYPE("Size is not a valid array");
   }
@@ -33,13 +35,13 @@ inline cv::Size sizeFromArray(Local<Value> jsArray) {
 inline std::vector<cv::Point2f> points2fFromArray(Local<Value> array) {
   std::vector<cv::Point2f> points;
   if (array->IsArray()) {
-    Local<Array> pointsArray = Local<Array>::Cast(array->ToObject());
+    Local<Array> pointsArray = Local<Array>::Cast(Nan::To<Object>(array).ToLocalChecked());
 
     for (unsigned int i = 0; i < pointsArray->Length(); i++) {
-      Local<Object> pt = pointsArray->Get(i)->ToObject();
+      Local<Object> pt = Nan::To<Object>(Nan::Get(pointsArray, i).ToLocalChecked()).ToLocalChecked();
       points.push_back(
-          cv::Point2f(pt->Get(Nan::New<String>("x").ToLocalChecked())->ToNumber()->Value(),
-              pt->Get(Nan::New<String>("y").ToLocalChecked())->ToNumber()->Value()));
+          cv::Point2f(Nan::To<Number>(Nan::Get(pt, Nan::New<String>("x").ToLocalChecked()).ToLocalChecked()).ToLocalChecked()->Value(),
+              Nan::To<Number>(Nan::Get(pt, Nan::New<String>("y").ToLocalChecked()).ToLocalChecked()).ToLocalChecked()->Value()));
     }
   } else {
     JSTHROW_TYPE("Points not a valid array");
@@ -51,14 +53,14 @@ inline std::vector<cv::Point2f> points2fFromArray(Local<Value> array) {
 inline std::vector<cv::Point3f> points3fFromArray(Local<Value> array) {
   std::vector<cv::Point3f> points;
   if (array->IsArray()) {
-    Local<Array> pointsArray = Local<Array>::Cast(array->ToObject());
+    Local<Array> pointsArray = Local<Array>::Cast(Nan::To<Object>(array).ToLocalChecked());
 
     for (unsigned int i = 0; i < pointsArray->Length(); i++) {
-      Local<Object> pt = pointsArray->Get(i)->ToObject();
+      Local<Object> pt = Nan::To<Object>(Nan::Get(pointsArray, i).ToLocalChecked()).ToLocalChecked();
       points.push_back(
-          cv::Point3f(pt->Get(Nan::New<String>("x").ToLocalChecked())->ToNumber()->Value(),
-              pt->Get(Nan::New<String>("y").ToLocalChecked())->ToNumber()->Value(),
-              pt->Get(Nan::New<String>("z").ToLocalChecked())->ToNumber()->Value()));
+          cv::Point3f(Nan::To<Number>(Nan::Get(pt, Nan::New<String>("x").ToLocalChecked()).ToLocalChecked()).ToLocalChecked()->Value(),
+              Nan::To<Number>(Nan::Get(pt, Nan::New<String>("y").ToLocalChecked()).ToLocalChecked()).ToLocalChecked()->Value(),
+              Nan::To<Number>(Nan::Get(pt, Nan::New<String>("z").ToLocalChecked()).ToLocalChecked()).ToLocalChecked()->Value()));
     }
   } else {
     JSTHROW_TYPE("Must pass array of object points for each frame")
@@ -71,10 +73,10 @@ inline std::vector<std::vector<cv::Point2f> > points2fFromArrayOfArrays(
     Local<Value> array) {
   std::vector<std::vector<cv::Point2f> > points;
   if (array->IsArray()) {
-    Local<Array> pointsArray = Local<Array>::Cast(array->ToObject());
+    Local<Array> pointsArray = Local<Array>::Cast(Nan::To<Object>(array).ToLocalChecked());
 
     for (unsigned int i = 0; i < pointsArray->Length(); i++) {
-      points.push_back(points2fFromArray(pointsArray->Get(i)));
+      points.push_back(points2fFromArray(Nan::Get(pointsArray, i).ToLocalChecked()));
     }
   } else {
     JSTHROW_TYPE("Must pass array of object points for each frame")
@@ -87,10 +89,10 @@ inline std::vector<std::vector<cv::Point3f> > points3fFromArrayOfArrays(
     Local<Value> array) {
   std::vector<std::vector<cv::Point3f> > points;
   if (array->IsArray()) {
-    Local<Array> pointsArray = Local<Array>::Cast(array->ToObject());
+    Local<Array> pointsArray = Local<Array>::Cast(Nan::To<Object>(array).ToLocalChecked());
 
     for (unsigned int i = 0; i < pointsArray->Length(); i++) {
-      points.push_back(points3fFromArray(pointsArray->Get(i)));
+      points.push_back(points3fFromArray(Nan::Get(pointsArray, i).ToLocalChecked()));
     }
   } else {
     JSTHROW_TYPE("Must pass array of object points for each frame")
@@ -104,17 +106,17 @@ void Calib3D::Init(Local<Object> target) {
   Local<Object> obj = Nan::New<Object>();
   inner.Reset(obj);
 
-  Nan::SetMethod(obj, "findChessboardCorners", FindChessboardCorners);
-  Nan::SetMethod(obj, "drawChessboardCorners", DrawChessboardCorners);
-  Nan::SetMethod(obj, "calibrateCamera", CalibrateCamera);
-  Nan::SetMethod(obj, "solvePnP", SolvePnP);
-  Nan::SetMethod(obj, "getOptimalNewCameraMatrix", GetOptimalNewCameraMatrix);
-  Nan::SetMethod(obj, "stereoCalibrate", StereoCalibrate);
-  Nan::SetMethod(obj, "stereoRectify", StereoRectify);
-  Nan::SetMethod(obj, "computeCorrespondEpilines", ComputeCorrespondEpilines);
-  Nan::SetMethod(obj, "reprojectImageTo3d", ReprojectImageTo3D);
-
-  target->Set(Nan::New("calib3d").ToLocalChecked(), obj);
+  OpStats::SetMethod(obj, "calib3d.findChessboardCorners", FindChessboardCorners);
+  OpStats::SetMethod(obj, "calib3d.drawChessboardCorners", DrawChessboardCorners);
+  OpStats::SetMethod(obj, "calib3d.calibrateCamera", CalibrateCamera);
+  OpStats::SetMethod(obj, "calib3d.solvePnP", SolvePnP);
+  OpStats::SetMethod(obj, "calib3d.getOptimalNewCameraMatrix", GetOptimalNewCameraMatrix);
+  OpStats::SetMethod(obj, "calib3d.stereoCalibrate", StereoCalibrate);
+  OpStats::SetMethod(obj, "calib3d.stereoRectify", StereoRectify);
+  OpStats::SetMethod(obj, "calib3d.computeCorrespondEpilines", ComputeCorrespondEpilines);
+  OpStats::SetMethod(obj, "calib3d.reprojectImageTo3d", ReprojectImageTo3D);
+
+  Nan::Set(target, Nan::New("calib3d").ToLocalChecked(), obj);
 }
 
 // cv::findChessboardCorners
@@ -139,18 +141,18 @@ NAN_METHOD(Calib3D::FindChessboardCorners) {
 
     // Make the return value
     Local<Object> ret = Nan::New<Object>();
-    ret->Set(Nan::New<String>("found").ToLocalChecked(), Nan::New<Boolean>(found));
+    Nan::Set(ret, Nan::New<String>("found").ToLocalChecked(), Nan::New<Boolean>(found));
 
     Local<Array> cornersArray = Nan::New<Array>(corners.size());
     for (unsigned int i = 0; i < corners.size(); i++) {
       Local<Object> point_data = Nan::New<Object>();
-      point_data->Set(Nan::New<String>("x").ToLocalChecked(), Nan::New<Number>(corners[i].x));
-      point_data->Set(Nan::New<String>("y").ToLocalChecked(), Nan::New<Number>(corners[i].y));
+      Nan::Set(point_data, Nan::New<String>("x").ToLocalChecked(), Nan::New<Number>(corners[i].x));
+      Nan::Set(point_data, Nan::New<String>("y").ToLocalChecked(), Nan::New<Number>(corners[i].y));
 
-      cornersArray->Set(Nan::New<Number>(i), point_data);
+      Nan::Set(cornersArray, Nan::New<Number>(i), point_data);
     }
 
-    ret->Set(Nan::New<String>("corners").ToLocalChecked(), cornersArray);
+    Nan::Set(ret, Nan::New<String>("corners").ToLocalChecked(), cornersArray);
 
     info.GetReturnValue().Set(ret);
   } catch (cv::Exception &e) {
@@ -177,7 +179,7 @@ NAN_METHOD(Calib3D::DrawChessboardCorners) {
     std::vector<cv::Point2f> corners = points2fFromArray(info[2]);
 
     // Arg 3, pattern found boolean
-    bool patternWasFound = info[3]->ToBoolean()->Value();
+    bool patternWasFound = Nan::To<Boolean>(info[3]).ToLocalChecked()->Value();
 
     // Draw the corners
     cv::drawChessboardCorners(mat, patternSize, corners, patternWasFound);
@@ -226,15 +228,15 @@ NAN_METHOD(Calib3D::CalibrateCamera) {
     Local<Object> ret = Nan::New<Object>();
 
     // Reprojection error
-    ret->Set(Nan::New<String>("reprojectionError").ToLocalChecked(), Nan::New<Number>(error));
+    Nan::Set(ret, Nan::New<String>("reprojectionError").ToLocalChecked(), Nan::New<Number>(error));
 
     // K
     Local<Object> KMatrixWrap = matrixFromMat(K);
-    ret->Set(Nan::New<String>("K").ToLocalChecked(), KMatrixWrap);
+    Nan::Set(ret, Nan::New<String>("K").ToLocalChecked(), KMatrixWrap);
 
     // dist
     Local<Object> distMatrixWrap = matrixFromMat(dist);
-    ret->Set(Nan::New<String>("distortion").ToLocalChecked(), distMatrixWrap);
+    Nan::Set(ret, Nan::New<String>("distortion").ToLocalChecked(), distMatrixWrap);
 
     // Per frame R and t, skiping for now
 
@@ -280,11 +282,11 @@ NAN_METHOD(Calib3D::SolvePnP) {
 
     // rvec
     Local<Object> rMatrixWrap = matrixFromMat(rvec);
-    ret->Set(Nan::New<String>("rvec").ToLocalChecked(), rMatrixWrap);
+    Nan::Set(ret, Nan::New<String>("rvec").ToLocalChecked(), rMatrixWrap);
 
     // tvec
     Local<Object> tMatrixWrap = matrixFromMat(tvec);
-    ret->Set(Nan::New<String>("tvec").ToLocalChecked(), tMatrixWrap);
+    Nan::Set(ret, Nan::New<String>("tvec").ToLocalChecked(), tMatrixWrap);
 
     // Return
     info.GetReturnValue().Set(ret);
@@ -313,7 +315,7 @@ NAN_METHOD(Calib3D::GetOptimalNewCameraMatrix) {
     cv::Size imageSize = sizeFromArray(info[2]);
 
     // Arg 3 is the alpha free scaling parameter
-    double alpha = info[3]->ToNumber()->Value();
+    double alpha = Nan::To<Number>(info[3]).ToLocalChecked()->Value();
 
     // Arg 4, the new image size
     cv::Size newImageSize = sizeFromArray(info[4]);
@@ -410,14 +412,14 @@ NAN_METHOD(Calib3D::StereoCalibrate) {
     Local<Object> FMatrixWrap = matrixFromMat(F);
 
     // Add to return object
-    ret->Set(Nan::New<String>("K1").ToLocalChecked(), K1MatrixWrap);
-    ret->Set(Nan::New<String>("distortion1").ToLocalChecked(), d1MatrixWrap);
-    ret->Set(Nan::New<String>("K2").ToLocalChecked(), K2MatrixWrap);
-    ret->Set(Nan::New<String>("distortion2").ToLocalChecked(), d2MatrixWrap);
-    ret->Set(Nan::New<String>("R").ToLocalChecked(), RMatrixWrap);
-    ret->Set(Nan::New<String>("t").ToLocalChecked(), tMatrixWrap);
-    ret->Set(Nan::New<String>("E").ToLocalChecked(), EMatrixWrap);
-    ret->Set(Nan::New<String>("F").ToLocalChecked(), FMatrixWrap);
+    Nan::Set(ret, Nan::New<String>("K1").ToLocalChecked(), K1MatrixWrap);
+    Nan::Set(ret, Nan::New<String>("distortion1").ToLocalChecked(), d1MatrixWrap);
+    Nan::Set(ret, Nan::New<String>("K2").ToLocalChecked(), K2MatrixWrap);
+    Nan::Set(ret, Nan::New<String>("distortion2").ToLocalChecked(), d2MatrixWrap);
+    Nan::Set(ret, Nan::New<String>("R").ToLocalChecked(), RMatrixWrap);
+    Nan::Set(ret, Nan::New<String>("t").ToLocalChecked(), tMatrixWrap);
+    Nan::Set(ret, Nan::New<String>("E").ToLocalChecked(), EMatrixWrap);
+    Nan::Set(ret, Nan::New<String>("F").ToLocalChecked(), FMatrixWrap);
 
     // Return
     info.GetReturnValue().Set(ret);
@@ -471,11 +473,11 @@ NAN_METHOD(Calib3D::StereoRectify) {
     // Make the return object
     Local<Object> ret = Nan::New<Object>();
 
-    ret->Set(Nan::New<String>("R1").ToLocalChecked(), matrixFromMat(R1));
-    ret->Set(Nan::New<String>("R2").ToLocalChecked(), matrixFromMat(R2));
-    ret->Set(Nan::New<String>("P1").ToLocalChecked(), matrixFromMat(P1));
-    ret->Set(Nan::New<String>("P2").ToLocalChecked(), matrixFromMat(P2));
-    ret->Set(Nan::New<String>("Q").ToLocalChecked(), matrixFromMat(Q));
+    Nan::Set(ret, Nan::New<String>("R1").ToLocalChecked(), matrixFromMat(R1));
+    Nan::Set(ret, Nan::New<String>("R2").ToLocalChecked(), matrixFromMat(R2));
+    Nan::Set(ret, Nan::New<String>("P1").ToLocalChecked(), matrixFromMat(P1));
+    Nan::Set(ret, Nan::New<String>("P2").ToLocalChecked(), matrixFromMat(P2));
+    Nan::Set(ret, Nan::New<String>("Q").ToLocalChecked(), matrixFromMat(Q));
 
     // Return the rectification parameters
     info.GetReturnValue().Set(ret);
@@ -497,7 +499,7 @@ NAN_METHOD(Calib3D::ComputeCorrespondEpilines) {
     std::vector<cv::Point2f> points = points2fFromArray(info[0]);
 
     // Arg1, the image index (1 or 2)
-    int whichImage = int(info[1]->ToNumber()->Value());
+    int whichImage = int(Nan::To<Number>(info[1]).ToLocalChecked()->Value());
 
     // Arg2, the fundamental matrix
     cv::Mat F = matFromMatrix(info[2]);
@@ -511,11 +513,11 @@ NAN_METHOD(Calib3D::ComputeCorrespondEpilines) {
     for(unsigned int i = 0; i < lines.size(); i++)
     {
       Local<Object> line_data = Nan::New<Object>();
-      line_data->Set(Nan::New<String>("a").ToLocalChecked(), Nan::New<Number>(lines[i][0]));
-      line_data->Set(Nan::New<String>("b").ToLocalChecked(), Nan::New<Number>(lines[i][1]));
-      line_data->Set(Nan::New<String>("c").ToLocalChecked(), Nan::New<Number>(lines[i][2]));
+      Nan::Set(line_data, Nan::New<String>("a").ToLocalChecked(), Nan::New<Number>(lines[i][0]));
+      Nan::Set(line_data, Nan::New<String>("b").ToLocalChecked(), Nan::New<Number>(lines[i][1]));
+      Nan::Set(line_data, Nan::New<String>("c").ToLocalChecked(), Nan::New<Number>(lines[i][2]));
 
-      linesArray->Set(Nan::New<Number>(i), line_data);
+      Nan::Set(linesArray, Nan::New<Number>(i), line_data);
     }
 
     // Return the lines
@@ -1,5 +1,6 @@
 #include "CamShift.h"
 #include "OpenCV.h"
+#include "OpStats.h"
 #include "Matrix.h"
 
 #if CV_MAJOR_VERSION >= 3
@@ -25,9 +26,9 @@ void TrackedObject::Init(Local<Object> target) {
   // Prototype
   // Local<ObjectTemplate> proto = constructor->PrototypeTemplate();
 
-  Nan::SetPrototypeMethod(ctor, "track", Track);
+  OpStats::SetPrototypeMethod(ctor, "TrackedObject.track", Track);
 
-  target->Set(Nan::New("TrackedObject").ToLocalChecked(), ctor->GetFunction());
+  Nan::Set(target, Nan::New("TrackedObject").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 }
 
 NAN_METHOD(TrackedObject::New) {
@@ -37,26 +38,26 @@ NAN_METHOD(TrackedObject::New) {
     JSTHROW_TYPE("Cannot Instantiate without new")
   }
 
-  Matrix* m = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix* m = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
   cv::Rect r;
   int channel = CHANNEL_HUE;
 
   if (info[1]->IsArray()) {
-    Local<Object> v8rec = info[1]->ToObject();
+    Local<Object> v8rec = Nan::To<Object>(info[1]).ToLocalChecked();
     r = cv::Rect(
-        v8rec->Get(0)->IntegerValue(),
-        v8rec->Get(1)->IntegerValue(),
-        v8rec->Get(2)->IntegerValue() - v8rec->Get(0)->IntegerValue(),
-        v8rec->Get(3)->IntegerValue() - v8rec->Get(1)->IntegerValue());
+        Nan::To<int64_t>(Nan::Get(v8rec, 0).ToLocalChecked()).FromJust(),
+        Nan::To<int64_t>(Nan::Get(v8rec, 1).ToLocalChecked()).FromJust(),
+        Nan::To<int64_t>(Nan::Get(v8rec, 2).ToLocalChecked()).FromJust() - Nan::To<int64_t>(Nan::Get(v8rec, 0).ToLocalChecked()).FromJust(),
+        Nan::To<int64_t>(Nan::Get(v8rec, 3).ToLocalChecked()).FromJust() - Nan::To<int64_t>(Nan::Get(v8rec, 1).ToLocalChecked()).FromJust());
   } else {
     JSTHROW_TYPE("Must pass rectangle to track")
   }
 
   if (info[2]->IsObject()) {
-    Local<Object> opts = info[2]->ToObject();
+    Local<Object> opts = Nan::To<Object>(info[2]).ToLocalChecked();
 
-    if (opts->Get(Nan::New("channel").ToLocalChecked())->IsString()) {
-      v8::String::Utf8Value c(opts->Get(Nan::New("channel").ToLocalChecked())->ToString());
+    if (Nan::Get(opts, Nan::New("channel").ToLocalChecked()).ToLocalChecked()->IsString()) {
+      Nan::Utf8String c(Nan::To<String>(Nan::Get(opts, Nan::New("channel").ToLocalChecked()).ToLocalChecked()).ToLocalChecked());
       std::string cc = std::string(*c);
 
       if (cc == "hue" || cc == "h") {
@@ -125,7 +126,7 @@ NAN_METHOD(TrackedObject::Track) {
     return;
   }
 
-  Matrix *im = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *im = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
   cv::RotatedRect r;
 
   if ((self->prev_rect.x < 0) || (self->prev_rect.y < 0)
@@ -160,10 +161,10 @@ NAN_METHOD(TrackedObject::Track) {
 
   v8::Local<v8::Array> arr = Nan::New<Array>(4);
 
-  arr->Set(0, Nan::New<Number>(bounds.x));
-  arr->Set(1, Nan::New<Number>(bounds.y));
-  arr->Set(2, Nan::New<Number>(bounds.x + bounds.width));
-  arr->Set(3, Nan::New<Number>(bounds.y + bounds.height));
+  Nan::Set(arr, 0, Nan::New<Number>(bounds.x));
+  Nan::Set(arr, 1, Nan::New<Number>(bounds.y));
+  Nan::Set(arr, 2, Nan::New<Number>(bounds.x + bounds.width));
+  Nan::Set(arr, 3, Nan::New<Number>(bounds.y + bounds.height));
 
   /*
   cv::Point2f pts[4];
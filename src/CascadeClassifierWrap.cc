@@ -1,7 +1,11 @@
 #include "CascadeClassifierWrap.h"
 #include "OpenCV.h"
+#include "OpStats.h"
 #include "Matrix.h"
+#include "AsyncBaseWorker.h"
+#include "ThreadPool.h"
 #include <nan.h>
+#include <sstream>
 
 Nan::Persistent<FunctionTemplate> CascadeClassifierWrap::constructor;
 
@@ -16,9 +20,10 @@ void CascadeClassifierWrap::Init(Local<Object> target) {
   // Prototype
   // Local<ObjectTemplate> proto = constructor->PrototypeTemplate();
 
-  Nan::SetPrototypeMethod(ctor, "detectMultiScale", DetectMultiScale);
+  OpStats::SetPrototypeMethod(ctor, "CascadeClassifier.detectMultiScale", DetectMultiScale);
+  OpStats::SetPrototypeMethod(ctor, "CascadeClassifier.detectMultiScaleBatch", DetectMultiScaleBatch);
 
-  target->Set(Nan::New("CascadeClassifier").ToLocalChecked(), ctor->GetFunction());
+  Nan::Set(target, Nan::New("CascadeClassifier").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 }
 
 NAN_METHOD(CascadeClassifierWrap::New) {
@@ -35,42 +40,157 @@ NAN_METHOD(CascadeClassifierWrap::New) {
 
 CascadeClassifierWrap::CascadeClassifierWrap(v8::Value* fileName) {
   std::string filename;
-  filename = std::string(*Nan::Utf8String(fileName->ToString()));
+  filename = std::string(*Nan::Utf8String(Nan::To<String>(fileName).ToLocalChecked()));
 
-  if (!cc.load(filename.c_str())) {
+  classifiers = new ClassifierPool(filename);
+
+  // Load the first instance now, so a bad file is reported right away
+  cv::CascadeClassifier *cc = classifiers->Acquire();
+  if (!cc) {
     Nan::ThrowTypeError("Error loading file");
+  } else {
+    classifiers->Release(cc);
+  }
+}
+
+CascadeClassifierWrap::~CascadeClassifierWrap() {
+  classifiers->Unref();
+}
+
+ClassifierPool::ClassifierPool(const std::string &filename) :
+    filename(filename),
+    size(0),
+    refs(1) {
+  uv_mutex_init(&mutex);
+}
+
+ClassifierPool::~ClassifierPool() {
+  for (size_t i = 0; i < idle.size(); i++) {
+    delete idle[i];
+  }
+  uv_mutex_destroy(&mutex);
+}
+
+void ClassifierPool::Ref() {
+  uv_mutex_lock(&mutex);
+  refs++;
+  uv_mutex_unlock(&mutex);
+}
+
+void ClassifierPool::Unref() {
+  uv_mutex_lock(&mutex);
+  bool last = --refs == 0;
+  uv_mutex_unlock(&mutex);
+
+  if (last) {
+    delete this;
   }
 }
 
-class AsyncDetectMultiScale: public Nan::AsyncWorker {
+cv::CascadeClassifier* ClassifierPool::Acquire() {
+  uv_mutex_lock(&mutex);
+  cv::CascadeClassifier *classifier = NULL;
+  if (!idle.empty()) {
+    classifier = idle.back();
+    idle.pop_back();
+  }
+  uv_mutex_unlock(&mutex);
+
+  if (classifier) {
+    return classifier;
+  }
+
+  // Loading takes a while, so it happens outside the lock
+  classifier = new cv::CascadeClassifier();
+  if (!classifier->load(filename)) {
+    delete classifier;
+    return NULL;
+  }
+
+  uv_mutex_lock(&mutex);
+  size++;
+  uv_mutex_unlock(&mutex);
+
+  return classifier;
+}
+
+void ClassifierPool::Release(cv::CascadeClassifier *classifier) {
+  uv_mutex_lock(&mutex);
+  idle.push_back(classifier);
+  uv_mutex_unlock(&mutex);
+}
+
+unsigned int ClassifierPool::Size() {
+  uv_mutex_lock(&mutex);
+  unsigned int count = size;
+  uv_mutex_unlock(&mutex);
+  return count;
+}
+
+// Checks a classifier out of a pool for as long as it is in scope
+class ClassifierLease {
 public:
-  AsyncDetectMultiScale(Nan::Callback *callback, CascadeClassifierWrap *cc,
-      Matrix* im, double scale, int neighbors, int minw, int minh) :
-      Nan::AsyncWorker(callback),
-      cc(cc),
-      im(im),
+  explicit ClassifierLease(ClassifierPool *pool) :
+      pool(pool),
+      classifier(pool->Acquire()) {
+  }
+
+  ~ClassifierLease() {
+    if (classifier) {
+      pool->Release(classifier);
+    }
+  }
+
+  cv::CascadeClassifier* operator->() {
+    return classifier;
+  }
+
+  bool Loaded() {
+    return classifier != NULL;
+  }
+
+private:
+  ClassifierPool *pool;
+  cv::CascadeClassifier *classifier;
+};
+
+class AsyncDetectMultiScale: public AsyncBaseWorker {
+public:
+  AsyncDetectMultiScale(Nan::Callback *callback, ClassifierPool *classifiers,
+      Local<Object> matrix, double scale, int neighbors, int minw, int minh) :
+      AsyncBaseWorker(callback),
+      classifiers(classifiers),
       scale(scale),
       neighbors(neighbors),
       minw(minw),
       minh(minh) {
+    image = PinMatrix("matrix", matrix);
+    classifiers->Ref();
   }
-  
+
   ~AsyncDetectMultiScale() {
+    classifiers->Unref();
   }
 
   void Execute() {
+    ClassifierLease cc(classifiers);
+    if (!cc.Loaded()) {
+      SetErrorMessage("Error loading file");
+      return;
+    }
+
     try {
       std::vector < cv::Rect > objects;
 
       cv::Mat gray;
 
-      if (this->im->mat.channels() != 1) {
-        cvtColor(this->im->mat, gray, CV_BGR2GRAY);
+      if (image.channels() != 1) {
+        cvtColor(image, gray, CV_BGR2GRAY);
         equalizeHist(gray, gray);
       } else {
-        gray = this->im->mat;
+        gray = image;
       }
-      this->cc->cc.detectMultiScale(gray, objects, this->scale, this->neighbors,
+      cc->detectMultiScale(gray, objects, this->scale, this->neighbors,
           0 | CV_HAAR_SCALE_IMAGE, cv::Size(this->minw, this->minh));
       res = objects;
     } catch (cv::Exception& e) {
@@ -78,35 +198,26 @@ public:
     }
   }
 
-  void HandleOKCallback() {
-    Nan::HandleScope scope;
-    //  this->matrix->Unref();
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
 
-    Local < Value > argv[2];
     v8::Local < v8::Array > arr = Nan::New < v8::Array > (this->res.size());
 
     for (unsigned int i = 0; i < this->res.size(); i++) {
       v8::Local < v8::Object > x = Nan::New<v8::Object>();
-      x->Set(Nan::New("x").ToLocalChecked(), Nan::New < Number > (this->res[i].x));
-      x->Set(Nan::New("y").ToLocalChecked(), Nan::New < Number > (this->res[i].y));
-      x->Set(Nan::New("width").ToLocalChecked(), Nan::New < Number > (this->res[i].width));
-      x->Set(Nan::New("height").ToLocalChecked(), Nan::New < Number > (this->res[i].height));
-      arr->Set(i, x);
+      Nan::Set(x, Nan::New("x").ToLocalChecked(), Nan::New < Number > (this->res[i].x));
+      Nan::Set(x, Nan::New("y").ToLocalChecked(), Nan::New < Number > (this->res[i].y));
+      Nan::Set(x, Nan::New("width").ToLocalChecked(), Nan::New < Number > (this->res[i].width));
+      Nan::Set(x, Nan::New("height").ToLocalChecked(), Nan::New < Number > (this->res[i].height));
+      Nan::Set(arr, i, x);
     }
 
-    argv[0] = Nan::Null();
-    argv[1] = arr;
-
-    Nan::TryCatch try_catch;
-    callback->Call(2, argv);
-    if (try_catch.HasCaught()) {
-      Nan::FatalException(try_catch);
-    }
+    return scope.Escape(arr);
   }
 
 private:
-  CascadeClassifierWrap *cc;
-  Matrix* im;
+  ClassifierPool *classifiers;
+  cv::Mat image;
   double scale;
   int neighbors;
   int minw;
@@ -119,33 +230,206 @@ NAN_METHOD(CascadeClassifierWrap::DetectMultiScale) {
 
   CascadeClassifierWrap *self = Nan::ObjectWrap::Unwrap<CascadeClassifierWrap> (info.This());
 
-  if (info.Length() < 2) {
-    Nan::ThrowTypeError("detectMultiScale takes at least 2 info");
+  if (info.Length() < 1) {
+    return Nan::ThrowTypeError("detectMultiScale takes at least 1 argument");
   }
 
-  Matrix *im = Nan::ObjectWrap::Unwrap < Matrix > (info[0]->ToObject());
-  REQ_FUN_ARG(1, cb);
+  if (!info[0]->IsObject() || !Nan::New(Matrix::constructor)->HasInstance(info[0])) {
+    return Nan::ThrowTypeError("detectMultiScale takes a Matrix");
+  }
 
   double scale = 1.1;
   if (info.Length() > 2 && info[2]->IsNumber()) {
-    scale = info[2]->NumberValue();
+    scale = Nan::To<double>(info[2]).FromJust();
   }
 
   int neighbors = 2;
   if (info.Length() > 3 && info[3]->IsInt32()) {
-    neighbors = info[3]->IntegerValue();
+    neighbors = Nan::To<int64_t>(info[3]).FromJust();
   }
 
   int minw = 30;
   int minh = 30;
   if (info.Length() > 5 && info[4]->IsInt32() && info[5]->IsInt32()) {
-    minw = info[4]->IntegerValue();
-    minh = info[5]->IntegerValue();
+    minw = Nan::To<int64_t>(info[4]).FromJust();
+    minh = Nan::To<int64_t>(info[5]).FromJust();
+  }
+
+  // Without a callback, detectMultiScale returns a promise
+  OPT_FUN_ARG(1, callback);
+
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(
+      new AsyncDetectMultiScale(callback, self->classifiers, Nan::To<Object>(info[0]).ToLocalChecked(), scale,
+          neighbors, minw, minh)));
+}
+
+// Detects over a batch of images. Each thread taking part checks out a
+// classifier of its own for the whole batch.
+class DetectBatchJob: public ParallelJob {
+public:
+  DetectBatchJob(ClassifierPool *classifiers, const std::vector<cv::Mat> &images,
+      double scale, int neighbors, cv::Size minSize) :
+      ParallelJob(images.size()),
+      classifiers(classifiers),
+      images(images),
+      scale(scale),
+      neighbors(neighbors),
+      minSize(minSize),
+      results(images.size()) {
+  }
+
+  void Run() {
+    ClassifierLease cc(classifiers);
+    if (!cc.Loaded()) {
+      SetError("Error loading file");
+      return;
+    }
+
+    cv::Mat gray;
+    for (int i = Next(); i >= 0; i = Next()) {
+      try {
+        if (images[i].channels() != 1) {
+          cv::cvtColor(images[i], gray, CV_BGR2GRAY);
+          cv::equalizeHist(gray, gray);
+          cc->detectMultiScale(gray, results[i], scale, neighbors,
+              0 | CV_HAAR_SCALE_IMAGE, minSize);
+        } else {
+          cc->detectMultiScale(images[i], results[i], scale, neighbors,
+              0 | CV_HAAR_SCALE_IMAGE, minSize);
+        }
+      } catch (cv::Exception& e) {
+        SetError(e.what());
+      }
+    }
+  }
+
+  std::vector<std::vector<cv::Rect> >& Results() {
+    return results;
+  }
+
+private:
+  ClassifierPool *classifiers;
+  const std::vector<cv::Mat> &images;
+  double scale;
+  int neighbors;
+  cv::Size minSize;
+  std::vector<std::vector<cv::Rect> > results;
+};
+
+class AsyncDetectMultiScaleBatch: public AsyncBaseWorker {
+public:
+  AsyncDetectMultiScaleBatch(Nan::Callback *callback, Local<Array> matrices,
+      ClassifierPool *classifiers, double scale, int neighbors,
+      cv::Size minSize) :
+      AsyncBaseWorker(callback),
+      classifiers(classifiers),
+      scale(scale),
+      neighbors(neighbors),
+      minSize(minSize) {
+    // Pinned one by one, as JS may change the array while detection runs
+    for (uint32_t i = 0; i < matrices->Length(); i++) {
+      std::ostringstream key;
+      key << "matrix" << i;
+      images.push_back(PinMatrix(key.str(), Nan::To<Object>(Nan::Get(matrices, i).ToLocalChecked()).ToLocalChecked()));
+    }
+    classifiers->Ref();
+  }
+
+  ~AsyncDetectMultiScaleBatch() {
+    classifiers->Unref();
+  }
+
+  void Execute() {
+    DetectBatchJob job(classifiers, images, scale, neighbors, minSize);
+    ThreadPool::ParallelFor(job);
+
+    std::string error = job.Error();
+    if (!error.empty()) {
+      SetErrorMessage(error.c_str());
+      return;
+    }
+    res.swap(job.Results());
   }
 
-  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
+  // One [imageIndex, x, y, width, height] row per detection
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
+
+    size_t count = 0;
+    for (size_t i = 0; i < res.size(); i++) {
+      count += res[i].size();
+    }
+
+    int32_t *data;
+    Local<Object> arr = OpenCV::NewTypedArray(CV_32S, count * 5, (void**) &data);
+    for (size_t i = 0; i < res.size(); i++) {
+      for (size_t j = 0; j < res[i].size(); j++) {
+        *data++ = (int32_t) i;
+        *data++ = res[i][j].x;
+        *data++ = res[i][j].y;
+        *data++ = res[i][j].width;
+        *data++ = res[i][j].height;
+      }
+    }
+
+    return scope.Escape(arr);
+  }
+
+private:
+  ClassifierPool *classifiers;
+  std::vector<cv::Mat> images;
+  double scale;
+  int neighbors;
+  cv::Size minSize;
+  std::vector<std::vector<cv::Rect> > res;
+};
+
+// classifier.detectMultiScaleBatch(matrices[, {scale, neighbors, min: [w, h]}][, callback])
+NAN_METHOD(CascadeClassifierWrap::DetectMultiScaleBatch) {
+  Nan::HandleScope scope;
+
+  CascadeClassifierWrap *self = Nan::ObjectWrap::Unwrap<CascadeClassifierWrap> (info.This());
+
+  if (info.Length() < 1 || !info[0]->IsArray()) {
+    return Nan::ThrowTypeError("detectMultiScaleBatch takes an array of matrices");
+  }
+
+  Local<Array> matrices = info[0].As<Array>();
+  for (uint32_t i = 0; i < matrices->Length(); i++) {
+    Local<Value> item = Nan::Get(matrices, i).ToLocalChecked();
+    if (!item->IsObject() || !Nan::New(Matrix::constructor)->HasInstance(item)) {
+      return Nan::ThrowTypeError("detectMultiScaleBatch takes an array of matrices");
+    }
+  }
+
+  double scale = 1.1;
+  int neighbors = 2;
+  cv::Size minSize(30, 30);
+  int callbackIndex = 1;
+  if (info.Length() > 1 && info[1]->IsObject() && !info[1]->IsFunction()) {
+    Local<Object> options = Nan::To<Object>(info[1]).ToLocalChecked();
+    Local<Value> value = Nan::Get(options, Nan::New("scale").ToLocalChecked()).ToLocalChecked();
+    if (value->IsNumber()) {
+      scale = Nan::To<double>(value).FromJust();
+    }
+    value = Nan::Get(options, Nan::New("neighbors").ToLocalChecked()).ToLocalChecked();
+    if (value->IsInt32()) {
+      neighbors = Nan::To<int64_t>(value).FromJust();
+    }
+    value = Nan::Get(options, Nan::New("min").ToLocalChecked()).ToLocalChecked();
+    if (value->IsArray()) {
+      Local<Array> min = value.As<Array>();
+      minSize = cv::Size(Nan::To<int64_t>(Nan::Get(min, 0).ToLocalChecked()).FromJust(), Nan::To<int64_t>(Nan::Get(min, 1).ToLocalChecked()).FromJust());
+    }
+    callbackIndex = 2;
+  }
+
+  // Without a callback, detectMultiScaleBatch returns a promise
+  Nan::Callback *callback = NULL;
+  if (info.Length() > callbackIndex && info[callbackIndex]->IsFunction()) {
+    callback = new Nan::Callback(info[callbackIndex].As<Function>());
+  }
 
-  Nan::AsyncQueueWorker( new AsyncDetectMultiScale(callback, self, im, scale,
-          neighbors, minw, minh));
-  return;
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(new AsyncDetectMultiScaleBatch(
+      callback, matrices, self->classifiers, scale, neighbors, minSize)));
 }
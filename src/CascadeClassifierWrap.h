@@ -3,19 +3,54 @@
 #include <opencv2/objdetect.hpp>
 #endif
 
+#include <vector>
+
+// The loaded classifiers for one cascade file.
+//
+// OpenCV doesn't promise that one cv::CascadeClassifier can run detections
+// on two threads at once, so every detection checks an instance out and
+// returns it when done. A new instance is only loaded when all are in use,
+// so the pool grows to the peak number of concurrent detections (at most one
+// per worker thread) and stays there. In-flight workers hold a reference.
+class ClassifierPool {
+public:
+  explicit ClassifierPool(const std::string &filename);
+
+  void Ref();
+  void Unref();
+
+  // Returns NULL if the cascade file can't be loaded
+  cv::CascadeClassifier* Acquire();
+  void Release(cv::CascadeClassifier *classifier);
+
+  // Instances loaded so far
+  unsigned int Size();
+
+private:
+  ~ClassifierPool();
+
+  std::string filename;
+  uv_mutex_t mutex;
+  std::vector<cv::CascadeClassifier*> idle;
+  unsigned int size;
+  unsigned int refs;
+};
+
 class CascadeClassifierWrap: public Nan::ObjectWrap {
 public:
-  cv::CascadeClassifier cc;
+  ClassifierPool *classifiers;
 
   static Nan::Persistent<FunctionTemplate> constructor;
   static void Init(Local<Object> target);
   static NAN_METHOD(New);
 
   CascadeClassifierWrap(v8::Value* fileName);
+  ~CascadeClassifierWrap();
 
   //static Handle<Value> LoadHaarClassifierCascade(const v8::Arguments&);
 
   static NAN_METHOD(DetectMultiScale);
+  static NAN_METHOD(DetectMultiScaleBatch);
 
   static void EIO_DetectMultiScale(uv_work_t *req);
   static int EIO_AfterDetectMultiScale(uv_work_t *req);
@@ -2,13 +2,13 @@
 #include "Constants.h"
 
 #define CONST(C) \
-  obj->Set(Nan::New<String>(#C).ToLocalChecked(), Nan::New<Integer>(C));
+  Nan::Set(obj, Nan::New<String>(#C).ToLocalChecked(), Nan::New<Integer>(C));
 
 #define CONST_DOUBLE(C) \
-  obj->Set(Nan::New<String>(#C).ToLocalChecked(), Nan::New<Number>(C));
+  Nan::Set(obj, Nan::New<String>(#C).ToLocalChecked(), Nan::New<Number>(C));
 
 #define CONST_ENUM(C) \
-  obj->Set(Nan::New<String>(#C).ToLocalChecked(), Nan::New<Integer>((int)(cv::C)));
+  Nan::Set(obj, Nan::New<String>(#C).ToLocalChecked(), Nan::New<Integer>((int)(cv::C)));
 
 void Constants::Init(Local<Object> target) {
   Nan::Persistent<Object> inner;
@@ -90,7 +90,7 @@ void Constants::Init(Local<Object> target) {
   CONST_ENUM(RETR_CCOMP);
   CONST_ENUM(RETR_TREE);
 
-  target->Set(Nan::New("Constants").ToLocalChecked(), obj);
+  Nan::Set(target, Nan::New("Constants").ToLocalChecked(), obj);
 }
 
 #undef CONST
@@ -1,5 +1,8 @@
 #include "Contours.h"
 #include "OpenCV.h"
+#include "AsyncBaseWorker.h"
+#include "OpStats.h"
+#include "ThreadPool.h"
 #include <nan.h>
 
 #include <iostream>
@@ -17,23 +20,29 @@ void Contour::Init(Local<Object> target) {
 
   // Prototype
   // Local<ObjectTemplate> proto = constructor->PrototypeTemplate();
-  Nan::SetPrototypeMethod(ctor, "point", Point);
-  Nan::SetPrototypeMethod(ctor, "points", Points);
-  Nan::SetPrototypeMethod(ctor, "size", Size);
-  Nan::SetPrototypeMethod(ctor, "cornerCount", CornerCount);
-  Nan::SetPrototypeMethod(ctor, "area", Area);
-  Nan::SetPrototypeMethod(ctor, "arcLength", ArcLength);
-  Nan::SetPrototypeMethod(ctor, "approxPolyDP", ApproxPolyDP);
-  Nan::SetPrototypeMethod(ctor, "convexHull", ConvexHull);
-  Nan::SetPrototypeMethod(ctor, "boundingRect", BoundingRect);
-  Nan::SetPrototypeMethod(ctor, "minAreaRect", MinAreaRect);
-  Nan::SetPrototypeMethod(ctor, "fitEllipse", FitEllipse);
-  Nan::SetPrototypeMethod(ctor, "isConvex", IsConvex);
-  Nan::SetPrototypeMethod(ctor, "moments", Moments);
-  Nan::SetPrototypeMethod(ctor, "hierarchy", Hierarchy);
-  Nan::SetPrototypeMethod(ctor, "serialize", Serialize);
-  Nan::SetPrototypeMethod(ctor, "deserialize", Deserialize);
-  target->Set(Nan::New("Contours").ToLocalChecked(), ctor->GetFunction());
+  OpStats::SetPrototypeMethod(ctor, "Contours.point", Point);
+  OpStats::SetPrototypeMethod(ctor, "Contours.points", Points);
+  OpStats::SetPrototypeMethod(ctor, "Contours.pointsBuffer", PointsBuffer);
+  OpStats::SetPrototypeMethod(ctor, "Contours.toTypedArrays", ToTypedArrays);
+  OpStats::SetPrototypeMethod(ctor, "Contours.size", Size);
+  OpStats::SetPrototypeMethod(ctor, "Contours.cornerCount", CornerCount);
+  OpStats::SetPrototypeMethod(ctor, "Contours.area", Area);
+  OpStats::SetPrototypeMethod(ctor, "Contours.arcLength", ArcLength);
+  OpStats::SetPrototypeMethod(ctor, "Contours.approxPolyDP", ApproxPolyDP);
+  OpStats::SetPrototypeMethod(ctor, "Contours.convexHull", ConvexHull);
+  OpStats::SetPrototypeMethod(ctor, "Contours.boundingRect", BoundingRect);
+  OpStats::SetPrototypeMethod(ctor, "Contours.minAreaRect", MinAreaRect);
+  OpStats::SetPrototypeMethod(ctor, "Contours.fitEllipse", FitEllipse);
+  OpStats::SetPrototypeMethod(ctor, "Contours.isConvex", IsConvex);
+  OpStats::SetPrototypeMethod(ctor, "Contours.moments", Moments);
+  OpStats::SetPrototypeMethod(ctor, "Contours.computeAll", ComputeAll);
+  OpStats::SetPrototypeMethod(ctor, "Contours.computeAllAsync", ComputeAllAsync);
+  OpStats::SetPrototypeMethod(ctor, "Contours.hierarchy", Hierarchy);
+  OpStats::SetPrototypeMethod(ctor, "Contours.serialize", Serialize);
+  OpStats::SetPrototypeMethod(ctor, "Contours.deserialize", Deserialize);
+  OpStats::SetPrototypeMethod(ctor, "Contours.serializeBinary", SerializeBinary);
+  OpStats::SetPrototypeMethod(ctor, "Contours.deserializeBinary", DeserializeBinary);
+  Nan::Set(target, Nan::New("Contours").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 };
 
 NAN_METHOD(Contour::New) {
@@ -58,14 +67,14 @@ NAN_METHOD(Contour::Point) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->NumberValue();
-  int index = info[1]->NumberValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
+  int index = Nan::To<double>(info[1]).FromJust();
 
   cv::Point point = self->contours[pos][index];
 
   Local<Object> data = Nan::New<Object>();
-  data->Set(Nan::New("x").ToLocalChecked(), Nan::New<Number>(point.x));
-  data->Set(Nan::New("y").ToLocalChecked(), Nan::New<Number>(point.y));
+  Nan::Set(data, Nan::New("x").ToLocalChecked(), Nan::New<Number>(point.x));
+  Nan::Set(data, Nan::New("y").ToLocalChecked(), Nan::New<Number>(point.y));
 
   info.GetReturnValue().Set(data);
 }
@@ -74,22 +83,92 @@ NAN_METHOD(Contour::Points) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->NumberValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
 
   std::vector<cv::Point> points = self->contours[pos];
   Local<Array> data = Nan::New<Array>(points.size());
 
   for (std::vector<int>::size_type i = 0; i != points.size(); i++) {
     Local<Object> point_data = Nan::New<Object>();
-    point_data->Set(Nan::New<String>("x").ToLocalChecked(), Nan::New<Number>(points[i].x));
-    point_data->Set(Nan::New<String>("y").ToLocalChecked(), Nan::New<Number>(points[i].y));
+    Nan::Set(point_data, Nan::New<String>("x").ToLocalChecked(), Nan::New<Number>(points[i].x));
+    Nan::Set(point_data, Nan::New<String>("y").ToLocalChecked(), Nan::New<Number>(points[i].y));
 
-    data->Set(i, point_data);
+    Nan::Set(data, i, point_data);
   }
 
   info.GetReturnValue().Set(data);
 }
 
+// Returns the points of contour `pos` as an Int32Array of x, y pairs.
+//
+// The array is filled with one copy of the contour's storage rather than
+// viewing it, since approxPolyDP, convexHull and deserialize can reallocate
+// the contour under a live view.
+NAN_METHOD(Contour::PointsBuffer) {
+  Nan::HandleScope scope;
+
+  Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
+  int pos = Nan::To<int64_t>(info[0]).FromJust();
+
+  if (pos < 0 || pos >= (int) self->contours.size()) {
+    return Nan::ThrowRangeError("Contour index out of range");
+  }
+
+  const std::vector<cv::Point> &points = self->contours[pos];
+  int32_t *data;
+  Local<Object> res = OpenCV::NewTypedArray(CV_32S, points.size() * 2, (void**) &data);
+  if (!points.empty()) {
+    memcpy(data, &points[0], points.size() * sizeof(cv::Point));
+  }
+
+  info.GetReturnValue().Set(res);
+}
+
+// Returns all contours at once as
+//   {points: Int32Array, offsets: Int32Array, hierarchy: Int32Array}
+// `points` holds the x, y pairs of every contour back to back; contour i is
+// points offsets[i] (inclusive) to offsets[i + 1] (exclusive). `hierarchy`
+// holds the four hierarchy entries of each contour, or is empty when the
+// contours have none.
+NAN_METHOD(Contour::ToTypedArrays) {
+  Nan::HandleScope scope;
+
+  Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
+  size_t count = self->contours.size();
+
+  int32_t *offsets;
+  Local<Object> offsetsArray = OpenCV::NewTypedArray(CV_32S, count + 1, (void**) &offsets);
+  size_t total = 0;
+  for (size_t i = 0; i < count; i++) {
+    offsets[i] = (int32_t) total;
+    total += self->contours[i].size();
+  }
+  offsets[count] = (int32_t) total;
+
+  int32_t *points;
+  Local<Object> pointsArray = OpenCV::NewTypedArray(CV_32S, total * 2, (void**) &points);
+  for (size_t i = 0; i < count; i++) {
+    const std::vector<cv::Point> &contour = self->contours[i];
+    if (!contour.empty()) {
+      memcpy(points + offsets[i] * 2, &contour[0], contour.size() * sizeof(cv::Point));
+    }
+  }
+
+  int32_t *hierarchy;
+  size_t levels = self->hierarchy.size() == count ? count : 0;
+  Local<Object> hierarchyArray = OpenCV::NewTypedArray(CV_32S, levels * 4, (void**) &hierarchy);
+  if (levels) {
+    memcpy(hierarchy, &self->hierarchy[0], levels * sizeof(cv::Vec4i));
+  }
+
+  Local<Object> res = Nan::New<Object>();
+  Nan::Set(res, Nan::New("points").ToLocalChecked(), pointsArray);
+  Nan::Set(res, Nan::New("offsets").ToLocalChecked(), offsetsArray);
+  Nan::Set(res, Nan::New("hierarchy").ToLocalChecked(), hierarchyArray);
+
+  info.GetReturnValue().Set(res);
+}
+
 // FIXME: this should better be called "Length" as ``Contours`` is an Array like
 // structure also, this would allow to use ``Size`` for the function returning
 // the number of corners in the contour for better consistency with OpenCV.
@@ -105,7 +184,7 @@ NAN_METHOD(Contour::CornerCount) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->NumberValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
 
   info.GetReturnValue().Set(Nan::New<Number>(self->contours[pos].size()));
 }
@@ -114,7 +193,7 @@ NAN_METHOD(Contour::Area) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->NumberValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
 
   // info.GetReturnValue().Set(Nan::New<Number>(contourArea(self->contours)));
   info.GetReturnValue().Set(Nan::New<Number>(contourArea(cv::Mat(self->contours[pos]))));
@@ -124,8 +203,8 @@ NAN_METHOD(Contour::ArcLength) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->NumberValue();
-  bool isClosed = info[1]->BooleanValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
+  bool isClosed = Nan::To<bool>(info[1]).FromJust();
 
   info.GetReturnValue().Set(Nan::New<Number>(arcLength(cv::Mat(self->contours[pos]), isClosed)));
 }
@@ -134,9 +213,9 @@ NAN_METHOD(Contour::ApproxPolyDP) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->NumberValue();
-  double epsilon = info[1]->NumberValue();
-  bool isClosed = info[2]->BooleanValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
+  double epsilon = Nan::To<double>(info[1]).FromJust();
+  bool isClosed = Nan::To<bool>(info[2]).FromJust();
 
   cv::Mat approxed;
   approxPolyDP(cv::Mat(self->contours[pos]), approxed, epsilon, isClosed);
@@ -150,8 +229,8 @@ NAN_METHOD(Contour::ConvexHull) {
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
 
-  int pos = info[0]->NumberValue();
-  bool clockwise = info[1]->BooleanValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
+  bool clockwise = Nan::To<bool>(info[1]).FromJust();
 
   cv::Mat hull;
   cv::convexHull(cv::Mat(self->contours[pos]), hull, clockwise);
@@ -164,15 +243,15 @@ NAN_METHOD(Contour::BoundingRect) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->NumberValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
 
   cv::Rect bounding = cv::boundingRect(cv::Mat(self->contours[pos]));
   Local<Object> rect = Nan::New<Object>();
 
-  rect->Set(Nan::New("x").ToLocalChecked(), Nan::New<Number>(bounding.x));
-  rect->Set(Nan::New("y").ToLocalChecked(), Nan::New<Number>(bounding.y));
-  rect->Set(Nan::New("width").ToLocalChecked(), Nan::New<Number>(bounding.width));
-  rect->Set(Nan::New("height").ToLocalChecked(), Nan::New<Number>(bounding.height));
+  Nan::Set(rect, Nan::New("x").ToLocalChecked(), Nan::New<Number>(bounding.x));
+  Nan::Set(rect, Nan::New("y").ToLocalChecked(), Nan::New<Number>(bounding.y));
+  Nan::Set(rect, Nan::New("width").ToLocalChecked(), Nan::New<Number>(bounding.width));
+  Nan::Set(rect, Nan::New("height").ToLocalChecked(), Nan::New<Number>(bounding.height));
 
   info.GetReturnValue().Set(rect);
 }
@@ -181,21 +260,21 @@ NAN_METHOD(Contour::MinAreaRect) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->NumberValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
 
   cv::RotatedRect minimum = cv::minAreaRect(cv::Mat(self->contours[pos]));
 
   Local<Object> rect = Nan::New<Object>();
-  rect->Set(Nan::New("angle").ToLocalChecked(), Nan::New<Number>(minimum.angle));
+  Nan::Set(rect, Nan::New("angle").ToLocalChecked(), Nan::New<Number>(minimum.angle));
 
   Local<Object> size = Nan::New<Object>();
-  size->Set(Nan::New("height").ToLocalChecked(), Nan::New<Number>(minimum.size.height));
-  size->Set(Nan::New("width").ToLocalChecked(), Nan::New<Number>(minimum.size.width));
-  rect->Set(Nan::New("size").ToLocalChecked(), size);
+  Nan::Set(size, Nan::New("height").ToLocalChecked(), Nan::New<Number>(minimum.size.height));
+  Nan::Set(size, Nan::New("width").ToLocalChecked(), Nan::New<Number>(minimum.size.width));
+  Nan::Set(rect, Nan::New("size").ToLocalChecked(), size);
 
   Local<Object> center = Nan::New<Object>();
-  center->Set(Nan::New("x").ToLocalChecked(), Nan::New<Number>(minimum.center.x));
-  center->Set(Nan::New("y").ToLocalChecked(), Nan::New<Number>(minimum.center.y));
+  Nan::Set(center, Nan::New("x").ToLocalChecked(), Nan::New<Number>(minimum.center.x));
+  Nan::Set(center, Nan::New("y").ToLocalChecked(), Nan::New<Number>(minimum.center.y));
 
   v8::Local<v8::Array> points = Nan::New<Array>(4);
 
@@ -204,12 +283,12 @@ NAN_METHOD(Contour::MinAreaRect) {
 
   for (unsigned int i=0; i<4; i++) {
     Local<Object> point = Nan::New<Object>();
-    point->Set(Nan::New("x").ToLocalChecked(), Nan::New<Number>(rect_points[i].x));
-    point->Set(Nan::New("y").ToLocalChecked(), Nan::New<Number>(rect_points[i].y));
-    points->Set(i, point);
+    Nan::Set(point, Nan::New("x").ToLocalChecked(), Nan::New<Number>(rect_points[i].x));
+    Nan::Set(point, Nan::New("y").ToLocalChecked(), Nan::New<Number>(rect_points[i].y));
+    Nan::Set(points, i, point);
   }
 
-  rect->Set(Nan::New("points").ToLocalChecked(), points);
+  Nan::Set(rect, Nan::New("points").ToLocalChecked(), points);
 
   info.GetReturnValue().Set(rect);
 }
@@ -218,23 +297,23 @@ NAN_METHOD(Contour::FitEllipse) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->NumberValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
 
   if (self->contours[pos].size() >= 5) {  // Minimum number for an ellipse
     cv::RotatedRect ellipse = cv::fitEllipse(cv::Mat(self->contours[pos]));
 
     Local<Object> jsEllipse = Nan::New<Object>();
-    jsEllipse->Set(Nan::New("angle").ToLocalChecked(), Nan::New<Number>(ellipse.angle));
+    Nan::Set(jsEllipse, Nan::New("angle").ToLocalChecked(), Nan::New<Number>(ellipse.angle));
 
     Local<Object> size = Nan::New<Object>();
-    size->Set(Nan::New("height").ToLocalChecked(), Nan::New<Number>(ellipse.size.height));
-    size->Set(Nan::New("width").ToLocalChecked(), Nan::New<Number>(ellipse.size.width));
-    jsEllipse->Set(Nan::New("size").ToLocalChecked(), size);
+    Nan::Set(size, Nan::New("height").ToLocalChecked(), Nan::New<Number>(ellipse.size.height));
+    Nan::Set(size, Nan::New("width").ToLocalChecked(), Nan::New<Number>(ellipse.size.width));
+    Nan::Set(jsEllipse, Nan::New("size").ToLocalChecked(), size);
 
     Local<Object> center = Nan::New<Object>();
-    center->Set(Nan::New("x").ToLocalChecked(), Nan::New<Number>(ellipse.center.x));
-    center->Set(Nan::New("y").ToLocalChecked(), Nan::New<Number>(ellipse.center.y));
-    jsEllipse->Set(Nan::New("center").ToLocalChecked(), center);
+    Nan::Set(center, Nan::New("x").ToLocalChecked(), Nan::New<Number>(ellipse.center.x));
+    Nan::Set(center, Nan::New("y").ToLocalChecked(), Nan::New<Number>(ellipse.center.y));
+    Nan::Set(jsEllipse, Nan::New("center").ToLocalChecked(), center);
 
     info.GetReturnValue().Set(jsEllipse);
   }
@@ -246,7 +325,7 @@ NAN_METHOD(Contour::IsConvex) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->NumberValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
 
   info.GetReturnValue().Set(Nan::New<Boolean>(isContourConvex(cv::Mat(self->contours[pos]))));
 }
@@ -255,35 +334,331 @@ NAN_METHOD(Contour::Moments) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->NumberValue();
+  int pos = Nan::To<double>(info[0]).FromJust();
 
   // Get the moments
   cv::Moments mu = moments( self->contours[pos], false );
 
   Local<Object> res = Nan::New<Object>();
 
-  res->Set(Nan::New("m00").ToLocalChecked(), Nan::New<Number>(mu.m00));
-  res->Set(Nan::New("m10").ToLocalChecked(), Nan::New<Number>(mu.m10));
-  res->Set(Nan::New("m01").ToLocalChecked(), Nan::New<Number>(mu.m01));
-  res->Set(Nan::New("m11").ToLocalChecked(), Nan::New<Number>(mu.m11));
+  Nan::Set(res, Nan::New("m00").ToLocalChecked(), Nan::New<Number>(mu.m00));
+  Nan::Set(res, Nan::New("m10").ToLocalChecked(), Nan::New<Number>(mu.m10));
+  Nan::Set(res, Nan::New("m01").ToLocalChecked(), Nan::New<Number>(mu.m01));
+  Nan::Set(res, Nan::New("m11").ToLocalChecked(), Nan::New<Number>(mu.m11));
 
   info.GetReturnValue().Set(res);
 }
 
+// Metrics of many contours at once, for computeAll and computeAllAsync. Each
+// result array has a fixed stride per contour, so threads write to disjoint
+// slots.
+class ContourMetricsJob: public ParallelJob {
+public:
+  enum Metric {
+    AREA = 1,
+    ARC_LENGTH = 2,
+    BBOX = 4,
+    MIN_AREA_RECT = 8,
+    IS_CONVEX = 16
+  };
+
+  ContourMetricsJob(const std::vector<std::vector<cv::Point> > &contours,
+      int metrics, bool closed, double minArea, int convex) :
+      ParallelJob(contours.size()),
+      keep(contours.size()),
+      area(contours.size()),
+      arcLength(contours.size()),
+      bbox(contours.size() * 4),
+      minAreaRect(contours.size() * 5),
+      isConvex(contours.size()),
+      contours(contours),
+      metrics(metrics),
+      closed(closed),
+      minArea(minArea),
+      convex(convex) {
+    // The filters need these whether or not they are returned
+    if (minArea > 0) {
+      this->metrics |= AREA;
+    }
+    if (convex >= 0) {
+      this->metrics |= IS_CONVEX;
+    }
+  }
+
+  void Run() {
+    for (int i = Next(); i >= 0; i = Next()) {
+      try {
+        Compute(i);
+      } catch (cv::Exception& e) {
+        SetError(e.what());
+      }
+    }
+  }
+
+  // Contours that passed the filters
+  std::vector<char> keep;
+  std::vector<double> area;
+  std::vector<double> arcLength;
+  std::vector<double> bbox;
+  std::vector<double> minAreaRect;
+  std::vector<double> isConvex;
+
+private:
+  void Compute(int i) {
+    cv::Mat points(contours[i]);
+
+    if (metrics & AREA) {
+      area[i] = cv::contourArea(points);
+      if (area[i] < minArea) {
+        return;
+      }
+    }
+    if (metrics & IS_CONVEX) {
+      bool c = cv::isContourConvex(points);
+      isConvex[i] = c;
+      if (convex >= 0 && c != (convex == 1)) {
+        return;
+      }
+    }
+    if (metrics & ARC_LENGTH) {
+      arcLength[i] = cv::arcLength(points, closed);
+    }
+    if (metrics & BBOX) {
+      cv::Rect r = cv::boundingRect(points);
+      bbox[i * 4] = r.x;
+      bbox[i * 4 + 1] = r.y;
+      bbox[i * 4 + 2] = r.width;
+      bbox[i * 4 + 3] = r.height;
+    }
+    if ((metrics & MIN_AREA_RECT) && !contours[i].empty()) {
+      cv::RotatedRect r = cv::minAreaRect(points);
+      minAreaRect[i * 5] = r.center.x;
+      minAreaRect[i * 5 + 1] = r.center.y;
+      minAreaRect[i * 5 + 2] = r.size.width;
+      minAreaRect[i * 5 + 3] = r.size.height;
+      minAreaRect[i * 5 + 4] = r.angle;
+    }
+    keep[i] = 1;
+  }
+
+  const std::vector<std::vector<cv::Point> > &contours;
+  int metrics;
+  bool closed;
+  double minArea;
+  int convex;
+};
+
+// Copies the rows of `values` (`stride` per contour) for the kept contours
+// into a new Float64Array
+static Local<Object> KeptMetrics(const std::vector<double> &values, int stride,
+    const std::vector<int> &kept) {
+  Nan::EscapableHandleScope scope;
+
+  double *data;
+  Local<Object> array = OpenCV::NewTypedArray(CV_64F, kept.size() * stride, (void**) &data);
+  for (size_t i = 0; i < kept.size(); i++) {
+    memcpy(data + i * stride, &values[kept[i] * stride], stride * sizeof(double));
+  }
+
+  return scope.Escape(array);
+}
+
+static bool OptionFlag(Local<Object> options, const char *name) {
+  return Nan::To<bool>(Nan::Get(options, Nan::New(name).ToLocalChecked()).ToLocalChecked()).FromJust();
+}
+
+// The options of computeAll: the metrics requested and the filters
+struct ContourMetricsOptions {
+  int metrics;
+  bool closed;
+  double minArea;
+  int convex;
+};
+
+static ContourMetricsOptions MetricsOptions(Local<Object> options) {
+  ContourMetricsOptions opts = {0, true, 0, -1};
+
+  if (OptionFlag(options, "area")) {
+    opts.metrics |= ContourMetricsJob::AREA;
+  }
+  if (OptionFlag(options, "arcLength")) {
+    opts.metrics |= ContourMetricsJob::ARC_LENGTH;
+  }
+  if (OptionFlag(options, "bbox")) {
+    opts.metrics |= ContourMetricsJob::BBOX;
+  }
+  if (OptionFlag(options, "minAreaRect")) {
+    opts.metrics |= ContourMetricsJob::MIN_AREA_RECT;
+  }
+  if (OptionFlag(options, "isConvex")) {
+    opts.metrics |= ContourMetricsJob::IS_CONVEX;
+  }
+
+  Local<Value> value = Nan::Get(options, Nan::New("closed").ToLocalChecked()).ToLocalChecked();
+  if (!value->IsUndefined()) {
+    opts.closed = Nan::To<bool>(value).FromJust();
+  }
+
+  value = Nan::Get(options, Nan::New("minArea").ToLocalChecked()).ToLocalChecked();
+  if (value->IsNumber()) {
+    opts.minArea = Nan::To<double>(value).FromJust();
+  }
+
+  value = Nan::Get(options, Nan::New("convex").ToLocalChecked()).ToLocalChecked();
+  if (value->IsBoolean()) {
+    opts.convex = Nan::To<bool>(value).FromJust() ? 1 : 0;
+  }
+
+  return opts;
+}
+
+// The object computeAll returns, from a finished job
+static Local<Object> MetricsResult(ContourMetricsJob &job, int metrics) {
+  Nan::EscapableHandleScope scope;
+
+  std::vector<int> kept;
+  for (size_t i = 0; i < job.keep.size(); i++) {
+    if (job.keep[i]) {
+      kept.push_back(i);
+    }
+  }
+
+  int32_t *index;
+  Local<Object> indexArray = OpenCV::NewTypedArray(CV_32S, kept.size(), (void**) &index);
+  if (!kept.empty()) {
+    memcpy(index, &kept[0], kept.size() * sizeof(int32_t));
+  }
+
+  Local<Object> res = Nan::New<Object>();
+  Nan::Set(res, Nan::New("count").ToLocalChecked(), Nan::New<Number>(kept.size()));
+  Nan::Set(res, Nan::New("index").ToLocalChecked(), indexArray);
+  if (metrics & ContourMetricsJob::AREA) {
+    Nan::Set(res, Nan::New("area").ToLocalChecked(), KeptMetrics(job.area, 1, kept));
+  }
+  if (metrics & ContourMetricsJob::ARC_LENGTH) {
+    Nan::Set(res, Nan::New("arcLength").ToLocalChecked(), KeptMetrics(job.arcLength, 1, kept));
+  }
+  if (metrics & ContourMetricsJob::BBOX) {
+    Nan::Set(res, Nan::New("bbox").ToLocalChecked(), KeptMetrics(job.bbox, 4, kept));
+  }
+  if (metrics & ContourMetricsJob::MIN_AREA_RECT) {
+    Nan::Set(res, Nan::New("minAreaRect").ToLocalChecked(), KeptMetrics(job.minAreaRect, 5, kept));
+  }
+  if (metrics & ContourMetricsJob::IS_CONVEX) {
+    Nan::Set(res, Nan::New("isConvex").ToLocalChecked(), KeptMetrics(job.isConvex, 1, kept));
+  }
+
+  return scope.Escape(res);
+}
+
+// contours.computeAll({area, arcLength, bbox, minAreaRect, isConvex,
+//                      closed, minArea, convex})
+//
+// Computes the requested metrics for every contour in one call and returns
+// them as one typed array per metric:
+//
+//   {count, index: Int32Array, area: Float64Array, arcLength: Float64Array,
+//    bbox: Float64Array (x, y, width, height per contour),
+//    minAreaRect: Float64Array (center x, center y, width, height, angle),
+//    isConvex: Float64Array (1 or 0)}
+//
+// Only the requested metrics are present. Contours smaller than `minArea`,
+// or whose convexity isn't `convex` when that is given, are left out; `index`
+// holds the contour index of each entry. `closed` (default true) applies to
+// arcLength.
+//
+// Runs serially on the calling thread; computeAllAsync spreads the same work
+// over the thread pool.
+NAN_METHOD(Contour::ComputeAll) {
+  Nan::HandleScope scope;
+
+  Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsObject()) {
+    return Nan::ThrowTypeError("computeAll takes an options object");
+  }
+  ContourMetricsOptions opts = MetricsOptions(Nan::To<Object>(info[0]).ToLocalChecked());
+
+  ContourMetricsJob job(self->contours, opts.metrics, opts.closed,
+      opts.minArea, opts.convex);
+  job.Run();
+
+  std::string error = job.Error();
+  if (!error.empty()) {
+    return Nan::ThrowError(error.c_str());
+  }
+
+  info.GetReturnValue().Set(MetricsResult(job, opts.metrics));
+}
+
+class AsyncComputeAllWorker: public AsyncBaseWorker {
+public:
+  AsyncComputeAllWorker(Nan::Callback *callback,
+      const std::vector<std::vector<cv::Point> > &contours,
+      ContourMetricsOptions opts) :
+      AsyncBaseWorker(callback),
+      contours(contours),
+      opts(opts),
+      job(this->contours, opts.metrics, opts.closed, opts.minArea, opts.convex) {
+  }
+
+  void Execute() {
+    ThreadPool::ParallelFor(job);
+
+    std::string error = job.Error();
+    if (!error.empty()) {
+      SetErrorMessage(error.c_str());
+    }
+  }
+
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
+    return scope.Escape(MetricsResult(job, opts.metrics));
+  }
+
+private:
+  // A copy, as JS may load other contours while the job runs
+  std::vector<std::vector<cv::Point> > contours;
+  ContourMetricsOptions opts;
+  ContourMetricsJob job;
+};
+
+// contours.computeAllAsync(options[, callback]) computes what computeAll does
+// on a worker, spread over the thread pool, and passes the same object to
+// the callback, or resolves with it.
+NAN_METHOD(Contour::ComputeAllAsync) {
+  Nan::HandleScope scope;
+
+  Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsObject()) {
+    return Nan::ThrowTypeError("computeAllAsync takes an options object");
+  }
+  ContourMetricsOptions opts = MetricsOptions(Nan::To<Object>(info[0]).ToLocalChecked());
+
+  Nan::Callback *callback = NULL;
+  if (info.Length() > 1 && info[1]->IsFunction()) {
+    callback = new Nan::Callback(info[1].As<Function>());
+  }
+
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(
+      new AsyncComputeAllWorker(callback, self->contours, opts)));
+}
+
 NAN_METHOD(Contour::Hierarchy) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
-  int pos = info[0]->IntegerValue();
+  int pos = Nan::To<int64_t>(info[0]).FromJust();
 
   cv::Vec4i hierarchy = self->hierarchy[pos];
 
   Local<Array> res = Nan::New<Array>(4);
 
-  res->Set(0, Nan::New<Number>(hierarchy[0]));
-  res->Set(1, Nan::New<Number>(hierarchy[1]));
-  res->Set(2, Nan::New<Number>(hierarchy[2]));
-  res->Set(3, Nan::New<Number>(hierarchy[3]));
+  Nan::Set(res, 0, Nan::New<Number>(hierarchy[0]));
+  Nan::Set(res, 1, Nan::New<Number>(hierarchy[1]));
+  Nan::Set(res, 2, Nan::New<Number>(hierarchy[2]));
+  Nan::Set(res, 3, Nan::New<Number>(hierarchy[3]));
 
   info.GetReturnValue().Set(res);
 }
@@ -301,28 +676,28 @@ NAN_METHOD(Contour::Serialize) {
 
     for (std::vector<int>::size_type j = 0; j != points.size(); j++) {
       Local<Array> point_data = Nan::New<Array>(2);
-      point_data->Set(0, Nan::New<Number>(points[j].x));
-      point_data->Set(1, Nan::New<Number>(points[j].y));
+      Nan::Set(point_data, 0, Nan::New<Number>(points[j].x));
+      Nan::Set(point_data, 1, Nan::New<Number>(points[j].y));
 
-      contour_data->Set(j, point_data);
+      Nan::Set(contour_data, j, point_data);
     }
-    contours_data->Set(i, contour_data);
+    Nan::Set(contours_data, i, contour_data);
   }
 
   Local<Array> hierarchy_data = Nan::New<Array>(self->hierarchy.size());
   for (std::vector<int>::size_type i = 0; i != self->hierarchy.size(); i++) {
     Local<Array> contour_data = Nan::New<Array>(4);
-    contour_data->Set(0, Nan::New<Number>(self->hierarchy[i][0]));
-    contour_data->Set(1, Nan::New<Number>(self->hierarchy[i][1]));
-    contour_data->Set(2, Nan::New<Number>(self->hierarchy[i][2]));
-    contour_data->Set(3, Nan::New<Number>(self->hierarchy[i][3]));
+    Nan::Set(contour_data, 0, Nan::New<Number>(self->hierarchy[i][0]));
+    Nan::Set(contour_data, 1, Nan::New<Number>(self->hierarchy[i][1]));
+    Nan::Set(contour_data, 2, Nan::New<Number>(self->hierarchy[i][2]));
+    Nan::Set(contour_data, 3, Nan::New<Number>(self->hierarchy[i][3]));
 
-    hierarchy_data->Set(i, contour_data);
+    Nan::Set(hierarchy_data, i, contour_data);
   }
 
   Local<Object> data = Nan::New<Object>();
-  data->Set(Nan::New<String>("contours").ToLocalChecked(), contours_data);
-  data->Set(Nan::New<String>("hierarchy").ToLocalChecked(), hierarchy_data);
+  Nan::Set(data, Nan::New<String>("contours").ToLocalChecked(), contours_data);
+  Nan::Set(data, Nan::New<String>("hierarchy").ToLocalChecked(), hierarchy_data);
 
   info.GetReturnValue().Set(data);
 }
@@ -334,21 +709,21 @@ NAN_METHOD(Contour::Deserialize) {
 
   Local<Object> data = Local<Object>::Cast(info[0]);
 
-  Local<Array> contours_data = Local<Array>::Cast(data->Get(Nan::New<String>("contours").ToLocalChecked()));
-  Local<Array> hierarchy_data = Local<Array>::Cast(data->Get(Nan::New<String>("hierarchy").ToLocalChecked()));
+  Local<Array> contours_data = Local<Array>::Cast(Nan::Get(data, Nan::New<String>("contours").ToLocalChecked()).ToLocalChecked());
+  Local<Array> hierarchy_data = Local<Array>::Cast(Nan::Get(data, Nan::New<String>("hierarchy").ToLocalChecked()).ToLocalChecked());
 
   std::vector<std::vector<cv::Point> > contours_res;
   int contours_length = contours_data->Length();
 
   for (int i = 0; i < contours_length; i++) {
-    Local<Array> contour_data = Local<Array>::Cast(contours_data->Get(i));
+    Local<Array> contour_data = Local<Array>::Cast(Nan::Get(contours_data, i).ToLocalChecked());
     std::vector<cv::Point> points;
 
     int contour_length = contour_data->Length();
     for (int j = 0; j < contour_length; j++) {
-      Local<Array> point_data = Local<Array>::Cast(contour_data->Get(j));
-      int x = point_data->Get(0)->IntegerValue();
-      int y = point_data->Get(1)->IntegerValue();
+      Local<Array> point_data = Local<Array>::Cast(Nan::Get(contour_data, j).ToLocalChecked());
+      int x = Nan::To<int64_t>(Nan::Get(point_data, 0).ToLocalChecked()).FromJust();
+      int y = Nan::To<int64_t>(Nan::Get(point_data, 1).ToLocalChecked()).FromJust();
       points.push_back(cv::Point(x, y));
     }
 
@@ -359,11 +734,11 @@ NAN_METHOD(Contour::Deserialize) {
   int hierarchy_length = hierarchy_data->Length();
 
   for (int i = 0; i < hierarchy_length; i++) {
-    Local<Array> contour_data = Local<Array>::Cast(hierarchy_data->Get(i));
-    int a = contour_data->Get(0)->IntegerValue();
-    int b = contour_data->Get(1)->IntegerValue();
-    int c = contour_data->Get(2)->IntegerValue();
-    int d = contour_data->Get(3)->IntegerValue();
+    Local<Array> contour_data = Local<Array>::Cast(Nan::Get(hierarchy_data, i).ToLocalChecked());
+    int a = Nan::To<int64_t>(Nan::Get(contour_data, 0).ToLocalChecked()).FromJust();
+    int b = Nan::To<int64_t>(Nan::Get(contour_data, 1).ToLocalChecked()).FromJust();
+    int c = Nan::To<int64_t>(Nan::Get(contour_data, 2).ToLocalChecked()).FromJust();
+    int d = Nan::To<int64_t>(Nan::Get(contour_data, 3).ToLocalChecked()).FromJust();
     hierarchy_res.push_back(cv::Vec4i(a, b, c, d));
   }
 
@@ -372,3 +747,163 @@ NAN_METHOD(Contour::Deserialize) {
 
   info.GetReturnValue().Set(Nan::Null());
 }
+
+// Binary form of serialize(), for caching contours:
+//
+//   "CNTR" version:u8 contours:varint hierarchy:varint
+//   per contour: points:varint x0 y0 (dx dy)*   -- zigzag varints
+//   per hierarchy entry: next prev child parent -- zigzag varints
+//
+// Points after the first are stored as the difference to the previous one,
+// which is small along a contour, so most coordinates fit in one byte.
+static const char kContoursMagic[4] = {'C', 'N', 'T', 'R'};
+static const uint8_t kContoursVersion = 1;
+
+static void WriteVarint(std::vector<uint8_t> &out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back((uint8_t) (value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t) value);
+}
+
+static void WriteSigned(std::vector<uint8_t> &out, int32_t value) {
+  WriteVarint(out, ((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+}
+
+// Returns false when the input ends early or the varint is too long
+static bool ReadVarint(const uint8_t *&pos, const uint8_t *end, uint32_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (pos == end) {
+      return false;
+    }
+    uint8_t byte = *pos++;
+    value |= (uint32_t) (byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool ReadSigned(const uint8_t *&pos, const uint8_t *end, int32_t &value) {
+  uint32_t raw;
+  if (!ReadVarint(pos, end, raw)) {
+    return false;
+  }
+  value = (int32_t) (raw >> 1) ^ -(int32_t) (raw & 1);
+  return true;
+}
+
+// Returns a Buffer holding the contours and hierarchy; see
+// deserializeBinary for the way back.
+NAN_METHOD(Contour::SerializeBinary) {
+  Nan::HandleScope scope;
+
+  Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
+
+  std::vector<uint8_t> out;
+  // Enough for the common case of one-byte deltas
+  size_t total = 0;
+  for (size_t i = 0; i < self->contours.size(); i++) {
+    total += self->contours[i].size();
+  }
+  out.reserve(16 + total * 2 + self->contours.size() * 4 + self->hierarchy.size() * 4);
+
+  out.insert(out.end(), kContoursMagic, kContoursMagic + sizeof(kContoursMagic));
+  out.push_back(kContoursVersion);
+  WriteVarint(out, self->contours.size());
+  WriteVarint(out, self->hierarchy.size());
+
+  for (size_t i = 0; i < self->contours.size(); i++) {
+    const std::vector<cv::Point> &points = self->contours[i];
+    WriteVarint(out, points.size());
+
+    cv::Point previous(0, 0);
+    for (size_t j = 0; j < points.size(); j++) {
+      WriteSigned(out, points[j].x - previous.x);
+      WriteSigned(out, points[j].y - previous.y);
+      previous = points[j];
+    }
+  }
+
+  for (size_t i = 0; i < self->hierarchy.size(); i++) {
+    for (int k = 0; k < 4; k++) {
+      WriteSigned(out, self->hierarchy[i][k]);
+    }
+  }
+
+  info.GetReturnValue().Set(Nan::CopyBuffer(
+      out.empty() ? NULL : (const char*) &out[0], out.size()).ToLocalChecked());
+}
+
+// Replaces the contours with the ones in a Buffer from serializeBinary.
+// Throws, leaving the contours as they were, if the data is malformed.
+NAN_METHOD(Contour::DeserializeBinary) {
+  Nan::HandleScope scope;
+
+  Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
+
+  if (info.Length() < 1 || !Buffer::HasInstance(info[0])) {
+    return Nan::ThrowTypeError("deserializeBinary takes a Buffer");
+  }
+
+  Local<Object> buf = Nan::To<Object>(info[0]).ToLocalChecked();
+  const uint8_t *pos = (const uint8_t*) Buffer::Data(buf);
+  const uint8_t *end = pos + Buffer::Length(buf);
+
+  if (end - pos < (ptrdiff_t) sizeof(kContoursMagic) + 1 ||
+      memcmp(pos, kContoursMagic, sizeof(kContoursMagic)) != 0) {
+    return Nan::ThrowError("Not serialized contours");
+  }
+  pos += sizeof(kContoursMagic);
+  if (*pos++ != kContoursVersion) {
+    return Nan::ThrowError("Unsupported contours serialization version");
+  }
+
+  uint32_t count;
+  uint32_t levels;
+  // Every contour takes at least one byte, every hierarchy entry four, which
+  // bounds the counts before anything is allocated for them
+  if (!ReadVarint(pos, end, count) || !ReadVarint(pos, end, levels) ||
+      count > (size_t) (end - pos) || levels > (size_t) (end - pos) / 4) {
+    return Nan::ThrowError("Truncated contours data");
+  }
+
+  std::vector<std::vector<cv::Point> > contours_res(count);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t length;
+    // Two bytes at least per point
+    if (!ReadVarint(pos, end, length) || length > (size_t) (end - pos) / 2) {
+      return Nan::ThrowError("Truncated contours data");
+    }
+
+    std::vector<cv::Point> &points = contours_res[i];
+    points.resize(length);
+    cv::Point previous(0, 0);
+    for (uint32_t j = 0; j < length; j++) {
+      int32_t dx;
+      int32_t dy;
+      if (!ReadSigned(pos, end, dx) || !ReadSigned(pos, end, dy)) {
+        return Nan::ThrowError("Truncated contours data");
+      }
+      previous = cv::Point(previous.x + dx, previous.y + dy);
+      points[j] = previous;
+    }
+  }
+
+  std::vector<cv::Vec4i> hierarchy_res(levels);
+  for (uint32_t i = 0; i < levels; i++) {
+    for (int k = 0; k < 4; k++) {
+      if (!ReadSigned(pos, end, hierarchy_res[i][k])) {
+        return Nan::ThrowError("Truncated contours data");
+      }
+    }
+  }
+
+  self->contours.swap(contours_res);
+  self->hierarchy.swap(hierarchy_res);
+
+  info.GetReturnValue().Set(Nan::Null());
+}
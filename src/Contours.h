@@ -15,6 +15,8 @@ public:
 
   JSFUNC(Point)
   JSFUNC(Points)
+  JSFUNC(PointsBuffer)
+  JSFUNC(ToTypedArrays)
   JSFUNC(Size)
   JSFUNC(CornerCount)
   JSFUNC(Area)
@@ -26,8 +28,12 @@ public:
   JSFUNC(FitEllipse)
   JSFUNC(IsConvex)
   JSFUNC(Moments)
+  JSFUNC(ComputeAll)
+  JSFUNC(ComputeAllAsync)
   JSFUNC(Hierarchy)
   JSFUNC(Serialize)
   JSFUNC(Deserialize)
+  JSFUNC(SerializeBinary)
+  JSFUNC(DeserializeBinary)
 };
 
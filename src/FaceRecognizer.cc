@@ -1,8 +1,10 @@
 #include "OpenCV.h"
+#include "OpStats.h"
 
 #ifdef HAVE_OPENCV_FACE
 #include "FaceRecognizer.h"
 #include "Matrix.h"
+#include "AsyncBaseWorker.h"
 #include <nan.h>
 
 #if CV_MAJOR_VERSION >= 3
@@ -22,11 +24,11 @@ namespace cv {
 cv::Mat fromMatrixOrFilename(Local<Value> v) {
   cv::Mat im;
   if (v->IsString()) {
-    std::string filename = std::string(*Nan::Utf8String(v->ToString()));
+    std::string filename = std::string(*Nan::Utf8String(Nan::To<String>(v).ToLocalChecked()));
     im = cv::imread(filename);
     // std::cout<< im.size();
   } else {
-    Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(v->ToObject());
+    Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(v).ToLocalChecked());
     im = img->mat;
   }
   return im;
@@ -43,21 +45,21 @@ void FaceRecognizerWrap::Init(Local<Object> target) {
   ctor->InstanceTemplate()->SetInternalFieldCount(1);
   ctor->SetClassName(Nan::New("FaceRecognizer").ToLocalChecked());
 
-  Nan::SetMethod(ctor, "createLBPHFaceRecognizer", CreateLBPH);
-  Nan::SetMethod(ctor, "createEigenFaceRecognizer", CreateEigen);
-  Nan::SetMethod(ctor, "createFisherFaceRecognizer", CreateFisher);
+  OpStats::SetMethod(ctor, "FaceRecognizer.createLBPHFaceRecognizer", CreateLBPH);
+  OpStats::SetMethod(ctor, "FaceRecognizer.createEigenFaceRecognizer", CreateEigen);
+  OpStats::SetMethod(ctor, "FaceRecognizer.createFisherFaceRecognizer", CreateFisher);
 
-  Nan::SetPrototypeMethod(ctor, "trainSync", TrainSync);
-  Nan::SetPrototypeMethod(ctor, "train", Train);
-  Nan::SetPrototypeMethod(ctor, "updateSync", UpdateSync);
-  Nan::SetPrototypeMethod(ctor, "predictSync", PredictSync);
-  Nan::SetPrototypeMethod(ctor, "predict", Predict);
-  Nan::SetPrototypeMethod(ctor, "saveSync", SaveSync);
-  Nan::SetPrototypeMethod(ctor, "loadSync", LoadSync);
+  OpStats::SetPrototypeMethod(ctor, "FaceRecognizer.trainSync", TrainSync);
+  OpStats::SetPrototypeMethod(ctor, "FaceRecognizer.train", Train);
+  OpStats::SetPrototypeMethod(ctor, "FaceRecognizer.updateSync", UpdateSync);
+  OpStats::SetPrototypeMethod(ctor, "FaceRecognizer.predictSync", PredictSync);
+  OpStats::SetPrototypeMethod(ctor, "FaceRecognizer.predict", Predict);
+  OpStats::SetPrototypeMethod(ctor, "FaceRecognizer.saveSync", SaveSync);
+  OpStats::SetPrototypeMethod(ctor, "FaceRecognizer.loadSync", LoadSync);
 
-  Nan::SetPrototypeMethod(ctor, "getMat", GetMat);
+  OpStats::SetPrototypeMethod(ctor, "FaceRecognizer.getMat", GetMat);
 
-  target->Set(Nan::New("FaceRecognizer").ToLocalChecked(), ctor->GetFunction());
+  Nan::Set(target, Nan::New("FaceRecognizer").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 };
 
 NAN_METHOD(FaceRecognizerWrap::New) {
@@ -90,7 +92,7 @@ NAN_METHOD(FaceRecognizerWrap::CreateLBPH) {
   INT_FROM_ARGS(grid_y, 3)
   DOUBLE_FROM_ARGS(threshold, 4)
 
-  Local<Object> n = Nan::New(FaceRecognizerWrap::constructor)->GetFunction()->NewInstance();
+  Local<Object> n = Nan::NewInstance(Nan::GetFunction(Nan::New(FaceRecognizerWrap::constructor)).ToLocalChecked()).ToLocalChecked();
   cv::Ptr<cv::FaceRecognizer> f = cv::createLBPHFaceRecognizer(radius,
       neighbors, grid_x, grid_y, threshold);
   FaceRecognizerWrap *pt = new FaceRecognizerWrap(f, LBPH);
@@ -108,7 +110,7 @@ NAN_METHOD(FaceRecognizerWrap::CreateEigen) {
   INT_FROM_ARGS(components, 0)
   DOUBLE_FROM_ARGS(threshold, 1)
 
-  Local<Object> n = Nan::New(FaceRecognizerWrap::constructor)->GetFunction()->NewInstance();
+  Local<Object> n = Nan::NewInstance(Nan::GetFunction(Nan::New(FaceRecognizerWrap::constructor)).ToLocalChecked()).ToLocalChecked();
   cv::Ptr<cv::FaceRecognizer> f = cv::createEigenFaceRecognizer(components,
       threshold);
   FaceRecognizerWrap *pt = new FaceRecognizerWrap(f, EIGEN);
@@ -126,7 +128,7 @@ NAN_METHOD(FaceRecognizerWrap::CreateFisher) {
   INT_FROM_ARGS(components, 0)
   DOUBLE_FROM_ARGS(threshold, 1)
 
-  Local<Object> n = Nan::New(FaceRecognizerWrap::constructor)->GetFunction()->NewInstance();
+  Local<Object> n = Nan::NewInstance(Nan::GetFunction(Nan::New(FaceRecognizerWrap::constructor)).ToLocalChecked()).ToLocalChecked();
 
   cv::Ptr<cv::FaceRecognizer> f = cv::createFisherFaceRecognizer(components,
       threshold);
@@ -155,7 +157,7 @@ Local<Value> UnwrapTrainingData(Nan::NAN_METHOD_ARGS_TYPE info,
 
   const uint32_t length = tuples->Length();
   for (uint32_t i = 0; i < length; ++i) {
-    const Local<Value> val = tuples->Get(i);
+    const Local<Value> val = Nan::Get(tuples, i).ToLocalChecked();
 
     if (!val->IsArray()) {
       JSTHROW("train takes a list of [label, image] tuples")
@@ -163,12 +165,12 @@ Local<Value> UnwrapTrainingData(Nan::NAN_METHOD_ARGS_TYPE info,
 
     Local<Array> valarr = Local<Array>::Cast(val);
 
-    if (valarr->Length() != 2 || !valarr->Get(0)->IsInt32()) {
+    if (valarr->Length() != 2 || !Nan::Get(valarr, 0).ToLocalChecked()->IsInt32()) {
       JSTHROW("train takes a list of [label, image] tuples")
     }
 
-    int label = valarr->Get(0)->Uint32Value();
-    cv::Mat im = fromMatrixOrFilename(valarr->Get(1));
+    int label = Nan::To<uint32_t>(Nan::Get(valarr, 0).ToLocalChecked()).FromJust();
+    cv::Mat im = fromMatrixOrFilename(Nan::Get(valarr, 1).ToLocalChecked());
     im = im.clone();
     if (im.channels() == 3) {
       cv::cvtColor(im, im, CV_RGB2GRAY);
@@ -196,11 +198,11 @@ NAN_METHOD(FaceRecognizerWrap::TrainSync) {
   return;
 }
 
-class TrainASyncWorker: public Nan::AsyncWorker {
+class TrainASyncWorker: public AsyncBaseWorker {
 public:
   TrainASyncWorker(Nan::Callback *callback, cv::Ptr<cv::FaceRecognizer> rec,
       cv::vector<cv::Mat> images, cv::vector<int> labels) :
-      Nan::AsyncWorker(callback),
+      AsyncBaseWorker(callback),
       rec(rec),
       images(images),
       labels(labels) {
@@ -210,7 +212,11 @@ public:
   }
 
   void Execute() {
-    this->rec->train(this->images, this->labels);
+    try {
+      this->rec->train(this->images, this->labels);
+    } catch (cv::Exception& e) {
+      SetErrorMessage(e.what());
+    }
   }
 
 private:
@@ -222,25 +228,24 @@ private:
 NAN_METHOD(FaceRecognizerWrap::Train) {
   SETUP_FUNCTION(FaceRecognizerWrap)
 
-  if (info.Length() < 2 || !(info[1]->IsFunction())) {
-    Nan::ThrowTypeError("Invalid number of arguments or invalid callback");
+  if (info.Length() < 1) {
+    return Nan::ThrowTypeError("Invalid number of arguments");
   }
 
   cv::vector<cv::Mat> images;
   cv::vector<int> labels;
 
-  REQ_FUN_ARG(1, cb);
-
   Local<Value> exception = UnwrapTrainingData(info, &images, &labels);
   if (!exception->IsUndefined()) {
     // FIXME: not too sure about returning exceptions like this
-    info.GetReturnValue().Set(exception);
+    return info.GetReturnValue().Set(exception);
   }
 
-  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new TrainASyncWorker(callback, self->rec, images, labels));
+  // Without a callback, train returns a promise
+  OPT_FUN_ARG(1, callback);
 
-  return;
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(
+      new TrainASyncWorker(callback, self->rec, images, labels)));
 }
 
 NAN_METHOD(FaceRecognizerWrap::UpdateSync) {
@@ -294,27 +299,39 @@ NAN_METHOD(FaceRecognizerWrap::PredictSync) {
 #endif
 
   v8::Local<v8::Object> res = Nan::New<Object>();
-  res->Set(Nan::New("id").ToLocalChecked(), Nan::New<Number>(predictedLabel));
-  res->Set(Nan::New("confidence").ToLocalChecked(), Nan::New<Number>(confidence));
+  Nan::Set(res, Nan::New("id").ToLocalChecked(), Nan::New<Number>(predictedLabel));
+  Nan::Set(res, Nan::New("confidence").ToLocalChecked(), Nan::New<Number>(confidence));
 
   info.GetReturnValue().Set(res);
 }
 
-class PredictASyncWorker: public Nan::AsyncWorker {
+class PredictASyncWorker: public AsyncBaseWorker {
 public:
-  PredictASyncWorker(Nan::Callback *callback, cv::Ptr<cv::FaceRecognizer> rec, cv::Mat im) :
-      Nan::AsyncWorker(callback),
+  PredictASyncWorker(Nan::Callback *callback, cv::Ptr<cv::FaceRecognizer> rec,
+      Local<Value> source, cv::Mat im) :
+      AsyncBaseWorker(callback),
       rec(rec),
       im(im) {
+    // `im` may share the data of a Matrix passed in
+    if (source->IsObject()) {
+      PinMatrix("matrix", Nan::To<Object>(source).ToLocalChecked());
+    }
     predictedLabel = -1;
     confidence = 0.0;
+    // predict has always called back with just the result
+    errorFirst = false;
   }
 
   ~PredictASyncWorker() {
   }
 
   void Execute() {
-     this->rec->predict(this->im, this->predictedLabel, this->confidence);
+    try {
+      this->rec->predict(this->im, this->predictedLabel, this->confidence);
+    } catch (cv::Exception& e) {
+      SetErrorMessage(e.what());
+      return;
+    }
 #if CV_MAJOR_VERSION >= 3
     // Older versions of OpenCV3 incorrectly returned label=0 at
     // confidence=DBL_MAX instead of label=-1 on failure.  This can be removed
@@ -327,22 +344,14 @@ public:
 #endif
   }
 
-  void HandleOKCallback() {
-    Nan::HandleScope scope;
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
 
     v8::Local<v8::Object> res = Nan::New<Object>();
-    res->Set(Nan::New("id").ToLocalChecked(), Nan::New<Number>(predictedLabel));
-    res->Set(Nan::New("confidence").ToLocalChecked(), Nan::New<Number>(confidence));
-
-    Local<Value> argv[] = {
-      res
-    };
+    Nan::Set(res, Nan::New("id").ToLocalChecked(), Nan::New<Number>(predictedLabel));
+    Nan::Set(res, Nan::New("confidence").ToLocalChecked(), Nan::New<Number>(confidence));
 
-    Nan::TryCatch try_catch;
-    callback->Call(1, argv);
-    if (try_catch.HasCaught()) {
-      Nan::FatalException(try_catch);
-    }
+    return scope.Escape(res);
   }
 
 private:
@@ -355,21 +364,20 @@ private:
 NAN_METHOD(FaceRecognizerWrap::Predict) {
   SETUP_FUNCTION(FaceRecognizerWrap)
 
-  if (info.Length() < 2 || !(info[1]->IsFunction())) {
-    Nan::ThrowTypeError("Invalid number of arguments or invalid callback");
+  if (info.Length() < 1) {
+    return Nan::ThrowTypeError("Invalid number of arguments");
   }
 
-  REQ_FUN_ARG(1, cb);
-
   cv::Mat im = fromMatrixOrFilename(info[0]);
   if (im.channels() == 3) {
     cv::cvtColor(im, im, CV_RGB2GRAY);
   }
 
-  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new PredictASyncWorker(callback, self->rec, im));
+  // Without a callback, predict returns a promise
+  OPT_FUN_ARG(1, callback);
 
-  return;
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(
+      new PredictASyncWorker(callback, self->rec, info[0], im)));
 }
 
 NAN_METHOD(FaceRecognizerWrap::SaveSync) {
@@ -377,7 +385,7 @@ NAN_METHOD(FaceRecognizerWrap::SaveSync) {
   if (!info[0]->IsString()) {
     JSTHROW("Save takes a filename")
   }
-  std::string filename = std::string(*Nan::Utf8String(info[0]->ToString()));
+  std::string filename = std::string(*Nan::Utf8String(Nan::To<String>(info[0]).ToLocalChecked()));
   self->rec->save(filename);
   return;
 }
@@ -387,7 +395,7 @@ NAN_METHOD(FaceRecognizerWrap::LoadSync) {
   if (!info[0]->IsString()) {
     JSTHROW("Load takes a filename")
   }
-  std::string filename = std::string(*Nan::Utf8String(info[0]->ToString()));
+  std::string filename = std::string(*Nan::Utf8String(Nan::To<String>(info[0]).ToLocalChecked()));
   self->rec->load(filename);
   return;
 }
@@ -397,7 +405,7 @@ NAN_METHOD(FaceRecognizerWrap::GetMat) {
   if (!info[0]->IsString()) {
     JSTHROW("getMat takes a key")
   }
-  std::string key = std::string(*Nan::Utf8String(info[0]->ToString()));
+  std::string key = std::string(*Nan::Utf8String(Nan::To<String>(info[0]).ToLocalChecked()));
   cv::Mat m;
 #if CV_MAJOR_VERSION >= 3
   cv::face::BasicFaceRecognizer *bfr =
@@ -420,9 +428,10 @@ NAN_METHOD(FaceRecognizerWrap::GetMat) {
   m = self->rec->getMat(key);
 #endif
 
-  Local<Object> im = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> im = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im);
   img->mat = m;
+  img->SyncExternalMemory();
 
   info.GetReturnValue().Set(im);
 }
@@ -1,24 +1,27 @@
 #include "OpenCV.h"
+#include "OpStats.h"
 
 #if ((CV_MAJOR_VERSION == 2) && (CV_MINOR_VERSION >=4))
 #include "Features2d.h"
 #include "Matrix.h"
+#include "AsyncBaseWorker.h"
 #include <nan.h>
 #include <stdio.h>
 
 void Features::Init(Local<Object> target) {
   Nan::HandleScope scope;
 
-  Nan::SetMethod(target, "ImageSimilarity", Similarity);
+  OpStats::SetMethod(target, "ImageSimilarity", Similarity);
 }
 
-class AsyncDetectSimilarity: public Nan::AsyncWorker {
+class AsyncDetectSimilarity: public AsyncBaseWorker {
 public:
-  AsyncDetectSimilarity(Nan::Callback *callback, cv::Mat image1, cv::Mat image2) :
-      Nan::AsyncWorker(callback),
-      image1(image1),
-      image2(image2),
+  AsyncDetectSimilarity(Nan::Callback *callback, Local<Object> matrix1,
+      Local<Object> matrix2) :
+      AsyncBaseWorker(callback),
       dissimilarity(0) {
+    image1 = PinMatrix("image1", matrix1);
+    image2 = PinMatrix("image2", matrix2);
   }
 
   ~AsyncDetectSimilarity() {
@@ -80,15 +83,9 @@ public:
     dissimilarity = (double) good_matches_sum / (double) good_matches.size();
   }
 
-  void HandleOKCallback() {
-    Nan::HandleScope scope;
-
-    Local<Value> argv[2];
-
-    argv[0] = Nan::Null();
-    argv[1] = Nan::New<Number>(dissimilarity);
-
-    callback->Call(2, argv);
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
+    return scope.Escape(Nan::New<Number>(dissimilarity));
   }
 
 private:
@@ -100,15 +97,20 @@ private:
 NAN_METHOD(Features::Similarity) {
   Nan::HandleScope scope;
 
-  REQ_FUN_ARG(2, cb);
+  if (info.Length() < 2) {
+    return Nan::ThrowTypeError("ImageSimilarity takes two matrices");
+  }
 
-  cv::Mat image1 = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject())->mat;
-  cv::Mat image2 = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject())->mat;
+  if (!Nan::New(Matrix::constructor)->HasInstance(info[0]) ||
+      !Nan::New(Matrix::constructor)->HasInstance(info[1])) {
+    return Nan::ThrowTypeError("ImageSimilarity takes two matrices");
+  }
 
-  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
+  // Without a callback, ImageSimilarity returns a promise
+  OPT_FUN_ARG(2, callback);
 
-  Nan::AsyncQueueWorker( new AsyncDetectSimilarity(callback, image1, image2) );
-  return;
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(
+      new AsyncDetectSimilarity(callback, Nan::To<Object>(info[0]).ToLocalChecked(), Nan::To<Object>(info[1]).ToLocalChecked())));
 }
 
 #endif
@@ -0,0 +1,145 @@
+#include "FramePrefetcher.h"
+#include "MatrixPool.h"
+#include "OpenCV.h"
+
+FramePrefetcher::FramePrefetcher(cv::VideoCapture *cap, PooledAllocator *pool,
+    size_t capacity, bool dropOldest) :
+    cap(cap),
+    pool(pool),
+    capacity(capacity),
+    dropOldest(dropOldest),
+    stopping(false),
+    ended(false),
+    joined(false),
+    refs(1) {
+  if (pool) {
+    pool->Ref();
+  }
+  uv_mutex_init(&mutex);
+  uv_cond_init(&changed);
+  uv_thread_create(&thread, ThreadMain, this);
+}
+
+FramePrefetcher::~FramePrefetcher() {
+  Stop();
+  frames.clear();
+  uv_cond_destroy(&changed);
+  uv_mutex_destroy(&mutex);
+  if (pool) {
+    pool->Unref();
+  }
+}
+
+void FramePrefetcher::Ref() {
+  refs++;
+}
+
+void FramePrefetcher::Unref() {
+  if (--refs == 0) {
+    delete this;
+  }
+}
+
+void FramePrefetcher::Stop() {
+  if (joined) {
+    return;
+  }
+
+  uv_mutex_lock(&mutex);
+  stopping = true;
+  uv_cond_broadcast(&changed);
+  uv_mutex_unlock(&mutex);
+
+  // At most waits for the frame being decoded
+  uv_thread_join(&thread);
+  joined = true;
+}
+
+void FramePrefetcher::ThreadMain(void *arg) {
+  static_cast<FramePrefetcher*>(arg)->Run();
+}
+
+void FramePrefetcher::Run() {
+  for (;;) {
+    uv_mutex_lock(&mutex);
+    while (!dropOldest && frames.size() >= capacity && !stopping) {
+      uv_cond_wait(&changed, &mutex);
+    }
+    bool stop = stopping;
+    uv_mutex_unlock(&mutex);
+
+    if (stop) {
+      break;
+    }
+
+    cv::Mat frame;
+    if (pool) {
+      frame.allocator = pool;
+    }
+    bool ok;
+    try {
+      ok = cap->read(frame) && !frame.empty();
+    } catch (cv::Exception&) {
+      ok = false;
+    }
+
+    uv_mutex_lock(&mutex);
+    if (ok) {
+      if (frames.size() >= capacity) {
+        frames.pop_front();
+      }
+      frames.push_back(frame);
+    } else {
+      ended = true;
+    }
+    uv_cond_broadcast(&changed);
+    uv_mutex_unlock(&mutex);
+
+    if (!ok) {
+      break;
+    }
+  }
+
+  uv_mutex_lock(&mutex);
+  ended = true;
+  uv_cond_broadcast(&changed);
+  uv_mutex_unlock(&mutex);
+}
+
+bool FramePrefetcher::Next(cv::Mat &frame) {
+  uv_mutex_lock(&mutex);
+  while (frames.empty() && !ended) {
+    uv_cond_wait(&changed, &mutex);
+  }
+
+  bool found = !frames.empty();
+  if (found) {
+    frame = frames.front();
+    frames.pop_front();
+    uv_cond_broadcast(&changed);
+  }
+  uv_mutex_unlock(&mutex);
+
+  return found;
+}
+
+bool FramePrefetcher::Latest(cv::Mat &frame) {
+  uv_mutex_lock(&mutex);
+  bool found = !frames.empty();
+  if (found) {
+    frame = frames.back();
+    frames.clear();
+    uv_cond_broadcast(&changed);
+  }
+  uv_mutex_unlock(&mutex);
+
+  return found;
+}
+
+size_t FramePrefetcher::Depth() {
+  uv_mutex_lock(&mutex);
+  size_t depth = frames.size();
+  uv_mutex_unlock(&mutex);
+
+  return depth;
+}
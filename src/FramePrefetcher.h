@@ -0,0 +1,60 @@
+#include "OpenCV.h"
+
+#include <deque>
+
+class PooledAllocator;
+
+// Decodes frames from a cv::VideoCapture on a thread of its own, into a
+// bounded queue of frames ahead of the reader.
+//
+// When the queue is full, the "dropOldest" policy discards its oldest frame,
+// so readers always get recent frames. The "block" policy makes the decode
+// thread wait for room instead, so no frame is lost.
+//
+// The capture must not be touched by anyone else until Stop() returns.
+// Readers that run on worker threads hold a reference (Ref/Unref, main thread
+// only) so the queue outlives them.
+class FramePrefetcher {
+public:
+  FramePrefetcher(cv::VideoCapture *cap, PooledAllocator *pool,
+      size_t capacity, bool dropOldest);
+
+  void Ref();
+  void Unref();
+
+  // Stops the decode thread and waits for it. Frames already decoded can
+  // still be read.
+  void Stop();
+
+  // Waits for the next frame. Returns false once the video has ended or the
+  // prefetcher was stopped with nothing left in the queue.
+  bool Next(cv::Mat &frame);
+
+  // Takes the newest frame without waiting and drops the older ones. Returns
+  // false if no frame is ready.
+  bool Latest(cv::Mat &frame);
+
+  size_t Depth();
+
+private:
+  ~FramePrefetcher();
+
+  static void ThreadMain(void *arg);
+  void Run();
+
+  cv::VideoCapture *cap;
+  PooledAllocator *pool;
+  size_t capacity;
+  bool dropOldest;
+
+  uv_thread_t thread;
+  uv_mutex_t mutex;
+  // Broadcast whenever the queue or the state below changes
+  uv_cond_t changed;
+  std::deque<cv::Mat> frames;
+  bool stopping;
+  bool ended;
+  bool joined;
+
+  unsigned int refs;
+};
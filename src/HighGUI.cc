@@ -1,5 +1,6 @@
 #include "HighGUI.h"
 #include "OpenCV.h"
+#include "OpStats.h"
 #include "Matrix.h"
 
 Nan::Persistent<FunctionTemplate> NamedWindow::constructor;
@@ -14,11 +15,11 @@ void NamedWindow::Init(Local<Object> target) {
   ctor->SetClassName(Nan::New("NamedWindow").ToLocalChecked());
 
   // Prototype
-  Nan::SetPrototypeMethod(ctor, "show", Show);
-  Nan::SetPrototypeMethod(ctor, "destroy", Destroy);
-  Nan::SetPrototypeMethod(ctor, "blockingWaitKey", BlockingWaitKey);
+  OpStats::SetPrototypeMethod(ctor, "NamedWindow.show", Show);
+  OpStats::SetPrototypeMethod(ctor, "NamedWindow.destroy", Destroy);
+  OpStats::SetPrototypeMethod(ctor, "NamedWindow.blockingWaitKey", BlockingWaitKey);
 
-  target->Set(Nan::New("NamedWindow").ToLocalChecked(), ctor->GetFunction());
+  Nan::Set(target, Nan::New("NamedWindow").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 };
 
 NAN_METHOD(NamedWindow::New) {
@@ -30,9 +31,9 @@ NAN_METHOD(NamedWindow::New) {
 
   NamedWindow* win;
   if (info.Length() == 1) {
-    win = new NamedWindow(std::string(*Nan::Utf8String(info[0]->ToString())), 0);
+    win = new NamedWindow(std::string(*Nan::Utf8String(Nan::To<String>(info[0]).ToLocalChecked())), 0);
   } else {  //if (info.Length() == 2){
-    win = new NamedWindow(std::string(*Nan::Utf8String(info[0]->ToString())), 0);
+    win = new NamedWindow(std::string(*Nan::Utf8String(Nan::To<String>(info[0]).ToLocalChecked())), 0);
   }
 
   win->Wrap(info.Holder());
@@ -47,7 +48,7 @@ NamedWindow::NamedWindow(const std::string& name, int f) {
 
 NAN_METHOD(NamedWindow::Show) {
   SETUP_FUNCTION(NamedWindow)
-  Matrix *im = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *im = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
 
   try {
     cv::imshow(self->winname, im->mat);
@@ -71,10 +72,10 @@ NAN_METHOD(NamedWindow::BlockingWaitKey) {
   int time = 0;
 
   if (info.Length() > 1) {
-    time = info[1]->IntegerValue();
+    time = Nan::To<int64_t>(info[1]).FromJust();
   } else {
     if (info.Length() > 0) {
-      time = info[0]->IntegerValue();
+      time = Nan::To<int64_t>(info[0]).FromJust();
     }
   }
 
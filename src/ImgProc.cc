@@ -1,17 +1,18 @@
 #include "ImgProc.h"
 #include "Matrix.h"
+#include "OpStats.h"
 
 void ImgProc::Init(Local<Object> target) {
   Nan::Persistent<Object> inner;
   Local<Object> obj = Nan::New<Object>();
   inner.Reset(obj);
 
-  Nan::SetMethod(obj, "undistort", Undistort);
-  Nan::SetMethod(obj, "initUndistortRectifyMap", InitUndistortRectifyMap);
-  Nan::SetMethod(obj, "remap", Remap);
-  Nan::SetMethod(obj, "getStructuringElement", GetStructuringElement);
+  OpStats::SetMethod(obj, "imgproc.undistort", Undistort);
+  OpStats::SetMethod(obj, "imgproc.initUndistortRectifyMap", InitUndistortRectifyMap);
+  OpStats::SetMethod(obj, "imgproc.remap", Remap);
+  OpStats::SetMethod(obj, "imgproc.getStructuringElement", GetStructuringElement);
 
-  target->Set(Nan::New("imgproc").ToLocalChecked(), obj);
+  Nan::Set(target, Nan::New("imgproc").ToLocalChecked(), obj);
 }
 
 // cv::undistort
@@ -22,15 +23,15 @@ NAN_METHOD(ImgProc::Undistort) {
     // Get the arguments
 
     // Arg 0 is the image
-    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
     cv::Mat inputImage = m0->mat;
 
     // Arg 1 is the camera matrix
-    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
     cv::Mat K = m1->mat;
 
     // Arg 2 is the distortion coefficents
-    Matrix* m2 = Nan::ObjectWrap::Unwrap<Matrix>(info[2]->ToObject());
+    Matrix* m2 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[2]).ToLocalChecked());
     cv::Mat dist = m2->mat;
 
     // Make an mat to hold the result image
@@ -40,9 +41,10 @@ NAN_METHOD(ImgProc::Undistort) {
     cv::undistort(inputImage, outputImage, K, dist);
 
     // Wrap the output image
-    Local<Object> outMatrixWrap = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+    Local<Object> outMatrixWrap = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix *outMatrix = Nan::ObjectWrap::Unwrap<Matrix>(outMatrixWrap);
     outMatrix->mat = outputImage;
+    outMatrix->SyncExternalMemory();
 
     // Return the output image
     info.GetReturnValue().Set(outMatrixWrap);
@@ -59,32 +61,32 @@ NAN_METHOD(ImgProc::InitUndistortRectifyMap) {
 
   try {
     // Arg 0 is the camera matrix
-    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
     cv::Mat K = m0->mat;
 
     // Arg 1 is the distortion coefficents
-    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
     cv::Mat dist = m1->mat;
 
     // Arg 2 is the recification transformation
-    Matrix* m2 = Nan::ObjectWrap::Unwrap<Matrix>(info[2]->ToObject());
+    Matrix* m2 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[2]).ToLocalChecked());
     cv::Mat R = m2->mat;
 
     // Arg 3 is the new camera matrix
-    Matrix* m3 = Nan::ObjectWrap::Unwrap<Matrix>(info[3]->ToObject());
+    Matrix* m3 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[3]).ToLocalChecked());
     cv::Mat newK = m3->mat;
 
     // Arg 4 is the image size
     cv::Size imageSize;
     if (info[4]->IsArray()) {
-      Local<Object> v8sz = info[4]->ToObject();
-      imageSize = cv::Size(v8sz->Get(1)->IntegerValue(), v8sz->Get(0)->IntegerValue());
+      Local<Object> v8sz = Nan::To<Object>(info[4]).ToLocalChecked();
+      imageSize = cv::Size(Nan::To<int64_t>(Nan::Get(v8sz, 1).ToLocalChecked()).FromJust(), Nan::To<int64_t>(Nan::Get(v8sz, 0).ToLocalChecked()).FromJust());
     } else {
       JSTHROW_TYPE("Must pass image size");
     }
 
     // Arg 5 is the first map type, skip for now
-    int m1type = info[5]->IntegerValue();
+    int m1type = Nan::To<int64_t>(info[5]).FromJust();
 
     // Make matrices to hold the output maps
     cv::Mat map1, map2;
@@ -93,18 +95,20 @@ NAN_METHOD(ImgProc::InitUndistortRectifyMap) {
     cv::initUndistortRectifyMap(K, dist, R, newK, imageSize, m1type, map1, map2);
 
     // Wrap the output maps
-    Local<Object> map1Wrap = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+    Local<Object> map1Wrap = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix *map1Matrix = Nan::ObjectWrap::Unwrap<Matrix>(map1Wrap);
     map1Matrix->mat = map1;
+    map1Matrix->SyncExternalMemory();
 
-    Local<Object> map2Wrap = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+    Local<Object> map2Wrap = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix *map2Matrix = Nan::ObjectWrap::Unwrap<Matrix>(map2Wrap);
     map2Matrix->mat = map2;
+    map2Matrix->SyncExternalMemory();
 
     // Make a return object with the two maps
     Local<Object> ret = Nan::New<Object>();
-    ret->Set(Nan::New<String>("map1").ToLocalChecked(), map1Wrap);
-    ret->Set(Nan::New<String>("map2").ToLocalChecked(), map2Wrap);
+    Nan::Set(ret, Nan::New<String>("map1").ToLocalChecked(), map1Wrap);
+    Nan::Set(ret, Nan::New<String>("map2").ToLocalChecked(), map2Wrap);
 
     // Return the maps
     info.GetReturnValue().Set(ret);
@@ -123,19 +127,19 @@ NAN_METHOD(ImgProc::Remap) {
     // Get the arguments
 
     // Arg 0 is the image
-    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
     cv::Mat inputImage = m0->mat;
 
     // Arg 1 is the first map
-    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
     cv::Mat map1 = m1->mat;
 
     // Arg 2 is the second map
-    Matrix* m2 = Nan::ObjectWrap::Unwrap<Matrix>(info[2]->ToObject());
+    Matrix* m2 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[2]).ToLocalChecked());
     cv::Mat map2 = m2->mat;
 
     // Arg 3 is the interpolation mode
-    int interpolation = info[3]->IntegerValue();
+    int interpolation = Nan::To<int64_t>(info[3]).FromJust();
 
     // Args 4, 5 border settings, skipping for now
 
@@ -146,9 +150,10 @@ NAN_METHOD(ImgProc::Remap) {
     cv::remap(inputImage, outputImage, map1, map2, interpolation);
 
     // Wrap the output image
-    Local<Object> outMatrixWrap = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+    Local<Object> outMatrixWrap = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix *outMatrix = Nan::ObjectWrap::Unwrap<Matrix>(outMatrixWrap);
     outMatrix->mat = outputImage;
+    outMatrix->SyncExternalMemory();
 
     // Return the image
     info.GetReturnValue().Set(outMatrixWrap);
@@ -174,23 +179,24 @@ NAN_METHOD(ImgProc::GetStructuringElement) {
     if (!info[0]->IsNumber()) {
       JSTHROW_TYPE("'shape' argument must be a number");
     }
-    int shape = info[0]->NumberValue();
+    int shape = Nan::To<double>(info[0]).FromJust();
 
     // Arg 1 is the size of the structuring element
     cv::Size ksize;
     if (!info[1]->IsArray()) {
       JSTHROW_TYPE("'ksize' argument must be a 2 double array");
     }
-    Local<Object> v8sz = info[1]->ToObject();
-    ksize = cv::Size(v8sz->Get(0)->IntegerValue(), v8sz->Get(1)->IntegerValue());
+    Local<Object> v8sz = Nan::To<Object>(info[1]).ToLocalChecked();
+    ksize = cv::Size(Nan::To<int64_t>(Nan::Get(v8sz, 0).ToLocalChecked()).FromJust(), Nan::To<int64_t>(Nan::Get(v8sz, 1).ToLocalChecked()).FromJust());
 
     // GetStructuringElement
     cv::Mat mat = cv::getStructuringElement(shape, ksize);
 
     // Wrap the output image
-    Local<Object> outMatrixWrap = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+    Local<Object> outMatrixWrap = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix *outMatrix = ObjectWrap::Unwrap<Matrix>(outMatrixWrap);
     outMatrix->mat = mat;
+    outMatrix->SyncExternalMemory();
 
     // Return the image
     info.GetReturnValue().Set(outMatrixWrap);
@@ -1,4 +1,5 @@
 #include "OpenCV.h"
+#include "OpStats.h"
 
 #if CV_MAJOR_VERSION >= 3
 #warning TODO: port me to OpenCV 3
@@ -20,10 +21,10 @@ void LDAWrap::Init(Local<Object> target) {
   ctor->InstanceTemplate()->SetInternalFieldCount(1);
   ctor->SetClassName(Nan::New("LDA").ToLocalChecked());
 
-  Nan::SetMethod(ctor, "subspaceProject", SubspaceProject);
-  Nan::SetMethod(ctor, "subspaceReconstruct", SubspaceReconstruct);
+  OpStats::SetMethod(ctor, "LDA.subspaceProject", SubspaceProject);
+  OpStats::SetMethod(ctor, "LDA.subspaceReconstruct", SubspaceReconstruct);
 
-  target->Set(Nan::New("LDA").ToLocalChecked(), ctor->GetFunction());
+  Nan::Set(target, Nan::New("LDA").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 };
 
 NAN_METHOD(LDAWrap::New) {
@@ -51,19 +52,20 @@ NAN_METHOD(LDAWrap::SubspaceProject) {
   }
 
   // param 0 - eigenvectors
-  Matrix *w = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *w = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
 
   // param 1 - mean
-  Matrix *mean = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+  Matrix *mean = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
 
   // param 2 - src
-  Matrix *src = Nan::ObjectWrap::Unwrap<Matrix>(info[2]->ToObject());
+  Matrix *src = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[2]).ToLocalChecked());
 
   cv::Mat m = cv::subspaceProject(w->mat, mean->mat, src->mat);
 
-  Local<Object> im = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> im = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im);
   img->mat = m;
+  img->SyncExternalMemory();
 
   info.GetReturnValue().Set(im);
 }
@@ -77,19 +79,20 @@ NAN_METHOD(LDAWrap::SubspaceReconstruct) {
   }
 
   // param 0 - eigenvectors
-  Matrix *w = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *w = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
 
   // param 1 - mean
-  Matrix *mean = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+  Matrix *mean = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
 
   // param 2 - src
-  Matrix *src = Nan::ObjectWrap::Unwrap<Matrix>(info[2]->ToObject());
+  Matrix *src = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[2]).ToLocalChecked());
 
   cv::Mat m = cv::subspaceReconstruct(w->mat, mean->mat, src->mat);
 
-  Local<Object> im = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> im = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im);
   img->mat = m;
+  img->SyncExternalMemory();
 
   info.GetReturnValue().Set(im);
 }
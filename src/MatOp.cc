@@ -0,0 +1,447 @@
+#include "MatOp.h"
+#include "Matrix.h"
+#include "OpenCV.h"
+#include <nan.h>
+
+cv::Scalar setColor(Local<Object> objColor);
+
+int ColorConversionCode(const std::string &name) {
+  static const struct {
+    const char *name;
+    int code;
+  } codes[] = {
+    {"CV_BGR2GRAY", CV_BGR2GRAY},
+    {"CV_GRAY2BGR", CV_GRAY2BGR},
+    {"CV_BGR2XYZ", CV_BGR2XYZ},
+    {"CV_XYZ2BGR", CV_XYZ2BGR},
+    {"CV_BGR2YCrCb", CV_BGR2YCrCb},
+    {"CV_YCrCb2BGR", CV_YCrCb2BGR},
+    {"CV_BGR2HSV", CV_BGR2HSV},
+    {"CV_HSV2BGR", CV_HSV2BGR},
+    {"CV_BGR2HLS", CV_BGR2HLS},
+    {"CV_HLS2BGR", CV_HLS2BGR},
+    {"CV_BGR2Lab", CV_BGR2Lab},
+    {"CV_Lab2BGR", CV_Lab2BGR},
+    {"CV_BGR2Luv", CV_BGR2Luv},
+    {"CV_Luv2BGR", CV_Luv2BGR},
+    {"CV_BayerBG2BGR", CV_BayerBG2BGR},
+    {"CV_BayerGB2BGR", CV_BayerGB2BGR},
+    {"CV_BayerRG2BGR", CV_BayerRG2BGR},
+    {"CV_BayerGR2BGR", CV_BayerGR2BGR},
+    {"CV_BGR2RGB", CV_BGR2RGB}
+  };
+
+  for (size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); i++) {
+    if (name == codes[i].name) {
+      return codes[i].code;
+    }
+  }
+  return -1;
+}
+
+static bool HasArg(Local<Array> args, uint32_t i) {
+  return i < args->Length() && !Nan::Get(args, i).ToLocalChecked()->IsUndefined();
+}
+
+static double NumberArg(Local<Array> args, uint32_t i, double fallback) {
+  if (i < args->Length() && Nan::Get(args, i).ToLocalChecked()->IsNumber()) {
+    return Nan::To<double>(Nan::Get(args, i).ToLocalChecked()).FromJust();
+  }
+  return fallback;
+}
+
+static std::string StringArg(Local<Array> args, uint32_t i) {
+  return std::string(*Nan::Utf8String(Nan::Get(args, i).ToLocalChecked()));
+}
+
+static bool MatrixArg(Local<Array> args, uint32_t i, cv::Mat &mat) {
+  if (!HasArg(args, i) || !Nan::Get(args, i).ToLocalChecked()->IsObject() ||
+      !Nan::New(Matrix::constructor)->HasInstance(Nan::Get(args, i).ToLocalChecked())) {
+    return false;
+  }
+  mat = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(Nan::Get(args, i).ToLocalChecked()).ToLocalChecked())->mat;
+  return true;
+}
+
+class CvtColorOp: public MatOp {
+public:
+  CvtColorOp(int code, int channels = 0) :
+      code(code),
+      channels(channels) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    if (channels && src.channels() != channels) {
+      CV_Error(CV_StsBadArg, "Image is no 3-channel");
+    }
+    cv::cvtColor(src, dst, code);
+  }
+
+private:
+  int code;
+  int channels;
+};
+
+class GaussianBlurOp: public MatOp {
+public:
+  GaussianBlurOp(cv::Size ksize) :
+      ksize(ksize) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    cv::GaussianBlur(src, dst, ksize, 0);
+  }
+
+private:
+  cv::Size ksize;
+};
+
+class MedianBlurOp: public MatOp {
+public:
+  MedianBlurOp(int ksize) :
+      ksize(ksize) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    cv::medianBlur(src, dst, ksize);
+  }
+
+private:
+  int ksize;
+};
+
+class BilateralFilterOp: public MatOp {
+public:
+  BilateralFilterOp(int d, double sigmaColor, double sigmaSpace,
+      int borderType) :
+      d(d),
+      sigmaColor(sigmaColor),
+      sigmaSpace(sigmaSpace),
+      borderType(borderType) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    cv::bilateralFilter(src, dst, d, sigmaColor, sigmaSpace, borderType);
+  }
+
+private:
+  int d;
+  double sigmaColor;
+  double sigmaSpace;
+  int borderType;
+};
+
+class CannyOp: public MatOp {
+public:
+  CannyOp(int lowThresh, int highThresh) :
+      lowThresh(lowThresh),
+      highThresh(highThresh) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    cv::Canny(src, dst, lowThresh, highThresh);
+  }
+
+private:
+  int lowThresh;
+  int highThresh;
+};
+
+class MorphologyOp: public MatOp {
+public:
+  MorphologyOp(bool dilate, int niters, cv::Mat kernel) :
+      dilate(dilate),
+      niters(niters),
+      kernel(kernel) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    if (dilate) {
+      cv::dilate(src, dst, kernel, cv::Point(-1, -1), niters);
+    } else {
+      cv::erode(src, dst, kernel, cv::Point(-1, -1), niters);
+    }
+  }
+
+private:
+  bool dilate;
+  int niters;
+  cv::Mat kernel;
+};
+
+class ThresholdOp: public MatOp {
+public:
+  ThresholdOp(double threshold, double maxVal, int typ) :
+      threshold(threshold),
+      maxVal(maxVal),
+      typ(typ) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    cv::threshold(src, dst, threshold, maxVal, typ);
+  }
+
+private:
+  double threshold;
+  double maxVal;
+  int typ;
+};
+
+class AdaptiveThresholdOp: public MatOp {
+public:
+  AdaptiveThresholdOp(double maxVal, int adaptiveMethod, int thresholdType,
+      int blockSize, double C) :
+      maxVal(maxVal),
+      adaptiveMethod(adaptiveMethod),
+      thresholdType(thresholdType),
+      blockSize(blockSize),
+      C(C) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    cv::adaptiveThreshold(src, dst, maxVal, adaptiveMethod, thresholdType,
+        blockSize, C);
+  }
+
+private:
+  double maxVal;
+  int adaptiveMethod;
+  int thresholdType;
+  int blockSize;
+  double C;
+};
+
+class ResizeOp: public MatOp {
+public:
+  ResizeOp(cv::Size size, int interpolation) :
+      size(size),
+      interpolation(interpolation) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    cv::resize(src, dst, size, 0, 0, interpolation);
+  }
+
+private:
+  cv::Size size;
+  int interpolation;
+};
+
+class WarpAffineOp: public MatOp {
+public:
+  // A negative size means the size of the source, like Matrix.warpAffine
+  WarpAffineOp(cv::Mat transform, int width, int height) :
+      transform(transform),
+      width(width),
+      height(height) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    cv::Size size(width < 0 ? src.rows : width, height < 0 ? src.cols : height);
+    cv::warpAffine(src, dst, transform, size);
+  }
+
+private:
+  cv::Mat transform;
+  int width;
+  int height;
+};
+
+class WarpPerspectiveOp: public MatOp {
+public:
+  WarpPerspectiveOp(cv::Mat transform, cv::Size size, cv::Scalar borderColor) :
+      transform(transform),
+      size(size),
+      borderColor(borderColor) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    cv::warpPerspective(src, dst, transform, size, cv::INTER_LINEAR,
+        cv::BORDER_REPLICATE, borderColor);
+  }
+
+private:
+  cv::Mat transform;
+  cv::Size size;
+  cv::Scalar borderColor;
+};
+
+class FlipOp: public MatOp {
+public:
+  FlipOp(int flipCode) :
+      flipCode(flipCode) {
+  }
+
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    cv::flip(src, dst, flipCode);
+  }
+
+private:
+  int flipCode;
+};
+
+class EqualizeHistOp: public MatOp {
+public:
+  void Apply(const cv::Mat &src, cv::Mat &dst) {
+    cv::equalizeHist(src, dst);
+  }
+};
+
+// Same names as Matrix.threshold takes
+static int ThresholdType(Local<Array> args, std::string &error) {
+  int typ = cv::THRESH_BINARY;
+
+  if (HasArg(args, 2)) {
+    std::string name = StringArg(args, 2);
+    if (name == "Binary") {
+      // Uses default value
+    } else if (name == "Binary Inverted") {
+      typ = cv::THRESH_BINARY_INV;
+    } else if (name == "Threshold Truncated") {
+      typ = cv::THRESH_TRUNC;
+    } else if (name == "Threshold to Zero") {
+      typ = cv::THRESH_TOZERO;
+    } else if (name == "Threshold to Zero Inverted") {
+      typ = cv::THRESH_TOZERO_INV;
+    } else {
+      error = "\"" + name + "\" is no supported binarization technique";
+      return -1;
+    }
+  }
+
+  if (HasArg(args, 3)) {
+    std::string algorithm = StringArg(args, 3);
+    if (algorithm == "Otsu") {
+      typ += cv::THRESH_OTSU;
+    } else if (algorithm != "Simple") {
+      error = "\"" + algorithm + "\" is no supported threshold algorithm";
+      return -1;
+    }
+  }
+
+  return typ;
+}
+
+MatOp* MatOp::Create(const std::string &name, Local<Array> args,
+    std::string &error) {
+  if (name == "convertGrayscale") {
+    return new CvtColorOp(CV_BGR2GRAY, 3);
+  }
+
+  if (name == "convertHSVscale") {
+    return new CvtColorOp(CV_BGR2HSV, 3);
+  }
+
+  if (name == "cvtColor") {
+    int code = -1;
+    if (HasArg(args, 0)) {
+      code = Nan::Get(args, 0).ToLocalChecked()->IsNumber() ? (int) NumberArg(args, 0, -1) :
+          ColorConversionCode(StringArg(args, 0));
+    }
+    if (code < 0) {
+      error = "Conversion code is unsupported";
+      return NULL;
+    }
+    return new CvtColorOp(code);
+  }
+
+  if (name == "gaussianBlur") {
+    cv::Size ksize(5, 5);
+    if (HasArg(args, 0)) {
+      if (!Nan::Get(args, 0).ToLocalChecked()->IsArray()) {
+        error = "'ksize' argument must be a 2 double array";
+        return NULL;
+      }
+      Local<Array> size = Nan::Get(args, 0).ToLocalChecked().As<Array>();
+      ksize = cv::Size(NumberArg(size, 0, 5), NumberArg(size, 1, 5));
+    }
+    return new GaussianBlurOp(ksize);
+  }
+
+  if (name == "medianBlur") {
+    int ksize = NumberArg(args, 0, 3);
+    if (ksize <= 0 || (ksize % 2) == 0) {
+      error = "'ksize' argument must be a positive odd integer";
+      return NULL;
+    }
+    return new MedianBlurOp(ksize);
+  }
+
+  if (name == "bilateralFilter") {
+    return new BilateralFilterOp(NumberArg(args, 0, 15), NumberArg(args, 1, 80),
+        NumberArg(args, 2, 80), NumberArg(args, 3, cv::BORDER_DEFAULT));
+  }
+
+  if (name == "canny") {
+    return new CannyOp(NumberArg(args, 0, 0), NumberArg(args, 1, 0));
+  }
+
+  if (name == "dilate" || name == "erode") {
+    cv::Mat kernel;
+    if (HasArg(args, 1) && !MatrixArg(args, 1, kernel)) {
+      error = "kernel must be a Matrix";
+      return NULL;
+    }
+    return new MorphologyOp(name == "dilate", NumberArg(args, 0, 1), kernel);
+  }
+
+  if (name == "threshold") {
+    int typ = ThresholdType(args, error);
+    if (typ < 0) {
+      return NULL;
+    }
+    return new ThresholdOp(NumberArg(args, 0, 0), NumberArg(args, 1, 0), typ);
+  }
+
+  if (name == "adaptiveThreshold") {
+    return new AdaptiveThresholdOp(NumberArg(args, 0, 0), NumberArg(args, 1, 0),
+        NumberArg(args, 2, 0), NumberArg(args, 3, 3), NumberArg(args, 4, 0));
+  }
+
+  if (name == "resize") {
+    if (!HasArg(args, 1)) {
+      error = "resize takes a width and a height";
+      return NULL;
+    }
+    return new ResizeOp(cv::Size(NumberArg(args, 0, 0), NumberArg(args, 1, 0)),
+        NumberArg(args, 2, cv::INTER_LINEAR));
+  }
+
+  if (name == "warpAffine") {
+    cv::Mat transform;
+    if (!MatrixArg(args, 0, transform)) {
+      error = "warpAffine takes a transformation Matrix";
+      return NULL;
+    }
+    return new WarpAffineOp(transform, NumberArg(args, 1, -1), NumberArg(args, 2, -1));
+  }
+
+  if (name == "warpPerspective") {
+    cv::Mat transform;
+    if (!MatrixArg(args, 0, transform)) {
+      error = "warpPerspective takes a transformation Matrix";
+      return NULL;
+    }
+    cv::Scalar borderColor(0, 0, 255);
+    if (HasArg(args, 3) && Nan::Get(args, 3).ToLocalChecked()->IsArray()) {
+      borderColor = setColor(Nan::To<Object>(Nan::Get(args, 3).ToLocalChecked()).ToLocalChecked());
+    }
+    return new WarpPerspectiveOp(transform,
+        cv::Size(NumberArg(args, 1, 0), NumberArg(args, 2, 0)), borderColor);
+  }
+
+  if (name == "flip") {
+    if (!HasArg(args, 0) || !Nan::Get(args, 0).ToLocalChecked()->IsInt32()) {
+      error = "Flip requires an integer flipCode argument";
+      return NULL;
+    }
+    return new FlipOp(NumberArg(args, 0, 0));
+  }
+
+  if (name == "equalizeHist") {
+    return new EqualizeHistOp();
+  }
+
+  error = "Unknown operation \"" + name + "\"";
+  return NULL;
+}
@@ -0,0 +1,26 @@
+#include "OpenCV.h"
+
+#include <string>
+
+// A single image operation, read from `src` and written to `dst`.
+//
+// Ops are created on the main thread from an op name and its JS arguments,
+// which mirror the Matrix method of the same name (e.g. "gaussianBlur",
+// [[5, 5]]). After that they only touch cv::Mats, so `Apply` can run on any
+// thread. Failures are thrown as cv::Exception.
+class MatOp {
+public:
+  virtual ~MatOp() {}
+
+  // `src` and `dst` are never the same cv::Mat; `dst` may hold the buffer of
+  // an earlier step, which cv::Mat::create reuses when size and type match.
+  virtual void Apply(const cv::Mat &src, cv::Mat &dst) = 0;
+
+  // Returns NULL and sets `error` for an unknown op or bad arguments.
+  static MatOp* Create(const std::string &name, Local<Array> args,
+      std::string &error);
+};
+
+// Maps a conversion name such as "CV_BGR2GRAY" to its cv::cvtColor code, or
+// returns -1.
+int ColorConversionCode(const std::string &name);
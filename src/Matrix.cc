@@ -1,7 +1,12 @@
 #include "Contours.h"
 #include "Matrix.h"
+#include "MatrixPool.h"
+#include "AsyncBaseWorker.h"
+#include "MatOp.h"
 #include "OpenCV.h"
+#include "OpStats.h"
 #include <string.h>
+#include <map>
 #include <nan.h>
 
 Nan::Persistent<FunctionTemplate> Matrix::constructor;
@@ -19,102 +24,143 @@ void Matrix::Init(Local<Object> target) {
   ctor->InstanceTemplate()->SetInternalFieldCount(1);
   ctor->SetClassName(Nan::New("Matrix").ToLocalChecked());
 
+  // Header fields. On the instance template, so reads are own-property
+  // lookups that V8 can inline; channels stays a method for compatibility.
+  Local<ObjectTemplate> inst = ctor->InstanceTemplate();
+  PropertyAttribute readOnly = static_cast<PropertyAttribute>(ReadOnly | DontDelete);
+  Nan::SetAccessor(inst, Nan::New("rows").ToLocalChecked(), GetRows, 0,
+      Local<Value>(), DEFAULT, readOnly);
+  Nan::SetAccessor(inst, Nan::New("cols").ToLocalChecked(), GetCols, 0,
+      Local<Value>(), DEFAULT, readOnly);
+  Nan::SetAccessor(inst, Nan::New("type").ToLocalChecked(), GetType, 0,
+      Local<Value>(), DEFAULT, readOnly);
+  Nan::SetAccessor(inst, Nan::New("depth").ToLocalChecked(), GetDepth, 0,
+      Local<Value>(), DEFAULT, readOnly);
+  Nan::SetAccessor(inst, Nan::New("step").ToLocalChecked(), GetStep, 0,
+      Local<Value>(), DEFAULT, readOnly);
+  Nan::SetAccessor(inst, Nan::New("isContinuous").ToLocalChecked(),
+      GetIsContinuous, 0, Local<Value>(), DEFAULT, readOnly);
+  Nan::SetAccessor(inst, Nan::New("total").ToLocalChecked(), GetTotal, 0,
+      Local<Value>(), DEFAULT, readOnly);
+  Nan::SetAccessor(inst, Nan::New("elemSize").ToLocalChecked(), GetElemSize, 0,
+      Local<Value>(), DEFAULT, readOnly);
+
   // Prototype
-  Nan::SetPrototypeMethod(ctor, "row", Row);
-  Nan::SetPrototypeMethod(ctor, "col", Col);
-  Nan::SetPrototypeMethod(ctor, "pixelRow", PixelRow);
-  Nan::SetPrototypeMethod(ctor, "pixelCol", PixelCol);
-  Nan::SetPrototypeMethod(ctor, "empty", Empty);
-  Nan::SetPrototypeMethod(ctor, "get", Get);
-  Nan::SetPrototypeMethod(ctor, "set", Set);
-  Nan::SetPrototypeMethod(ctor, "put", Put);
-  Nan::SetPrototypeMethod(ctor, "brightness", Brightness);
-  Nan::SetPrototypeMethod(ctor, "normalize", Normalize);
-  Nan::SetPrototypeMethod(ctor, "norm", Norm);
-  Nan::SetPrototypeMethod(ctor, "getData", GetData);
-  Nan::SetPrototypeMethod(ctor, "pixel", Pixel);
-  Nan::SetPrototypeMethod(ctor, "width", Width);
-  Nan::SetPrototypeMethod(ctor, "height", Height);
-  Nan::SetPrototypeMethod(ctor, "size", Size);
-  Nan::SetPrototypeMethod(ctor, "clone", Clone);
-  Nan::SetPrototypeMethod(ctor, "crop", Crop);
-  Nan::SetPrototypeMethod(ctor, "toBuffer", ToBuffer);
-  Nan::SetPrototypeMethod(ctor, "toBufferAsync", ToBufferAsync);
-  Nan::SetPrototypeMethod(ctor, "ellipse", Ellipse);
-  Nan::SetPrototypeMethod(ctor, "rectangle", Rectangle);
-  Nan::SetPrototypeMethod(ctor, "line", Line);
-  Nan::SetPrototypeMethod(ctor, "fillPoly", FillPoly);
-  Nan::SetPrototypeMethod(ctor, "save", Save);
-  Nan::SetPrototypeMethod(ctor, "saveAsync", SaveAsync);
-  Nan::SetPrototypeMethod(ctor, "resize", Resize);
-  Nan::SetPrototypeMethod(ctor, "rotate", Rotate);
-  Nan::SetPrototypeMethod(ctor, "warpAffine", WarpAffine);
-  Nan::SetPrototypeMethod(ctor, "copyTo", CopyTo);
-  Nan::SetPrototypeMethod(ctor, "convertTo", ConvertTo);
-  Nan::SetPrototypeMethod(ctor, "pyrDown", PyrDown);
-  Nan::SetPrototypeMethod(ctor, "pyrUp", PyrUp);
-  Nan::SetPrototypeMethod(ctor, "channels", Channels);
-  Nan::SetPrototypeMethod(ctor, "convertGrayscale", ConvertGrayscale);
-  Nan::SetPrototypeMethod(ctor, "convertHSVscale", ConvertHSVscale);
-  Nan::SetPrototypeMethod(ctor, "gaussianBlur", GaussianBlur);
-  Nan::SetPrototypeMethod(ctor, "medianBlur", MedianBlur);
-  Nan::SetPrototypeMethod(ctor, "bilateralFilter", BilateralFilter);
-  Nan::SetPrototypeMethod(ctor, "sobel", Sobel);
-  Nan::SetPrototypeMethod(ctor, "copy", Copy);
-  Nan::SetPrototypeMethod(ctor, "flip", Flip);
-  Nan::SetPrototypeMethod(ctor, "roi", ROI);
-  Nan::SetPrototypeMethod(ctor, "ptr", Ptr);
-  Nan::SetPrototypeMethod(ctor, "absDiff", AbsDiff);
-  Nan::SetPrototypeMethod(ctor, "dct", Dct);
-  Nan::SetPrototypeMethod(ctor, "addWeighted", AddWeighted);
-  Nan::SetPrototypeMethod(ctor, "bitwiseXor", BitwiseXor);
-  Nan::SetPrototypeMethod(ctor, "bitwiseNot", BitwiseNot);
-  Nan::SetPrototypeMethod(ctor, "bitwiseAnd", BitwiseAnd);
-  Nan::SetPrototypeMethod(ctor, "countNonZero", CountNonZero);
-  Nan::SetPrototypeMethod(ctor, "moments", Moments);
-  Nan::SetPrototypeMethod(ctor, "canny", Canny);
-  Nan::SetPrototypeMethod(ctor, "dilate", Dilate);
-  Nan::SetPrototypeMethod(ctor, "erode", Erode);
-  Nan::SetPrototypeMethod(ctor, "findContours", FindContours);
-  Nan::SetPrototypeMethod(ctor, "drawContour", DrawContour);
-  Nan::SetPrototypeMethod(ctor, "drawAllContours", DrawAllContours);
-  Nan::SetPrototypeMethod(ctor, "goodFeaturesToTrack", GoodFeaturesToTrack);
-  Nan::SetPrototypeMethod(ctor, "houghLinesP", HoughLinesP);
-  Nan::SetPrototypeMethod(ctor, "crop", Crop);
-  Nan::SetPrototypeMethod(ctor, "houghCircles", HoughCircles);
-  Nan::SetPrototypeMethod(ctor, "inRange", inRange);
-  Nan::SetPrototypeMethod(ctor, "adjustROI", AdjustROI);
-  Nan::SetPrototypeMethod(ctor, "locateROI", LocateROI);
-  Nan::SetPrototypeMethod(ctor, "threshold", Threshold);
-  Nan::SetPrototypeMethod(ctor, "adaptiveThreshold", AdaptiveThreshold);
-  Nan::SetPrototypeMethod(ctor, "meanStdDev", MeanStdDev);
-  Nan::SetPrototypeMethod(ctor, "cvtColor", CvtColor);
-  Nan::SetPrototypeMethod(ctor, "split", Split);
-  Nan::SetPrototypeMethod(ctor, "merge", Merge);
-  Nan::SetPrototypeMethod(ctor, "equalizeHist", EqualizeHist);
-  Nan::SetPrototypeMethod(ctor, "floodFill", FloodFill);
-  Nan::SetPrototypeMethod(ctor, "matchTemplate", MatchTemplate);
-  Nan::SetPrototypeMethod(ctor, "matchTemplateByMatrix", MatchTemplateByMatrix);
-  Nan::SetPrototypeMethod(ctor, "templateMatches", TemplateMatches);
-  Nan::SetPrototypeMethod(ctor, "minMaxLoc", MinMaxLoc);
-  Nan::SetPrototypeMethod(ctor, "pushBack", PushBack);
-  Nan::SetPrototypeMethod(ctor, "putText", PutText);
-  Nan::SetPrototypeMethod(ctor, "getPerspectiveTransform", GetPerspectiveTransform);
-  Nan::SetPrototypeMethod(ctor, "warpPerspective", WarpPerspective);
-  Nan::SetMethod(ctor, "Zeros", Zeros);
-  Nan::SetMethod(ctor, "Ones", Ones);
-  Nan::SetMethod(ctor, "Eye", Eye);
-  Nan::SetMethod(ctor, "getRotationMatrix2D", GetRotationMatrix2D);
-  Nan::SetPrototypeMethod(ctor, "copyWithMask", CopyWithMask);
-  Nan::SetPrototypeMethod(ctor, "setWithMask", SetWithMask);
-  Nan::SetPrototypeMethod(ctor, "meanWithMask", MeanWithMask);
-  Nan::SetPrototypeMethod(ctor, "mean", Mean);
-  Nan::SetPrototypeMethod(ctor, "shift", Shift);
-  Nan::SetPrototypeMethod(ctor, "reshape", Reshape);
-  Nan::SetPrototypeMethod(ctor, "release", Release);
-  Nan::SetPrototypeMethod(ctor, "subtract", Subtract);
-
-  target->Set(Nan::New("Matrix").ToLocalChecked(), ctor->GetFunction());
+  OpStats::SetPrototypeMethod(ctor, "Matrix.row", Row);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.col", Col);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.pixelRow", PixelRow);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.pixelCol", PixelCol);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.getRegion", GetRegion);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.setRegion", SetRegion);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.rowData", RowData);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.colData", ColData);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.empty", Empty);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.get", Get);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.set", Set);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.put", Put);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.brightness", Brightness);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.normalize", Normalize);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.norm", Norm);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.getData", GetData);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.pixel", Pixel);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.width", Width);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.height", Height);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.size", Size);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.clone", Clone);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.crop", Crop);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.toBuffer", ToBuffer);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.toBufferAsync", ToBufferAsync);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.ellipse", Ellipse);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.rectangle", Rectangle);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.line", Line);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.fillPoly", FillPoly);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.save", Save);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.saveAsync", SaveAsync);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.resize", Resize);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.rotate", Rotate);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.warpAffine", WarpAffine);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.copyTo", CopyTo);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.convertTo", ConvertTo);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.pyrDown", PyrDown);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.pyrUp", PyrUp);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.channels", Channels);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.describe", Describe);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.convertGrayscale", ConvertGrayscale);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.convertHSVscale", ConvertHSVscale);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.gaussianBlur", GaussianBlur);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.medianBlur", MedianBlur);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.bilateralFilter", BilateralFilter);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.sobel", Sobel);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.copy", Copy);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.flip", Flip);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.roi", ROI);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.ptr", Ptr);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.absDiff", AbsDiff);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.dct", Dct);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.addWeighted", AddWeighted);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.bitwiseXor", BitwiseXor);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.bitwiseNot", BitwiseNot);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.bitwiseAnd", BitwiseAnd);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.countNonZero", CountNonZero);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.moments", Moments);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.canny", Canny);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.dilate", Dilate);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.erode", Erode);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.findContours", FindContours);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.drawContour", DrawContour);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.drawAllContours", DrawAllContours);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.goodFeaturesToTrack", GoodFeaturesToTrack);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.houghLinesP", HoughLinesP);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.crop", Crop);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.houghCircles", HoughCircles);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.inRange", inRange);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.adjustROI", AdjustROI);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.locateROI", LocateROI);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.threshold", Threshold);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.adaptiveThreshold", AdaptiveThreshold);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.meanStdDev", MeanStdDev);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.cvtColor", CvtColor);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.split", Split);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.merge", Merge);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.equalizeHist", EqualizeHist);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.floodFill", FloodFill);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.matchTemplate", MatchTemplate);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.matchTemplateByMatrix", MatchTemplateByMatrix);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.templateMatches", TemplateMatches);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.minMaxLoc", MinMaxLoc);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.pushBack", PushBack);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.putText", PutText);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.getPerspectiveTransform", GetPerspectiveTransform);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.warpPerspective", WarpPerspective);
+  OpStats::SetMethod(ctor, "Matrix.Zeros", Zeros);
+  OpStats::SetMethod(ctor, "Matrix.Ones", Ones);
+  OpStats::SetMethod(ctor, "Matrix.Eye", Eye);
+  OpStats::SetMethod(ctor, "Matrix.fromBuffer", FromBuffer);
+  OpStats::SetMethod(ctor, "Matrix.getRotationMatrix2D", GetRotationMatrix2D);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.copyWithMask", CopyWithMask);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.setWithMask", SetWithMask);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.meanWithMask", MeanWithMask);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.mean", Mean);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.shift", Shift);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.reshape", Reshape);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.release", Release);
+  OpStats::SetPrototypeMethod(ctor, "Matrix.subtract", Subtract);
+
+  // Async forms of the heavier image processing methods, such as
+  // im.gaussianBlurAsync([5, 5], cb)
+  static const char* asyncOps[] = {
+    "gaussianBlur", "medianBlur", "bilateralFilter", "canny", "resize",
+    "warpAffine", "warpPerspective", "cvtColor", "equalizeHist", "threshold",
+    "adaptiveThreshold"
+  };
+  for (size_t i = 0; i < sizeof(asyncOps) / sizeof(asyncOps[0]); i++) {
+    std::string key = std::string("Matrix.") + asyncOps[i] + "Async";
+    OpStats::SetPrototypeMethod(ctor, key.c_str(), OpAsync,
+        Nan::New(asyncOps[i]).ToLocalChecked());
+  }
+  OpStats::SetPrototypeMethod(ctor, "Matrix.matchTemplateAsync", MatchTemplateAsync);
+
+  Nan::Set(target, Nan::New("Matrix").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 };
 
 NAN_METHOD(Matrix::New) {
@@ -128,22 +174,23 @@ NAN_METHOD(Matrix::New) {
   if (info.Length() == 0) {
     mat = new Matrix;
   } else if (info.Length() == 2 && info[0]->IsInt32() && info[1]->IsInt32()) {
-    mat = new Matrix(info[0]->IntegerValue(), info[1]->IntegerValue());
+    mat = new Matrix(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust());
   } else if (info.Length() == 3 && info[0]->IsInt32() && info[1]->IsInt32()
       && info[2]->IsInt32()) {
-    mat = new Matrix(info[0]->IntegerValue(), info[1]->IntegerValue(),
-        info[2]->IntegerValue());
+    mat = new Matrix(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
+        Nan::To<int64_t>(info[2]).FromJust());
   } else if (info.Length() == 4 && info[0]->IsInt32() && info[1]->IsInt32() &&
         info[2]->IsInt32() && info[3]->IsArray()) {
-    mat = new Matrix(info[0]->IntegerValue(), info[1]->IntegerValue(),
-        info[2]->IntegerValue(), info[3]->ToObject());
+    mat = new Matrix(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
+        Nan::To<int64_t>(info[2]).FromJust(), Nan::To<Object>(info[3]).ToLocalChecked());
   } else {  // if (info.Length() == 5) {
-    Matrix *other = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
-    int x = info[1]->IntegerValue();
-    int y = info[2]->IntegerValue();
-    int w = info[3]->IntegerValue();
-    int h = info[4]->IntegerValue();
+    Matrix *other = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
+    int x = Nan::To<int64_t>(info[1]).FromJust();
+    int y = Nan::To<int64_t>(info[2]).FromJust();
+    int w = Nan::To<int64_t>(info[3]).FromJust();
+    int h = Nan::To<int64_t>(info[4]).FromJust();
     mat = new Matrix(other->mat, cv::Rect(x, y, w, h));
+    other->ShareBacking(mat);
   }
 
   mat->Wrap(info.Holder());
@@ -151,47 +198,149 @@ NAN_METHOD(Matrix::New) {
 }
 
 Matrix::Matrix() :
-    node_opencv::Matrix() {
+    node_opencv::Matrix(),
+    allocation(NULL) {
   mat = cv::Mat();
 }
 
 Matrix::Matrix(int rows, int cols) :
-    node_opencv::Matrix() {
+    node_opencv::Matrix(),
+    allocation(NULL) {
   mat = cv::Mat(rows, cols, CV_32FC3);
+  SyncExternalMemory();
 }
 
 Matrix::Matrix(int rows, int cols, int type) :
-    node_opencv::Matrix() {
+    node_opencv::Matrix(),
+    allocation(NULL) {
   mat = cv::Mat(rows, cols, type);
+  SyncExternalMemory();
 }
 
 Matrix::Matrix(cv::Mat m, cv::Rect roi) :
-    node_opencv::Matrix() {
+    node_opencv::Matrix(),
+    allocation(NULL) {
   mat = cv::Mat(m, roi);
+  SyncExternalMemory();
 }
 
-Matrix::Matrix(int rows, int cols, int type, Local<Object> scalarObj) {
+Matrix::Matrix(int rows, int cols, int type, Local<Object> scalarObj) :
+    node_opencv::Matrix(),
+    allocation(NULL) {
   mat = cv::Mat(rows, cols, type);
+  SyncExternalMemory();
   if (mat.channels() == 3) {
-    mat.setTo(cv::Scalar(scalarObj->Get(0)->IntegerValue(),
-        scalarObj->Get(1)->IntegerValue(),
-        scalarObj->Get(2)->IntegerValue()));
+    mat.setTo(cv::Scalar(Nan::To<int64_t>(Nan::Get(scalarObj, 0).ToLocalChecked()).FromJust(),
+        Nan::To<int64_t>(Nan::Get(scalarObj, 1).ToLocalChecked()).FromJust(),
+        Nan::To<int64_t>(Nan::Get(scalarObj, 2).ToLocalChecked()).FromJust()));
   } else if (mat.channels() == 2) {
-    mat.setTo(cv::Scalar(scalarObj->Get(0)->IntegerValue(),
-        scalarObj->Get(1)->IntegerValue()));
+    mat.setTo(cv::Scalar(Nan::To<int64_t>(Nan::Get(scalarObj, 0).ToLocalChecked()).FromJust(),
+        Nan::To<int64_t>(Nan::Get(scalarObj, 1).ToLocalChecked()).FromJust()));
   } else if (mat.channels() == 1) {
-    mat.setTo(cv::Scalar(scalarObj->Get(0)->IntegerValue()));
+    mat.setTo(cv::Scalar(Nan::To<int64_t>(Nan::Get(scalarObj, 0).ToLocalChecked()).FromJust()));
   } else {
     Nan::ThrowError("Only 1-3 channels are supported");
   }
 }
 
+Matrix::~Matrix() {
+  ReleaseAllocation();
+}
+
+// Allocations reported to V8, keyed by OpenCV's allocation handle, with the
+// number of matrices sharing each one. A crop or a plain assignment shares
+// its parent's data, so the data is reported once however many matrices
+// view it. Only touched on the main thread.
+struct ExternalAllocation {
+  int64_t size;
+  int refs;
+};
+static std::map<const void*, ExternalAllocation> externalAllocations;
+
+void Matrix::ReleaseAllocation() {
+  if (allocation == NULL) {
+    return;
+  }
+
+  std::map<const void*, ExternalAllocation>::iterator it =
+      externalAllocations.find(allocation);
+  if (--it->second.refs == 0) {
+    Nan::AdjustExternalMemory(-it->second.size);
+    externalAllocations.erase(it);
+  }
+  allocation = NULL;
+}
+
+// Whether the ArrayBufferView `view` covers the bytes from `start` to `end`
+static bool ViewContains(Local<Value> view, const uchar *start,
+    const uchar *end) {
+  Nan::TypedArrayContents<uchar> contents(view);
+  return *contents != NULL && *contents <= start
+      && end <= *contents + contents.length();
+}
+
+void Matrix::SyncExternalMemory() {
+  const void *key = NULL;
+  int64_t size = 0;
+
+  // Don't pin a Buffer `mat` has moved away from
+  if (!backing.IsEmpty()) {
+    Nan::HandleScope scope;
+    if (mat.empty() || !ViewContains(Nan::New(backing), mat.data, mat.dataend)) {
+      backing.Reset();
+    }
+  }
+
+  // Only count data OpenCV allocated; a matrix built over user memory (e.g.
+  // Matrix.fromBuffer with {copy: false}) is already accounted for by V8.
+  if (!mat.empty()) {
+#if CV_MAJOR_VERSION >= 3
+    key = mat.u;
+    size = mat.u ? (int64_t) mat.u->size : 0;
+#else
+    key = mat.refcount;
+    size = mat.dataend - mat.datastart;
+#endif
+  }
+
+  if (key == allocation) {
+    // Reallocated in place at the same address; only this matrix can hold
+    // the key, since any other holder would have kept the old data alive.
+    ExternalAllocation *entry = key ? &externalAllocations[key] : NULL;
+    if (entry && entry->size != size) {
+      if (size > entry->size) {
+        OpStats::AddBytes(size - entry->size);
+      }
+      Nan::AdjustExternalMemory(size - entry->size);
+      entry->size = size;
+    }
+    return;
+  }
+
+  ReleaseAllocation();
+  if (key == NULL) {
+    return;
+  }
+
+  std::map<const void*, ExternalAllocation>::iterator it =
+      externalAllocations.find(key);
+  if (it == externalAllocations.end()) {
+    ExternalAllocation entry = { size, 1 };
+    externalAllocations[key] = entry;
+    OpStats::AddBytes(size);
+    Nan::AdjustExternalMemory(size);
+  } else {
+    it->second.refs++;
+  }
+  allocation = key;
+}
+
 NAN_METHOD(Matrix::Empty) {
   SETUP_FUNCTION(Matrix)
   info.GetReturnValue().Set(Nan::New<Boolean>(self->mat.empty()));
 }
 
-double Matrix::DblGet(cv::Mat mat, int i, int j) {
+double Matrix::DblGet(const cv::Mat &mat, int i, int j) {
 
   double val = 0;
   cv::Vec3b pix;
@@ -222,33 +371,33 @@ double Matrix::DblGet(cv::Mat mat, int i, int j) {
 NAN_METHOD(Matrix::Pixel) {
   SETUP_FUNCTION(Matrix)
 
-  int y = info[0]->IntegerValue();
-  int x = info[1]->IntegerValue();
+  int y = Nan::To<int64_t>(info[0]).FromJust();
+  int x = Nan::To<int64_t>(info[1]).FromJust();
 
   // cv::Scalar scal = self->mat.at<uchar>(y, x);
 
   if (info.Length() == 3) {
-    Local < Object > objColor = info[2]->ToObject();
+    Local < Object > objColor = Nan::To<Object>(info[2]).ToLocalChecked();
 
     if (self->mat.channels() == 3) {
       self->mat.at<cv::Vec3b>(y, x)[0] =
-          (uchar) objColor->Get(0)->IntegerValue();
+          (uchar) Nan::To<int64_t>(Nan::Get(objColor, 0).ToLocalChecked()).FromJust();
       self->mat.at<cv::Vec3b>(y, x)[1] =
-          (uchar) objColor->Get(1)->IntegerValue();
+          (uchar) Nan::To<int64_t>(Nan::Get(objColor, 1).ToLocalChecked()).FromJust();
       self->mat.at<cv::Vec3b>(y, x)[2] =
-          (uchar) objColor->Get(2)->IntegerValue();
+          (uchar) Nan::To<int64_t>(Nan::Get(objColor, 2).ToLocalChecked()).FromJust();
     } else if (self->mat.channels() == 1)
-      self->mat.at<uchar>(y, x) = (uchar) objColor->Get(0)->IntegerValue();
+      self->mat.at<uchar>(y, x) = (uchar) Nan::To<int64_t>(Nan::Get(objColor, 0).ToLocalChecked()).FromJust();
 
-    info.GetReturnValue().Set(info[2]->ToObject());
+    info.GetReturnValue().Set(Nan::To<Object>(info[2]).ToLocalChecked());
   } else {
     if (self->mat.channels() == 3) {
       cv::Vec3b intensity = self->mat.at<cv::Vec3b>(y, x);
 
       v8::Local < v8::Array > arr = Nan::New<v8::Array>(3);
-      arr->Set(0, Nan::New<Number>(intensity[0]));
-      arr->Set(1, Nan::New<Number>(intensity[1]));
-      arr->Set(2, Nan::New<Number>(intensity[2]));
+      Nan::Set(arr, 0, Nan::New<Number>(intensity[0]));
+      Nan::Set(arr, 1, Nan::New<Number>(intensity[1]));
+      Nan::Set(arr, 2, Nan::New<Number>(intensity[2]));
       info.GetReturnValue().Set(arr);
     } else if (self->mat.channels() == 1) {
       uchar intensity = self->mat.at<uchar>(y, x);
@@ -264,8 +413,8 @@ NAN_METHOD(Matrix::Pixel) {
 NAN_METHOD(Matrix::Get) {
   SETUP_FUNCTION(Matrix)
 
-  int i = info[0]->IntegerValue();
-  int j = info[1]->IntegerValue();
+  int i = Nan::To<int64_t>(info[0]).FromJust();
+  int j = Nan::To<int64_t>(info[1]).FromJust();
 
   double val = Matrix::DblGet(self->mat, i, j);
   info.GetReturnValue().Set(Nan::New<Number>(val));
@@ -274,13 +423,13 @@ NAN_METHOD(Matrix::Get) {
 NAN_METHOD(Matrix::Set) {
   SETUP_FUNCTION(Matrix)
 
-  int i = info[0]->IntegerValue();
-  int j = info[1]->IntegerValue();
-  double val = info[2]->NumberValue();
+  int i = Nan::To<int64_t>(info[0]).FromJust();
+  int j = Nan::To<int64_t>(info[1]).FromJust();
+  double val = Nan::To<double>(info[2]).FromJust();
   int vint = 0;
 
   if (info.Length() == 4) {
-    self->mat.at<cv::Vec3b>(i, j)[info[3]->NumberValue()] = val;
+    self->mat.at<cv::Vec3b>(i, j)[Nan::To<double>(info[3]).FromJust()] = val;
   } else if (info.Length() == 3) {
     switch (self->mat.type()) {
       case CV_32FC3:
@@ -308,25 +457,117 @@ NAN_METHOD(Matrix::Put) {
   SETUP_FUNCTION(Matrix)
 
   if (!Buffer::HasInstance(info[0])) {
-    Nan::ThrowTypeError("Not a buffer");
+    return Nan::ThrowTypeError("Not a buffer");
   }
   const char* buffer_data = Buffer::Data(info[0]);
   size_t buffer_length = Buffer::Length(info[0]);
+  size_t mat_length = self->mat.total() * self->mat.elemSize();
+
+  if (!self->mat.isContinuous() || buffer_length > mat_length) {
+    return Nan::ThrowRangeError("Buffer is larger than the matrix data");
+  }
+
   memcpy(self->mat.data, buffer_data, buffer_length);
   return;
 }
 
+// What an external Buffer keeps alive: the pixel data and, for matrices
+// over user memory, the Buffer that memory belongs to
+struct ExternalReference {
+  cv::Mat mat;
+  Nan::Persistent<Object> backing;
+};
+
+static void FreeMatReference(char *data, void *hint) {
+  ExternalReference *ref = static_cast<ExternalReference*>(hint);
+  ref->backing.Reset();
+  delete ref;
+}
+
+Local<Object> Matrix::NewExternalBuffer(const cv::Mat &mat, uchar *data,
+    size_t length, const Nan::Persistent<Object> &backing) {
+  Nan::EscapableHandleScope scope;
+
+  if (length == 0) {
+    return scope.Escape(Nan::NewBuffer(0).ToLocalChecked());
+  }
+
+  // The heap copy of the header bumps the refcount of the pixel data; it is
+  // dropped again from the Buffer's free callback.
+  ExternalReference *ref = new ExternalReference();
+  ref->mat = mat;
+  if (!backing.IsEmpty()) {
+    ref->backing.Reset(Nan::New(backing));
+  }
+  return scope.Escape(Nan::NewBuffer((char*) data, length, FreeMatReference,
+      ref).ToLocalChecked());
+}
+
+Local<ArrayBuffer> Matrix::BackingArrayBuffer(const uchar *data,
+    size_t *offset) {
+  Nan::EscapableHandleScope scope;
+
+  if (backing.IsEmpty() || !ViewContains(Nan::New(backing), mat.data, mat.dataend)) {
+    backing.Reset();
+    backing.Reset(NewExternalBuffer(mat, mat.datastart,
+        mat.datalimit - mat.datastart, backing));
+  }
+
+  Local<ArrayBufferView> view = Nan::New(backing).As<ArrayBufferView>();
+  Nan::TypedArrayContents<uchar> contents(view);
+  *offset = view->ByteOffset() + (data - *contents);
+
+  return scope.Escape(view->Buffer());
+}
+
+void Matrix::ShareBacking(Matrix *view) {
+  if (!backing.IsEmpty()) {
+    view->backing.Reset(Nan::New(backing));
+  }
+}
+
 // @author tualo
 // getData getting node buffer of image data
+// img.getData(); // copy of the pixel data
+// img.getData({copy: false}); // Buffer aliasing the pixel data, no copy
 NAN_METHOD(Matrix::GetData) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
   int size = self->mat.rows * self->mat.cols * self->mat.elemSize();
+
+  bool copy = true;
+  if (info.Length() > 0 && info[0]->IsObject()) {
+    Local<Object> options = Nan::To<Object>(info[0]).ToLocalChecked();
+    if (Nan::Has(options, Nan::New<String>("copy").ToLocalChecked()).FromJust()) {
+      copy = Nan::To<bool>(Nan::Get(options, Nan::New<String>("copy").ToLocalChecked()).ToLocalChecked()).FromJust();
+    }
+  }
+
+  if (!copy) {
+#if NODE_MAJOR_VERSION >= 4
+    // A view on the matrix's backing Buffer, so that every call returns the
+    // same memory under the same ArrayBuffer
+    if (size > 0 && self->mat.isContinuous()) {
+      size_t offset;
+      Local<ArrayBuffer> buffer = self->BackingArrayBuffer(self->mat.data, &offset);
+      info.GetReturnValue().Set(Buffer::New(v8::Isolate::GetCurrent(), buffer,
+          offset, size).ToLocalChecked());
+      return;
+    }
+#endif
+    // Padded rows can't be exposed as one flat buffer, so alias a continuous
+    // clone instead. That is still a single copy rather than two.
+    cv::Mat data = self->mat.isContinuous() ? self->mat : self->mat.clone();
+    info.GetReturnValue().Set(NewExternalBuffer(data, data.data, size,
+        self->backing));
+    return;
+  }
+
   Local<Object> buf = Nan::NewBuffer(size).ToLocalChecked();
   uchar* data = (uchar*) Buffer::Data(buf);
   // if there is padding after each row, clone first to get rid of it
-  if (self->mat.dims == 2 && self->mat.step[0] != size_t(self->mat.size[1])) {
+  if (!self->mat.isContinuous()) {
     cv::Mat copy = self->mat.clone();
     memcpy(data, copy.data, size);
   } else {
@@ -334,9 +575,9 @@ NAN_METHOD(Matrix::GetData) {
   }
 
   v8::Local<v8::Object> globalObj = Nan::GetCurrentContext()->Global();
-  v8::Local<v8::Function> bufferConstructor = v8::Local<v8::Function>::Cast(globalObj->Get(Nan::New<String>("Buffer").ToLocalChecked()));
+  v8::Local<v8::Function> bufferConstructor = v8::Local<v8::Function>::Cast(Nan::Get(globalObj, Nan::New<String>("Buffer").ToLocalChecked()).ToLocalChecked());
   v8::Local<v8::Value> constructorArgs[3] = {buf, Nan::New<v8::Integer>((unsigned) size), Nan::New<v8::Integer>(0)};
-  v8::Local<v8::Object> actualBuffer = bufferConstructor->NewInstance(3, constructorArgs);
+  v8::Local<v8::Object> actualBuffer = Nan::NewInstance(bufferConstructor, 3, constructorArgs).ToLocalChecked();
 
   info.GetReturnValue().Set(actualBuffer);
 }
@@ -358,8 +599,8 @@ NAN_METHOD(Matrix::Brightness) {
     }
 
     cv::Mat new_image = cv::Mat::zeros( image.size(), image.type() );
-    double alpha = info[0]->NumberValue();
-    int beta = info[1]->IntegerValue();
+    double alpha = Nan::To<double>(info[0]).FromJust();
+    int beta = Nan::To<int64_t>(info[1]).FromJust();
 
     // Do the operation new_image(i,j) = alpha*image(i,j) + beta
     for (int y = 0; y < image.rows; y++ ) {
@@ -372,17 +613,20 @@ NAN_METHOD(Matrix::Brightness) {
     }
 
     if (self->mat.channels() == 3) {
-      new_image.copyTo(self->mat);
+      self->mat = new_image;
+      self->SyncExternalMemory();
     } else if (self->mat.channels() == 1) {
       cv::Mat gray;
       cv::cvtColor(new_image, gray, CV_BGR2GRAY);
-      gray.copyTo(self->mat);
+      self->mat = gray;
+      self->SyncExternalMemory();
     }
   } else {
     if (info.Length() == 1) {
-      int diff = info[0]->IntegerValue();
+      int diff = Nan::To<int64_t>(info[0]).FromJust();
       cv::Mat img = self->mat + diff;
-      img.copyTo(self->mat);
+      self->mat = img;
+      self->SyncExternalMemory();
     } else {
       info.GetReturnValue().Set(Nan::New("Insufficient or wrong arguments").ToLocalChecked());
     }
@@ -417,28 +661,29 @@ NAN_METHOD(Matrix::Normalize) {
 
   int type = cv::NORM_MINMAX;
   if (info[2]->IsNumber()) {
-    type = getNormType(info[2]->Uint32Value());
+    type = getNormType(Nan::To<uint32_t>(info[2]).FromJust());
   }
   int dtype = -1;
   if (info[3]->IsNumber()) {
-    dtype = info[3]->IntegerValue();
+    dtype = Nan::To<int64_t>(info[3]).FromJust();
   }
 
-  double min = info[0]->NumberValue();
-  double max = info[1]->NumberValue();
+  double min = Nan::To<double>(info[0]).FromJust();
+  double max = Nan::To<double>(info[1]).FromJust();
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
   cv::Mat norm;
 
   cv::Mat mask;
   if (info[4]->IsObject()) {
-    Matrix *mmask = Nan::ObjectWrap::Unwrap<Matrix>(info[4]->ToObject());
+    Matrix *mmask = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[4]).ToLocalChecked());
     mask = mmask->mat;
   }
 
   cv::normalize(self->mat, norm, min, max, type, dtype, mask);
 
-  norm.copyTo(self->mat);
+  self->mat = norm;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -460,19 +705,19 @@ NAN_METHOD(Matrix::Norm) {
 
   // If src2 is specified calculate absolute or relative difference norm
   if (!info[infoCount]->IsUndefined() && info[infoCount]->IsObject()) {
-    src2 = Nan::ObjectWrap::Unwrap<Matrix>(info[infoCount]->ToObject());
+    src2 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[infoCount]).ToLocalChecked());
     infoCount++;
   }
 
   // NORM_TYPE
   if (!info[infoCount]->IsUndefined() && info[infoCount]->IsInt32()) {
-    normType = getNormType(info[infoCount]->Uint32Value());
+    normType = getNormType(Nan::To<uint32_t>(info[infoCount]).FromJust());
     infoCount++;
   }
 
   // Mask
   if (!info[infoCount]->IsUndefined() && info[infoCount]->IsObject()) {
-    Matrix *mmask = Nan::ObjectWrap::Unwrap<Matrix>(info[infoCount]->ToObject());
+    Matrix *mmask = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[infoCount]).ToLocalChecked());
     mask = mmask->mat;
     infoCount++;
   }
@@ -491,8 +736,8 @@ NAN_METHOD(Matrix::Size) {
   SETUP_FUNCTION(Matrix)
 
   v8::Local < v8::Array > arr = Nan::New<Array>(2);
-  arr->Set(0, Nan::New<Number>(self->mat.size().height));
-  arr->Set(1, Nan::New<Number>(self->mat.size().width));
+  Nan::Set(arr, 0, Nan::New<Number>(self->mat.size().height));
+  Nan::Set(arr, 1, Nan::New<Number>(self->mat.size().width));
 
   info.GetReturnValue().Set(arr);
 }
@@ -501,10 +746,19 @@ NAN_METHOD(Matrix::Clone) {
   SETUP_FUNCTION(Matrix)
 
   Local < Object > im_h =
-      Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+      Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
 
   Matrix *m = Nan::ObjectWrap::Unwrap<Matrix>(im_h);
-  m->mat = self->mat.clone();
+
+  // im.clone(pool) copies into a buffer taken from a cv.MatrixPool
+  if (info.Length() > 0 && Nan::New(MatrixPool::constructor)->HasInstance(info[0])) {
+    MatrixPool *pool = Nan::ObjectWrap::Unwrap<MatrixPool>(Nan::To<Object>(info[0]).ToLocalChecked());
+    m->mat.allocator = pool->allocator;
+    self->mat.copyTo(m->mat);
+  } else {
+    m->mat = self->mat.clone();
+  }
+  m->SyncExternalMemory();
 
   info.GetReturnValue().Set(im_h);
 }
@@ -515,17 +769,19 @@ NAN_METHOD(Matrix::Crop) {
   if ((info.Length() == 4) && (info[0]->IsNumber()) && (info[1]->IsNumber())
       && (info[2]->IsNumber()) && (info[3]->IsNumber())) {
 
-    int x = info[0]->IntegerValue();
-    int y = info[1]->IntegerValue();
-    int width = info[2]->IntegerValue();
-    int height = info[3]->IntegerValue();
+    int x = Nan::To<int64_t>(info[0]).FromJust();
+    int y = Nan::To<int64_t>(info[1]).FromJust();
+    int width = Nan::To<int64_t>(info[2]).FromJust();
+    int height = Nan::To<int64_t>(info[3]).FromJust();
 
     cv::Rect roi(x, y, width, height);
 
     Local < Object > im_h =
-        Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+        Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix *m = Nan::ObjectWrap::Unwrap<Matrix>(im_h);
     m->mat = self->mat(roi);
+    m->SyncExternalMemory();
+    self->ShareBacking(m);
 
     info.GetReturnValue().Set(im_h);
   } else {
@@ -537,12 +793,12 @@ NAN_METHOD(Matrix::Row) {
   SETUP_FUNCTION(Matrix)
 
   int width = self->mat.size().width;
-  int y = info[0]->IntegerValue();
+  int y = Nan::To<int64_t>(info[0]).FromJust();
   v8::Local < v8::Array > arr = Nan::New<Array>(width);
 
   for (int x = 0; x < width; x++) {
     double v = Matrix::DblGet(self->mat, y, x);
-    arr->Set(x, Nan::New<Number>(v));
+    Nan::Set(arr, x, Nan::New<Number>(v));
   }
 
   info.GetReturnValue().Set(arr);
@@ -552,15 +808,15 @@ NAN_METHOD(Matrix::PixelRow) {
   SETUP_FUNCTION(Matrix)
 
   int width = self->mat.size().width;
-  int y = info[0]->IntegerValue();
+  int y = Nan::To<int64_t>(info[0]).FromJust();
   v8::Local < v8::Array > arr = Nan::New<Array>(width * 3);
 
   for (int x = 0; x < width; x++) {
     cv::Vec3b pixel = self->mat.at<cv::Vec3b>(y, x);
     int offset = x * 3;
-    arr->Set(offset, Nan::New<Number>((double) pixel.val[0]));
-    arr->Set(offset + 1, Nan::New<Number>((double) pixel.val[1]));
-    arr->Set(offset + 2, Nan::New<Number>((double) pixel.val[2]));
+    Nan::Set(arr, offset, Nan::New<Number>((double) pixel.val[0]));
+    Nan::Set(arr, offset + 1, Nan::New<Number>((double) pixel.val[1]));
+    Nan::Set(arr, offset + 2, Nan::New<Number>((double) pixel.val[2]));
   }
 
   info.GetReturnValue().Set(arr);
@@ -570,12 +826,12 @@ NAN_METHOD(Matrix::Col) {
   SETUP_FUNCTION(Matrix)
 
   int height = self->mat.size().height;
-  int x = info[0]->IntegerValue();
+  int x = Nan::To<int64_t>(info[0]).FromJust();
   v8::Local < v8::Array > arr = Nan::New<Array>(height);
 
   for (int y = 0; y < height; y++) {
     double v = Matrix::DblGet(self->mat, y, x);
-    arr->Set(y, Nan::New<Number>(v));
+    Nan::Set(arr, y, Nan::New<Number>(v));
   }
   info.GetReturnValue().Set(arr);
 }
@@ -584,35 +840,272 @@ NAN_METHOD(Matrix::PixelCol) {
   SETUP_FUNCTION(Matrix)
 
   int height = self->mat.size().height;
-  int x = info[0]->IntegerValue();
+  int x = Nan::To<int64_t>(info[0]).FromJust();
   v8::Local < v8::Array > arr = Nan::New<Array>(height * 3);
 
   for (int y = 0; y < height; y++) {
     cv::Vec3b pixel = self->mat.at<cv::Vec3b>(y, x);
     int offset = y * 3;
-    arr->Set(offset, Nan::New<Number>((double) pixel.val[0]));
-    arr->Set(offset + 1, Nan::New<Number>((double) pixel.val[1]));
-    arr->Set(offset + 2, Nan::New<Number>((double) pixel.val[2]));
+    Nan::Set(arr, offset, Nan::New<Number>((double) pixel.val[0]));
+    Nan::Set(arr, offset + 1, Nan::New<Number>((double) pixel.val[1]));
+    Nan::Set(arr, offset + 2, Nan::New<Number>((double) pixel.val[2]));
   }
   info.GetReturnValue().Set(arr);
 }
 
+// Reads a region as [x, y, width, height] or {x, y, width, height}, the
+// whole matrix when undefined. Throws and returns false unless it lies
+// within `mat`.
+static bool RegionArg(Local<Value> value, const cv::Mat &mat, cv::Rect &rect) {
+  if (value->IsUndefined()) {
+    rect = cv::Rect(0, 0, mat.cols, mat.rows);
+    return true;
+  }
+
+  static const char *keys[] = {"x", "y", "width", "height"};
+  Local<Value> fields[4];
+  if (value->IsArray() && value.As<Array>()->Length() == 4) {
+    for (uint32_t i = 0; i < 4; i++) {
+      fields[i] = Nan::Get(value.As<Array>(), i).ToLocalChecked();
+    }
+  } else if (value->IsObject() && !value->IsArray()) {
+    for (int i = 0; i < 4; i++) {
+      fields[i] = Nan::Get(value.As<Object>(), Nan::New(keys[i]).ToLocalChecked()).ToLocalChecked();
+    }
+  } else {
+    Nan::ThrowTypeError("Region must be [x, y, width, height] or {x, y, width, height}");
+    return false;
+  }
+
+  // Checked as 64-bit values, before narrowing to the Rect's ints
+  int64_t r[4];
+  for (int i = 0; i < 4; i++) {
+    if (!fields[i]->IsNumber()) {
+      Nan::ThrowTypeError((std::string("Region ") + keys[i] + " must be a number").c_str());
+      return false;
+    }
+    r[i] = Nan::To<int64_t>(fields[i]).FromJust();
+  }
+
+  if (r[0] < 0 || r[1] < 0 || r[2] < 0 || r[3] < 0
+      || r[2] > mat.cols - r[0] || r[3] > mat.rows - r[1]) {
+    Nan::ThrowRangeError("Region is outside the matrix");
+    return false;
+  }
+  rect = cv::Rect((int) r[0], (int) r[1], (int) r[2], (int) r[3]);
+  return true;
+}
+
+// The region's pixels, row by row with channels interleaved, in a new typed
+// array of the matrix's depth (a Uint8Array for CV_8U, Float32Array for
+// CV_32F, ...). im.getRegion() copies the whole matrix.
+NAN_METHOD(Matrix::GetRegion) {
+  SETUP_FUNCTION(Matrix)
+
+  cv::Rect rect;
+  if (!RegionArg(info.Length() > 0 ? info[0] : Nan::Undefined(), self->mat, rect)) {
+    return;
+  }
+
+  void *data;
+  Local<Object> array = OpenCV::NewTypedArray(self->mat.depth(),
+      (size_t) rect.area() * self->mat.channels(), &data);
+
+  if (rect.area() > 0) {
+    cv::Mat region(self->mat, rect);
+    size_t rowBytes = region.cols * region.elemSize();
+    if (region.isContinuous()) {
+      memcpy(data, region.data, region.rows * rowBytes);
+    } else {
+      for (int y = 0; y < region.rows; y++) {
+        memcpy((uchar*) data + y * rowBytes, region.ptr(y), rowBytes);
+      }
+    }
+  }
+
+  info.GetReturnValue().Set(array);
+}
+
+// im.setRegion(region, pixels) copies a typed array laid out as getRegion
+// returns it into the region. Its element type must match the depth.
+NAN_METHOD(Matrix::SetRegion) {
+  SETUP_FUNCTION(Matrix)
+
+  if (info.Length() < 2) {
+    return Nan::ThrowTypeError("setRegion takes a region and a typed array");
+  }
+
+  cv::Rect rect;
+  if (!RegionArg(info[0], self->mat, rect)) {
+    return;
+  }
+
+  if (OpenCV::TypedArrayDepth(info[1]) != self->mat.depth()) {
+    return Nan::ThrowTypeError("Pixels must be a typed array matching the matrix depth");
+  }
+
+  // Lengths in bytes, as the contents are read as bytes
+  Nan::TypedArrayContents<uchar> contents(info[1]);
+  if ((size_t) contents.length() != rect.area() * self->mat.elemSize()) {
+    return Nan::ThrowRangeError("Pixels must have width * height * channels elements");
+  }
+  if (rect.area() == 0) {
+    return;
+  }
+
+  cv::Mat region(self->mat, rect);
+  size_t rowBytes = region.cols * region.elemSize();
+  const uchar *data = *contents;
+  if (region.isContinuous()) {
+    memcpy(region.data, data, region.rows * rowBytes);
+  } else {
+    for (int y = 0; y < region.rows; y++) {
+      memcpy(region.ptr(y), data + y * rowBytes, rowBytes);
+    }
+  }
+}
+
+// A typed array viewing row y in place: writes to it change the matrix, and
+// it keeps the pixel data alive, as getData({copy: false}) does.
+NAN_METHOD(Matrix::RowData) {
+  SETUP_FUNCTION(Matrix)
+
+  int y = Nan::To<int64_t>(info[0]).FromJust();
+  if (y < 0 || y >= self->mat.rows) {
+    return Nan::ThrowRangeError("Row is outside the matrix");
+  }
+
+  size_t length = self->mat.cols * self->mat.channels();
+  if (length == 0) {
+    void *data;
+    info.GetReturnValue().Set(OpenCV::NewTypedArray(self->mat.depth(), 0, &data));
+    return;
+  }
+
+  size_t offset;
+  Local<ArrayBuffer> buffer = self->BackingArrayBuffer(self->mat.ptr(y), &offset);
+
+  info.GetReturnValue().Set(OpenCV::NewTypedArray(self->mat.depth(),
+      buffer, offset, length));
+}
+
+// A copy of column x in a typed array; a column isn't contiguous in memory,
+// so it can't be a view.
+NAN_METHOD(Matrix::ColData) {
+  SETUP_FUNCTION(Matrix)
+
+  int x = Nan::To<int64_t>(info[0]).FromJust();
+  if (x < 0 || x >= self->mat.cols) {
+    return Nan::ThrowRangeError("Column is outside the matrix");
+  }
+
+  size_t pixelBytes = self->mat.elemSize();
+  void *data;
+  Local<Object> array = OpenCV::NewTypedArray(self->mat.depth(),
+      self->mat.rows * self->mat.channels(), &data);
+
+  for (int y = 0; y < self->mat.rows; y++) {
+    memcpy((uchar*) data + y * pixelBytes, self->mat.ptr(y) + x * pixelBytes,
+        pixelBytes);
+  }
+
+  info.GetReturnValue().Set(array);
+}
+
 NAN_METHOD(Matrix::Width) {
   SETUP_FUNCTION(Matrix)
 
-  info.GetReturnValue().Set(Nan::New<Number>(self->mat.size().width));
+  info.GetReturnValue().Set(self->mat.cols);
 }
 
 NAN_METHOD(Matrix::Height) {
   SETUP_FUNCTION(Matrix)
 
-  info.GetReturnValue().Set(Nan::New<Number>(self->mat.size().height));
+  info.GetReturnValue().Set(self->mat.rows);
 }
 
 NAN_METHOD(Matrix::Channels) {
   SETUP_FUNCTION(Matrix)
 
-  info.GetReturnValue().Set(Nan::New<Number>(self->mat.channels()));
+  info.GetReturnValue().Set(self->mat.channels());
+}
+
+// The getters return small integers, which V8 stores without allocating
+
+NAN_GETTER(Matrix::GetRows) {
+  info.GetReturnValue().Set(Nan::ObjectWrap::Unwrap<Matrix>(info.Holder())->mat.rows);
+}
+
+NAN_GETTER(Matrix::GetCols) {
+  info.GetReturnValue().Set(Nan::ObjectWrap::Unwrap<Matrix>(info.Holder())->mat.cols);
+}
+
+NAN_GETTER(Matrix::GetType) {
+  info.GetReturnValue().Set(Nan::ObjectWrap::Unwrap<Matrix>(info.Holder())->mat.type());
+}
+
+NAN_GETTER(Matrix::GetDepth) {
+  info.GetReturnValue().Set(Nan::ObjectWrap::Unwrap<Matrix>(info.Holder())->mat.depth());
+}
+
+// Bytes per row
+NAN_GETTER(Matrix::GetStep) {
+  const cv::Mat &mat = Nan::ObjectWrap::Unwrap<Matrix>(info.Holder())->mat;
+  info.GetReturnValue().Set((double) (mat.dims > 0 ? mat.step[0] : 0));
+}
+
+NAN_GETTER(Matrix::GetIsContinuous) {
+  info.GetReturnValue().Set(Nan::ObjectWrap::Unwrap<Matrix>(info.Holder())->mat.isContinuous());
+}
+
+// Number of elements (pixels)
+NAN_GETTER(Matrix::GetTotal) {
+  info.GetReturnValue().Set((double) Nan::ObjectWrap::Unwrap<Matrix>(info.Holder())->mat.total());
+}
+
+// Bytes per element, all channels included
+NAN_GETTER(Matrix::GetElemSize) {
+  info.GetReturnValue().Set((double) Nan::ObjectWrap::Unwrap<Matrix>(info.Holder())->mat.elemSize());
+}
+
+// All the header fields at once:
+// {rows, cols, type, depth, channels, step, isContinuous, total, elemSize, empty}
+NAN_METHOD(Matrix::Describe) {
+  SETUP_FUNCTION(Matrix)
+
+  const cv::Mat &mat = self->mat;
+  Local<Object> res = Nan::New<Object>();
+  Nan::Set(res, Nan::New("rows").ToLocalChecked(), Nan::New<Integer>(mat.rows));
+  Nan::Set(res, Nan::New("cols").ToLocalChecked(), Nan::New<Integer>(mat.cols));
+  Nan::Set(res, Nan::New("type").ToLocalChecked(), Nan::New<Integer>(mat.type()));
+  Nan::Set(res, Nan::New("depth").ToLocalChecked(), Nan::New<Integer>(mat.depth()));
+  Nan::Set(res, Nan::New("channels").ToLocalChecked(), Nan::New<Integer>(mat.channels()));
+  Nan::Set(res, Nan::New("step").ToLocalChecked(),
+      Nan::New<Number>((double) (mat.dims > 0 ? mat.step[0] : 0)));
+  Nan::Set(res, Nan::New("isContinuous").ToLocalChecked(), Nan::New<Boolean>(mat.isContinuous()));
+  Nan::Set(res, Nan::New("total").ToLocalChecked(), Nan::New<Number>((double) mat.total()));
+  Nan::Set(res, Nan::New("elemSize").ToLocalChecked(), Nan::New<Number>((double) mat.elemSize()));
+  Nan::Set(res, Nan::New("empty").ToLocalChecked(), Nan::New<Boolean>(mat.empty()));
+
+  info.GetReturnValue().Set(res);
+}
+
+static void FreeEncoded(char *data, void *hint) {
+  delete static_cast<std::vector<uchar>*>(hint);
+}
+
+// Wraps encoded image data in a Buffer without copying it. The Buffer takes
+// ownership of `vec` and deletes it when it is collected.
+static Local<Object> EncodedBuffer(std::vector<uchar> *vec) {
+  Nan::EscapableHandleScope scope;
+
+  if (vec->empty()) {
+    delete vec;
+    return scope.Escape(Nan::NewBuffer(0).ToLocalChecked());
+  }
+
+  return scope.Escape(Nan::NewBuffer((char*) &(*vec)[0], vec->size(),
+      FreeEncoded, vec).ToLocalChecked());
 }
 
 NAN_METHOD(Matrix::ToBuffer) {
@@ -639,135 +1132,124 @@ NAN_METHOD(Matrix::ToBuffer) {
     // Get this options argument
     v8::Handle < v8::Object > options = v8::Local<v8::Object>::Cast(info[0]);
     // If the extension (image format) is provided
-    if (options->Has(Nan::New<String>("ext").ToLocalChecked())) {
-      v8::String::Utf8Value str(
-          options->Get(Nan::New<String>("ext").ToLocalChecked())->ToString());
+    if (Nan::Has(options, Nan::New<String>("ext").ToLocalChecked()).FromJust()) {
+      Nan::Utf8String str(
+          Nan::To<String>(Nan::Get(options, Nan::New<String>("ext").ToLocalChecked()).ToLocalChecked()).ToLocalChecked());
       optExt = *str;
       ext = (const char *) optExt.c_str();
     }
-    if (options->Has(Nan::New<String>("jpegQuality").ToLocalChecked())) {
+    if (Nan::Has(options, Nan::New<String>("jpegQuality").ToLocalChecked()).FromJust()) {
       int compression =
-          options->Get(Nan::New<String>("jpegQuality").ToLocalChecked())->IntegerValue();
+          Nan::To<int64_t>(Nan::Get(options, Nan::New<String>("jpegQuality").ToLocalChecked()).ToLocalChecked()).FromJust();
       params.push_back(CV_IMWRITE_JPEG_QUALITY);
       params.push_back(compression);
     }
-    if (options->Has(Nan::New<String>("pngCompression").ToLocalChecked())) {
+    if (Nan::Has(options, Nan::New<String>("pngCompression").ToLocalChecked()).FromJust()) {
       int compression =
-          options->Get(Nan::New<String>("pngCompression").ToLocalChecked())->IntegerValue();
+          Nan::To<int64_t>(Nan::Get(options, Nan::New<String>("pngCompression").ToLocalChecked()).ToLocalChecked()).FromJust();
       params.push_back(CV_IMWRITE_PNG_COMPRESSION);
       params.push_back(compression);
     }
   }
 
   //---------------------------
-  std::vector<uchar> vec(0);
-
-  cv::imencode(ext, self->mat, vec, params);
+  std::vector<uchar> *vec = new std::vector<uchar>();
 
-  Local < Object > buf = Nan::NewBuffer(vec.size()).ToLocalChecked();
-  uchar* data = (uchar*) Buffer::Data(buf);
-  memcpy(data, &vec[0], vec.size());
-
-  v8::Local < v8::Object > globalObj = Nan::GetCurrentContext()->Global();
-  v8::Local < v8::Function > bufferConstructor = v8::Local < v8::Function
-      > ::Cast(globalObj->Get(Nan::New<String>("Buffer").ToLocalChecked()));
-  v8::Local<v8::Value> constructorArgs[3] =
-      {buf, Nan::New<v8::Integer>((unsigned)vec.size()), Nan::New<v8::Integer>(0)};
-  v8::Local < v8::Object > actualBuffer = bufferConstructor->NewInstance(3,
-      constructorArgs);
+  try {
+    cv::imencode(ext, self->mat, *vec, params);
+  } catch (cv::Exception& e) {
+    delete vec;
+    return Nan::ThrowError(e.what());
+  }
 
-  info.GetReturnValue().Set(actualBuffer);
+  info.GetReturnValue().Set(EncodedBuffer(vec));
 }
 
-class AsyncToBufferWorker: public Nan::AsyncWorker {
+class AsyncToBufferWorker: public AsyncBaseWorker {
 public:
-  AsyncToBufferWorker(Nan::Callback *callback, Matrix* matrix, std::string ext,
-    std::vector<int> params) :
-      Nan::AsyncWorker(callback),
-      matrix(matrix),
+  AsyncToBufferWorker(Nan::Callback *callback, Local<Object> matrix,
+    std::string ext, std::vector<int> params) :
+      AsyncBaseWorker(callback),
       ext(ext),
-      params(params) {
+      params(params),
+      res(new std::vector<uchar>()) {
+    mat = PinMatrix("matrix", matrix);
   }
 
   ~AsyncToBufferWorker() {
+    delete res;
   }
 
   void Execute() {
-    std::vector<uchar> vec(0);
-    // std::vector<int> params(0);//CV_IMWRITE_JPEG_QUALITY 90
-    cv::imencode(ext, this->matrix->mat, vec, this->params);
-    res = vec;
+    try {
+      cv::imencode(ext, mat, *res, this->params);
+    } catch (cv::Exception& e) {
+      SetErrorMessage(e.what());
+    }
   }
 
-  void HandleOKCallback() {
-    Nan::HandleScope scope;
-
-    Local<Object> buf = Nan::NewBuffer(res.size()).ToLocalChecked();
-    uchar* data = (uchar*) Buffer::Data(buf);
-    memcpy(data, &res[0], res.size());
-
-    v8::Local<v8::Object> globalObj = Nan::GetCurrentContext()->Global();
-    v8::Local<v8::Function> bufferConstructor = v8::Local<v8::Function>::Cast(globalObj->Get(Nan::New<String>("Buffer").ToLocalChecked()));
-    v8::Local<v8::Value> constructorArgs[3] = {buf, Nan::New<v8::Integer>((unsigned)res.size()), Nan::New<v8::Integer>(0)};
-    v8::Local<v8::Object> actualBuffer = bufferConstructor->NewInstance(3, constructorArgs);
+  // The encoded data goes to the Buffer as is
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
 
-    Local<Value> argv[] = {
-      Nan::Null(),
-      actualBuffer
-    };
-
-    Nan::TryCatch try_catch;
-    callback->Call(2, argv);
-    if (try_catch.HasCaught()) {
-      Nan::FatalException(try_catch);
-    }
+    Local<Object> buf = EncodedBuffer(res);
+    res = NULL;
 
+    return scope.Escape(buf);
   }
 
 private:
-  Matrix* matrix;
+  cv::Mat mat;
   std::string ext;
   std::vector<int> params;
-  std::vector<uchar> res;
+  std::vector<uchar> *res;
 };
 
+// toBufferAsync(callback[, options]) or, returning a promise,
+// toBufferAsync([options])
 NAN_METHOD(Matrix::ToBufferAsync) {
   SETUP_FUNCTION(Matrix)
 
-  REQ_FUN_ARG(0, cb);
+  int optionsIndex = 0;
+  if (info.Length() > 0 && info[0]->IsFunction()) {
+    optionsIndex = 1;
+  }
 
   std::string ext = std::string(".jpg");
   std::vector<int> params;
 
   // See if the options argument is passed
-  if ((info.Length() > 1) && (info[1]->IsObject())) {
+  if ((info.Length() > optionsIndex) && (info[optionsIndex]->IsObject())) {
     // Get this options argument
-    v8::Handle < v8::Object > options = v8::Local<v8::Object>::Cast(info[1]);
+    v8::Handle < v8::Object > options = v8::Local<v8::Object>::Cast(info[optionsIndex]);
     // If the extension (image format) is provided
-    if (options->Has(Nan::New<String>("ext").ToLocalChecked())) {
-      v8::String::Utf8Value str(
-          options->Get(Nan::New<String>("ext").ToLocalChecked())->ToString());
+    if (Nan::Has(options, Nan::New<String>("ext").ToLocalChecked()).FromJust()) {
+      Nan::Utf8String str(
+          Nan::To<String>(Nan::Get(options, Nan::New<String>("ext").ToLocalChecked()).ToLocalChecked()).ToLocalChecked());
       std::string str2 = std::string(*str);
       ext = str2;
     }
-    if (options->Has(Nan::New<String>("jpegQuality").ToLocalChecked())) {
+    if (Nan::Has(options, Nan::New<String>("jpegQuality").ToLocalChecked()).FromJust()) {
       int compression =
-          options->Get(Nan::New<String>("jpegQuality").ToLocalChecked())->IntegerValue();
+          Nan::To<int64_t>(Nan::Get(options, Nan::New<String>("jpegQuality").ToLocalChecked()).ToLocalChecked()).FromJust();
       params.push_back(CV_IMWRITE_JPEG_QUALITY);
       params.push_back(compression);
     }
-    if (options->Has(Nan::New<String>("pngCompression").ToLocalChecked())) {
+    if (Nan::Has(options, Nan::New<String>("pngCompression").ToLocalChecked()).FromJust()) {
       int compression =
-          options->Get(Nan::New<String>("pngCompression").ToLocalChecked())->IntegerValue();
+          Nan::To<int64_t>(Nan::Get(options, Nan::New<String>("pngCompression").ToLocalChecked()).ToLocalChecked()).FromJust();
       params.push_back(CV_IMWRITE_PNG_COMPRESSION);
       params.push_back(compression);
     }
   }
 
-  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new AsyncToBufferWorker(callback, self, ext, params));
+  Nan::Callback *callback = NULL;
+  if (optionsIndex == 1) {
+    callback = new Nan::Callback(info[0].As<Function>());
+  }
 
-  return;
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(
+      new AsyncToBufferWorker(callback, info.This(), ext, params)));
 }
 
 NAN_METHOD(Matrix::Ellipse) {
@@ -787,53 +1269,53 @@ NAN_METHOD(Matrix::Ellipse) {
 
   if (info[0]->IsObject()) {
     v8::Handle < v8::Object > options = v8::Local<v8::Object>::Cast(info[0]);
-    if (options->Has(Nan::New<String>("center").ToLocalChecked())) {
+    if (Nan::Has(options, Nan::New<String>("center").ToLocalChecked()).FromJust()) {
       Local < Object > center =
-          options->Get(Nan::New<String>("center").ToLocalChecked())->ToObject();
-      x = center->Get(Nan::New<String>("x").ToLocalChecked())->Uint32Value();
-      y = center->Get(Nan::New<String>("y").ToLocalChecked())->Uint32Value();
+          Nan::To<Object>(Nan::Get(options, Nan::New<String>("center").ToLocalChecked()).ToLocalChecked()).ToLocalChecked();
+      x = Nan::To<uint32_t>(Nan::Get(center, Nan::New<String>("x").ToLocalChecked()).ToLocalChecked()).FromJust();
+      y = Nan::To<uint32_t>(Nan::Get(center, Nan::New<String>("y").ToLocalChecked()).ToLocalChecked()).FromJust();
     }
-    if (options->Has(Nan::New<String>("axes").ToLocalChecked())) {
-      Local < Object > axes = options->Get(Nan::New<String>("axes").ToLocalChecked())->ToObject();
-      width = axes->Get(Nan::New<String>("width").ToLocalChecked())->Uint32Value();
-      height = axes->Get(Nan::New<String>("height").ToLocalChecked())->Uint32Value();
+    if (Nan::Has(options, Nan::New<String>("axes").ToLocalChecked()).FromJust()) {
+      Local < Object > axes = Nan::To<Object>(Nan::Get(options, Nan::New<String>("axes").ToLocalChecked()).ToLocalChecked()).ToLocalChecked();
+      width = Nan::To<uint32_t>(Nan::Get(axes, Nan::New<String>("width").ToLocalChecked()).ToLocalChecked()).FromJust();
+      height = Nan::To<uint32_t>(Nan::Get(axes, Nan::New<String>("height").ToLocalChecked()).ToLocalChecked()).FromJust();
     }
-    if (options->Has(Nan::New<String>("thickness").ToLocalChecked())) {
-      thickness = options->Get(Nan::New<String>("thickness").ToLocalChecked())->Uint32Value();
+    if (Nan::Has(options, Nan::New<String>("thickness").ToLocalChecked()).FromJust()) {
+      thickness = Nan::To<uint32_t>(Nan::Get(options, Nan::New<String>("thickness").ToLocalChecked()).ToLocalChecked()).FromJust();
     }
-    if (options->Has(Nan::New<String>("angle").ToLocalChecked())) {
-      angle = options->Get(Nan::New<String>("angle").ToLocalChecked())->NumberValue();
+    if (Nan::Has(options, Nan::New<String>("angle").ToLocalChecked()).FromJust()) {
+      angle = Nan::To<double>(Nan::Get(options, Nan::New<String>("angle").ToLocalChecked()).ToLocalChecked()).FromJust();
     }
-    if (options->Has(Nan::New<String>("startAngle").ToLocalChecked())) {
-      startAngle = options->Get(Nan::New<String>("startAngle").ToLocalChecked())->NumberValue();
+    if (Nan::Has(options, Nan::New<String>("startAngle").ToLocalChecked()).FromJust()) {
+      startAngle = Nan::To<double>(Nan::Get(options, Nan::New<String>("startAngle").ToLocalChecked()).ToLocalChecked()).FromJust();
     }
-    if (options->Has(Nan::New<String>("endAngle").ToLocalChecked())) {
-      endAngle = options->Get(Nan::New<String>("endAngle").ToLocalChecked())->NumberValue();
+    if (Nan::Has(options, Nan::New<String>("endAngle").ToLocalChecked()).FromJust()) {
+      endAngle = Nan::To<double>(Nan::Get(options, Nan::New<String>("endAngle").ToLocalChecked()).ToLocalChecked()).FromJust();
     }
-    if (options->Has(Nan::New<String>("lineType").ToLocalChecked())) {
-      lineType = options->Get(Nan::New<String>("lineType").ToLocalChecked())->Uint32Value();
+    if (Nan::Has(options, Nan::New<String>("lineType").ToLocalChecked()).FromJust()) {
+      lineType = Nan::To<uint32_t>(Nan::Get(options, Nan::New<String>("lineType").ToLocalChecked()).ToLocalChecked()).FromJust();
     }
-    if (options->Has(Nan::New<String>("shift").ToLocalChecked())) {
-      shift = options->Get(Nan::New<String>("shift").ToLocalChecked())->Uint32Value();
+    if (Nan::Has(options, Nan::New<String>("shift").ToLocalChecked()).FromJust()) {
+      shift = Nan::To<uint32_t>(Nan::Get(options, Nan::New<String>("shift").ToLocalChecked()).ToLocalChecked()).FromJust();
     }
-    if (options->Has(Nan::New<String>("color").ToLocalChecked())) {
+    if (Nan::Has(options, Nan::New<String>("color").ToLocalChecked()).FromJust()) {
       Local < Object > objColor =
-          options->Get(Nan::New<String>("color").ToLocalChecked())->ToObject();
+          Nan::To<Object>(Nan::Get(options, Nan::New<String>("color").ToLocalChecked()).ToLocalChecked()).ToLocalChecked();
       color = setColor(objColor);
     }
   } else {
-    x = info[0]->Uint32Value();
-    y = info[1]->Uint32Value();
-    width = info[2]->Uint32Value();
-    height = info[3]->Uint32Value();
+    x = Nan::To<uint32_t>(info[0]).FromJust();
+    y = Nan::To<uint32_t>(info[1]).FromJust();
+    width = Nan::To<uint32_t>(info[2]).FromJust();
+    height = Nan::To<uint32_t>(info[3]).FromJust();
 
     if (info[4]->IsArray()) {
-      Local < Object > objColor = info[4]->ToObject();
+      Local < Object > objColor = Nan::To<Object>(info[4]).ToLocalChecked();
       color = setColor(objColor);
     }
 
-    if (info[5]->IntegerValue())
-      thickness = info[5]->IntegerValue();
+    if (Nan::To<int64_t>(info[5]).FromJust())
+      thickness = Nan::To<int64_t>(info[5]).FromJust();
   }
 
   cv::ellipse(self->mat, cv::Point(x, y), cv::Size(width, height), angle,
@@ -845,26 +1327,26 @@ NAN_METHOD(Matrix::Rectangle) {
   SETUP_FUNCTION(Matrix)
 
   if (info[0]->IsArray() && info[1]->IsArray()) {
-    Local < Object > xy = info[0]->ToObject();
-    Local < Object > width_height = info[1]->ToObject();
+    Local < Object > xy = Nan::To<Object>(info[0]).ToLocalChecked();
+    Local < Object > width_height = Nan::To<Object>(info[1]).ToLocalChecked();
 
     cv::Scalar color(0, 0, 255);
 
     if (info[2]->IsArray()) {
-      Local < Object > objColor = info[2]->ToObject();
+      Local < Object > objColor = Nan::To<Object>(info[2]).ToLocalChecked();
       color = setColor(objColor);
     }
 
-    int x = xy->Get(0)->IntegerValue();
-    int y = xy->Get(1)->IntegerValue();
+    int x = Nan::To<int64_t>(Nan::Get(xy, 0).ToLocalChecked()).FromJust();
+    int y = Nan::To<int64_t>(Nan::Get(xy, 1).ToLocalChecked()).FromJust();
 
-    int width = width_height->Get(0)->IntegerValue();
-    int height = width_height->Get(1)->IntegerValue();
+    int width = Nan::To<int64_t>(Nan::Get(width_height, 0).ToLocalChecked()).FromJust();
+    int height = Nan::To<int64_t>(Nan::Get(width_height, 1).ToLocalChecked()).FromJust();
 
     int thickness = 1;
 
-    if (info[3]->IntegerValue())
-      thickness = info[3]->IntegerValue();
+    if (Nan::To<int64_t>(info[3]).FromJust())
+      thickness = Nan::To<int64_t>(info[3]).FromJust();
 
     cv::rectangle(self->mat, cv::Point(x, y), cv::Point(x + width, y + height),
         color, thickness);
@@ -877,26 +1359,26 @@ NAN_METHOD(Matrix::Line) {
   SETUP_FUNCTION(Matrix)
 
   if (info[0]->IsArray() && info[1]->IsArray()) {
-    Local < Object > xy1 = info[0]->ToObject();
-    Local < Object > xy2 = info[1]->ToObject();
+    Local < Object > xy1 = Nan::To<Object>(info[0]).ToLocalChecked();
+    Local < Object > xy2 = Nan::To<Object>(info[1]).ToLocalChecked();
 
     cv::Scalar color(0, 0, 255);
 
     if (info[2]->IsArray()) {
-      Local < Object > objColor = info[2]->ToObject();
+      Local < Object > objColor = Nan::To<Object>(info[2]).ToLocalChecked();
       color = setColor(objColor);
     }
 
-    int x1 = xy1->Get(0)->IntegerValue();
-    int y1 = xy1->Get(1)->IntegerValue();
+    int x1 = Nan::To<int64_t>(Nan::Get(xy1, 0).ToLocalChecked()).FromJust();
+    int y1 = Nan::To<int64_t>(Nan::Get(xy1, 1).ToLocalChecked()).FromJust();
 
-    int x2 = xy2->Get(0)->IntegerValue();
-    int y2 = xy2->Get(1)->IntegerValue();
+    int x2 = Nan::To<int64_t>(Nan::Get(xy2, 0).ToLocalChecked()).FromJust();
+    int y2 = Nan::To<int64_t>(Nan::Get(xy2, 1).ToLocalChecked()).FromJust();
 
     int thickness = 1;
 
-    if (info[3]->IntegerValue())
-      thickness = info[3]->IntegerValue();
+    if (Nan::To<int64_t>(info[3]).FromJust())
+      thickness = Nan::To<int64_t>(info[3]).FromJust();
 
     cv::line(self->mat, cv::Point(x1, y1), cv::Point(x2, y2), color, thickness);
   }
@@ -908,25 +1390,25 @@ NAN_METHOD(Matrix::FillPoly) {
   SETUP_FUNCTION(Matrix)
 
   if (info[0]->IsArray()) {
-    Local < Array > polyArray = Local < Array > ::Cast(info[0]->ToObject());
+    Local < Array > polyArray = Local < Array > ::Cast(Nan::To<Object>(info[0]).ToLocalChecked());
 
     cv::Point **polygons = new cv::Point*[polyArray->Length()];
     int *polySizes = new int[polyArray->Length()];
     for (unsigned int i = 0; i < polyArray->Length(); i++) {
-      Local<Array> singlePoly = Local<Array> ::Cast(polyArray->Get(i)->ToObject());
+      Local<Array> singlePoly = Local<Array> ::Cast(Nan::To<Object>(Nan::Get(polyArray, i).ToLocalChecked()).ToLocalChecked());
       polygons[i] = new cv::Point[singlePoly->Length()];
       polySizes[i] = singlePoly->Length();
 
       for (unsigned int j = 0; j < singlePoly->Length(); j++) {
-        Local<Array> point = Local<Array> ::Cast(singlePoly->Get(j)->ToObject());
-        polygons[i][j].x = point->Get(0)->IntegerValue();
-        polygons[i][j].y = point->Get(1)->IntegerValue();
+        Local<Array> point = Local<Array> ::Cast(Nan::To<Object>(Nan::Get(singlePoly, j).ToLocalChecked()).ToLocalChecked());
+        polygons[i][j].x = Nan::To<int64_t>(Nan::Get(point, 0).ToLocalChecked()).FromJust();
+        polygons[i][j].y = Nan::To<int64_t>(Nan::Get(point, 1).ToLocalChecked()).FromJust();
       }
     }
 
     cv::Scalar color(0, 0, 255);
     if (info[1]->IsArray()) {
-      Local<Object> objColor = info[1]->ToObject();
+      Local<Object> objColor = Nan::To<Object>(info[1]).ToLocalChecked();
       color = setColor(objColor);
     }
 
@@ -956,12 +1438,12 @@ NAN_METHOD(Matrix::Save) {
 
 // All this is for async save, see here for nan example:
 // https://github.com/rvagg/nan/blob/c579ae858ae3208d7e702e8400042ba9d48fa64b/examples/async_pi_estimate/async.cc
-class AsyncSaveWorker: public Nan::AsyncWorker {
+class AsyncSaveWorker: public AsyncBaseWorker {
 public:
-  AsyncSaveWorker(Nan::Callback *callback, Matrix* matrix, char* filename) :
-      Nan::AsyncWorker(callback),
-      matrix(matrix),
+  AsyncSaveWorker(Nan::Callback *callback, Local<Object> matrix, char* filename) :
+      AsyncBaseWorker(callback),
       filename(filename) {
+    mat = PinMatrix("matrix", matrix);
   }
 
   ~AsyncSaveWorker() {
@@ -972,29 +1454,23 @@ public:
   // here, so everything we need for input and output
   // should go on `this`.
   void Execute() {
-    res = cv::imwrite(this->filename, this->matrix->mat);
+    try {
+      res = cv::imwrite(this->filename, mat);
+    } catch (cv::Exception& e) {
+      SetErrorMessage(e.what());
+    }
   }
 
   // Executed when the async work is complete
   // this function will be run inside the main event loop
   // so it is safe to use V8 again
-  void HandleOKCallback() {
-    Nan::HandleScope scope;
-
-    Local<Value> argv[] = {
-      Nan::Null(),
-      Nan::New<Number>(res)
-    };
-
-    Nan::TryCatch try_catch;
-    callback->Call(2, argv);
-    if (try_catch.HasCaught()) {
-      Nan::FatalException(try_catch);
-    }
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
+    return scope.Escape(Nan::New<Number>(res));
   }
 
 private:
-  Matrix* matrix;
+  cv::Mat mat;
   std::string filename;
   int res;
 };
@@ -1003,61 +1479,121 @@ NAN_METHOD(Matrix::SaveAsync) {
   SETUP_FUNCTION(Matrix)
 
   if (!info[0]->IsString()) {
-    Nan::ThrowTypeError("filename required");
+    return Nan::ThrowTypeError("filename required");
   }
 
   Nan::Utf8String filename(info[0]);
 
-  REQ_FUN_ARG(1, cb);
-
-  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new AsyncSaveWorker(callback, self, *filename));
+  // Without a callback, saveAsync returns a promise
+  OPT_FUN_ARG(1, callback);
 
-  return;
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(
+      new AsyncSaveWorker(callback, info.This(), *filename)));
 }
 
 NAN_METHOD(Matrix::Zeros) {
   Nan::HandleScope scope;
 
-  int w = info[0]->Uint32Value();
-  int h = info[1]->Uint32Value();
-  int type = (info.Length() > 2) ? info[2]->IntegerValue() : CV_64FC1;
+  int w = Nan::To<uint32_t>(info[0]).FromJust();
+  int h = Nan::To<uint32_t>(info[1]).FromJust();
+  int type = (info.Length() > 2) ? Nan::To<int64_t>(info[2]).FromJust() : CV_64FC1;
 
-  Local<Object> im_h = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> im_h = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im_h);
   cv::Mat mat = cv::Mat::zeros(w, h, type);
 
   img->mat = mat;
+  img->SyncExternalMemory();
   info.GetReturnValue().Set(im_h);
 }
 
 NAN_METHOD(Matrix::Ones) {
   Nan::HandleScope scope;
 
-  int w = info[0]->Uint32Value();
-  int h = info[1]->Uint32Value();
-  int type = (info.Length() > 2) ? info[2]->IntegerValue() : CV_64FC1;
+  int w = Nan::To<uint32_t>(info[0]).FromJust();
+  int h = Nan::To<uint32_t>(info[1]).FromJust();
+  int type = (info.Length() > 2) ? Nan::To<int64_t>(info[2]).FromJust() : CV_64FC1;
 
-  Local<Object> im_h = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> im_h = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im_h);
   cv::Mat mat = cv::Mat::ones(w, h, type);
 
   img->mat = mat;
+  img->SyncExternalMemory();
   info.GetReturnValue().Set(im_h);
 }
 
 NAN_METHOD(Matrix::Eye) {
   Nan::HandleScope scope;
 
-  int w = info[0]->Uint32Value();
-  int h = info[1]->Uint32Value();
-  int type = (info.Length() > 2) ? info[2]->IntegerValue() : CV_64FC1;
+  int w = Nan::To<uint32_t>(info[0]).FromJust();
+  int h = Nan::To<uint32_t>(info[1]).FromJust();
+  int type = (info.Length() > 2) ? Nan::To<int64_t>(info[2]).FromJust() : CV_64FC1;
 
-  Local<Object> im_h = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> im_h = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im_h);
   cv::Mat mat = cv::Mat::eye(w, h, type);
 
   img->mat = mat;
+  img->SyncExternalMemory();
+  info.GetReturnValue().Set(im_h);
+}
+
+// Builds a matrix over raw pixel data held in a Buffer or TypedArray.
+// Matrix.fromBuffer(buf, rows, cols, type); // copies the data
+// Matrix.fromBuffer(buf, rows, cols, type, {copy: false}); // shares the memory
+NAN_METHOD(Matrix::FromBuffer) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 4 || !info[1]->IsInt32() || !info[2]->IsInt32()
+      || !info[3]->IsInt32()) {
+    return Nan::ThrowTypeError("fromBuffer takes (buffer, rows, cols, type[, options])");
+  }
+
+  char *data = NULL;
+  size_t length = 0;
+  if (Buffer::HasInstance(info[0])) {
+    data = Buffer::Data(info[0]);
+    length = Buffer::Length(info[0]);
+  } else if (info[0]->IsArrayBufferView()) {
+    Nan::TypedArrayContents<char> contents(info[0]);
+    data = *contents;
+    length = contents.length();
+  } else {
+    return Nan::ThrowTypeError("Argument 0 must be a Buffer or a TypedArray");
+  }
+
+  int rows = Nan::To<int64_t>(info[1]).FromJust();
+  int cols = Nan::To<int64_t>(info[2]).FromJust();
+  int type = Nan::To<int64_t>(info[3]).FromJust();
+  if (rows < 0 || cols < 0) {
+    return Nan::ThrowRangeError("rows and cols must not be negative");
+  }
+
+  bool copy = true;
+  if (info.Length() > 4 && info[4]->IsObject()) {
+    Local<Object> options = Nan::To<Object>(info[4]).ToLocalChecked();
+    if (Nan::Has(options, Nan::New<String>("copy").ToLocalChecked()).FromJust()) {
+      copy = Nan::To<bool>(Nan::Get(options, Nan::New<String>("copy").ToLocalChecked()).ToLocalChecked()).FromJust();
+    }
+  }
+
+  if (length < (size_t) rows * cols * CV_ELEM_SIZE(type)) {
+    return Nan::ThrowRangeError("Buffer is too small for the requested matrix");
+  }
+
+  Local<Object> im_h = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
+  Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im_h);
+  cv::Mat header(rows, cols, type, data);
+
+  if (copy) {
+    img->mat = header.clone();
+    img->SyncExternalMemory();
+  } else {
+    img->mat = header;
+    img->backing.Reset(Nan::To<Object>(info[0]).ToLocalChecked());
+  }
+
   info.GetReturnValue().Set(im_h);
 }
 
@@ -1069,7 +1605,10 @@ NAN_METHOD(Matrix::ConvertGrayscale) {
     Nan::ThrowError("Image is no 3-channel");
   }
 
-  cv::cvtColor(self->mat, self->mat, CV_BGR2GRAY);
+  cv::Mat res;
+  cv::cvtColor(self->mat, res, CV_BGR2GRAY);
+  self->mat = res;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1085,7 +1624,8 @@ NAN_METHOD(Matrix::ConvertHSVscale) {
   cv::Mat hsv;
 
   cv::cvtColor(self->mat, hsv, CV_BGR2HSV);
-  hsv.copyTo(self->mat);
+  self->mat = hsv;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1104,18 +1644,19 @@ NAN_METHOD(Matrix::GaussianBlur) {
     if (!info[0]->IsArray()) {
       Nan::ThrowTypeError("'ksize' argument must be a 2 double array");
     }
-    Local<Object> array = info[0]->ToObject();
+    Local<Object> array = Nan::To<Object>(info[0]).ToLocalChecked();
     // TODO: Length check
-    Local<Value> x = array->Get(0);
-    Local<Value> y = array->Get(1);
+    Local<Value> x = Nan::Get(array, 0).ToLocalChecked();
+    Local<Value> y = Nan::Get(array, 1).ToLocalChecked();
     if (!x->IsNumber() || !y->IsNumber()) {
       Nan::ThrowTypeError("'ksize' argument must be a 2 double array");
     }
-    ksize = cv::Size(x->NumberValue(), y->NumberValue());
+    ksize = cv::Size(Nan::To<double>(x).FromJust(), Nan::To<double>(y).FromJust());
   }
 
   cv::GaussianBlur(self->mat, blurred, ksize, 0);
-  blurred.copyTo(self->mat);
+  self->mat = blurred;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1127,7 +1668,7 @@ NAN_METHOD(Matrix::MedianBlur) {
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
 
   if (info[0]->IsNumber()) {
-    ksize = info[0]->IntegerValue();
+    ksize = Nan::To<int64_t>(info[0]).FromJust();
     if ((ksize % 2) == 0) {
       Nan::ThrowTypeError("'ksize' argument must be a positive odd integer");
     }
@@ -1136,7 +1677,8 @@ NAN_METHOD(Matrix::MedianBlur) {
   }
 
   cv::medianBlur(self->mat, blurred, ksize);
-  blurred.copyTo(self->mat);
+  self->mat = blurred;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1155,17 +1697,18 @@ NAN_METHOD(Matrix::BilateralFilter) {
     if (info.Length() < 3 || info.Length() > 4) {
       Nan::ThrowTypeError("BilateralFilter takes 0, 3, or 4 arguments");
     } else {
-      d = info[0]->IntegerValue();
-      sigmaColor = info[1]->NumberValue();
-      sigmaSpace = info[2]->NumberValue();
+      d = Nan::To<int64_t>(info[0]).FromJust();
+      sigmaColor = Nan::To<double>(info[1]).FromJust();
+      sigmaSpace = Nan::To<double>(info[2]).FromJust();
       if (info.Length() == 4) {
-        borderType = info[3]->IntegerValue();
+        borderType = Nan::To<int64_t>(info[3]).FromJust();
       }
     }
   }
 
   cv::bilateralFilter(self->mat, filtered, d, sigmaColor, sigmaSpace, borderType);
-  filtered.copyTo(self->mat);
+  self->mat = filtered;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1176,26 +1719,27 @@ NAN_METHOD(Matrix::Sobel) {
   if (info.Length() < 3)
     Nan::ThrowError("Need more arguments: sobel(ddepth, xorder, yorder, ksize=3, scale=1.0, delta=0.0, borderType=CV_BORDER_DEFAULT)");
 
-  int ddepth = info[0]->IntegerValue();
-  int xorder = info[1]->IntegerValue();
-  int yorder = info[2]->IntegerValue();
+  int ddepth = Nan::To<int64_t>(info[0]).FromJust();
+  int xorder = Nan::To<int64_t>(info[1]).FromJust();
+  int yorder = Nan::To<int64_t>(info[2]).FromJust();
 
   int ksize = 3;
-  if (info.Length() > 3) ksize = info[3]->IntegerValue();
+  if (info.Length() > 3) ksize = Nan::To<int64_t>(info[3]).FromJust();
   double scale = 1;
-  if (info.Length() > 4) scale = info[4]->NumberValue();
+  if (info.Length() > 4) scale = Nan::To<double>(info[4]).FromJust();
   double delta = 0;
-  if (info.Length() > 5) delta = info[5]->NumberValue();
+  if (info.Length() > 5) delta = Nan::To<double>(info[5]).FromJust();
   int borderType = cv::BORDER_DEFAULT;
-  if (info.Length() > 6) borderType = info[6]->IntegerValue();
+  if (info.Length() > 6) borderType = Nan::To<int64_t>(info[6]).FromJust();
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
 
   Local<Object> result_to_return =
-      Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+      Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *result = Nan::ObjectWrap::Unwrap<Matrix>(result_to_return);
 
   cv::Sobel(self->mat, result->mat, ddepth, xorder, yorder, ksize, scale, delta, borderType);
+  result->SyncExternalMemory();
 
   info.GetReturnValue().Set(result_to_return);
 }
@@ -1206,9 +1750,10 @@ NAN_METHOD(Matrix::Copy) {
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
 
   Local<Object> img_to_return =
-      Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+      Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(img_to_return);
   self->mat.copyTo(img->mat);
+  img->SyncExternalMemory();
 
   info.GetReturnValue().Set(img_to_return);
 }
@@ -1223,11 +1768,12 @@ NAN_METHOD(Matrix::Flip) {
         "(0 = X axis, positive = Y axis, negative = both axis)");
   }
 
-  int flipCode = info[0]->ToInt32()->Value();
+  int flipCode = Nan::To<Int32>(info[0]).ToLocalChecked()->Value();
 
-  Local<Object> img_to_return = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> img_to_return = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(img_to_return);
   cv::flip(self->mat, img->mat, flipCode);
+  img->SyncExternalMemory();
 
   info.GetReturnValue().Set(img_to_return);
 }
@@ -1242,16 +1788,18 @@ NAN_METHOD(Matrix::ROI) {
   }
 
   // Although it's an image to return, it is in fact a pointer to ROI of parent matrix
-  Local<Object> img_to_return = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> img_to_return = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(img_to_return);
 
-  int x = info[0]->IntegerValue();
-  int y = info[1]->IntegerValue();
-  int w = info[2]->IntegerValue();
-  int h = info[3]->IntegerValue();
+  int x = Nan::To<int64_t>(info[0]).FromJust();
+  int y = Nan::To<int64_t>(info[1]).FromJust();
+  int w = Nan::To<int64_t>(info[2]).FromJust();
+  int h = Nan::To<int64_t>(info[3]).FromJust();
 
   cv::Mat roi(self->mat, cv::Rect(x,y,w,h));
   img->mat = roi;
+  img->SyncExternalMemory();
+  self->ShareBacking(img);
 
   info.GetReturnValue().Set(img_to_return);
 }
@@ -1259,7 +1807,7 @@ NAN_METHOD(Matrix::ROI) {
 NAN_METHOD(Matrix::Ptr) {
   Nan::HandleScope scope;
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  int line = info[0]->Uint32Value();
+  int line = Nan::To<uint32_t>(info[0]).FromJust();
 
   char* data = self->mat.ptr<char>(line);
   // uchar* data = self->mat.data;
@@ -1274,9 +1822,12 @@ NAN_METHOD(Matrix::AbsDiff) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  Matrix *src1 = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
-  Matrix *src2 = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
-  cv::absdiff(src1->mat, src2->mat, self->mat);
+  Matrix *src1 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
+  Matrix *src2 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
+  cv::Mat res;
+  cv::absdiff(src1->mat, src2->mat, res);
+  self->mat = res;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1288,13 +1839,14 @@ NAN_METHOD(Matrix::Dct) {
   int cols = self->mat.cols;
   int rows = self->mat.rows;
 
-  bool inverse = info[1]->ToBoolean()->Value();
+  bool inverse = Nan::To<Boolean>(info[1]).ToLocalChecked()->Value();
 
-  Local<Object> out = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> out = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *m_out = Nan::ObjectWrap::Unwrap<Matrix>(out);
   m_out->mat.create(rows, cols, CV_32F);
 
   cv::dct(self->mat, m_out->mat, inverse ? 1 : 0);
+  m_out->SyncExternalMemory();
 
   info.GetReturnValue().Set(out);
 }
@@ -1303,15 +1855,18 @@ NAN_METHOD(Matrix::AddWeighted) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  Matrix *src1 = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
-  Matrix *src2 = Nan::ObjectWrap::Unwrap<Matrix>(info[2]->ToObject());
+  Matrix *src1 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
+  Matrix *src2 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[2]).ToLocalChecked());
 
-  float alpha = info[1]->NumberValue();
-  float beta = info[3]->NumberValue();
+  float alpha = Nan::To<double>(info[1]).FromJust();
+  float beta = Nan::To<double>(info[3]).FromJust();
   int gamma = 0;
 
   try {
-    cv::addWeighted(src1->mat, alpha, src2->mat, beta, gamma, self->mat);
+    cv::Mat res;
+    cv::addWeighted(src1->mat, alpha, src2->mat, beta, gamma, res);
+    self->mat = res;
+    self->SyncExternalMemory();
   } catch(cv::Exception& e ) {
     const char* err_msg = e.what();
     Nan::ThrowError(err_msg);
@@ -1324,14 +1879,21 @@ NAN_METHOD(Matrix::BitwiseXor) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  Matrix *src1 = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
-  Matrix *src2 = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+  Matrix *src1 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
+  Matrix *src2 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
 
   if (info.Length() == 3) {
-    Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(info[2]->ToObject());
-    cv::bitwise_xor(src1->mat, src2->mat, self->mat, mask->mat);
+    Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[2]).ToLocalChecked());
+    // Pixels outside the mask keep the matrix's values
+    cv::Mat res = self->mat.clone();
+    cv::bitwise_xor(src1->mat, src2->mat, res, mask->mat);
+    self->mat = res;
+    self->SyncExternalMemory();
   } else {
-    cv::bitwise_xor(src1->mat, src2->mat, self->mat);
+    cv::Mat res;
+    cv::bitwise_xor(src1->mat, src2->mat, res);
+    self->mat = res;
+    self->SyncExternalMemory();
   }
 
   info.GetReturnValue().Set(Nan::Null());
@@ -1341,12 +1903,14 @@ NAN_METHOD(Matrix::BitwiseNot) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  Matrix *dst = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *dst = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
   if (info.Length() == 2) {
-    Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+    Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
     cv::bitwise_not(self->mat, dst->mat, mask->mat);
+    dst->SyncExternalMemory();
   } else {
     cv::bitwise_not(self->mat, dst->mat);
+    dst->SyncExternalMemory();
   }
 
   info.GetReturnValue().Set(Nan::Null());
@@ -1356,13 +1920,20 @@ NAN_METHOD(Matrix::BitwiseAnd) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  Matrix *src1 = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
-  Matrix *src2 = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+  Matrix *src1 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
+  Matrix *src2 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
   if (info.Length() == 3) {
-    Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(info[2]->ToObject());
-    cv::bitwise_and(src1->mat, src2->mat, self->mat, mask->mat);
+    Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[2]).ToLocalChecked());
+    // Pixels outside the mask keep the matrix's values
+    cv::Mat res = self->mat.clone();
+    cv::bitwise_and(src1->mat, src2->mat, res, mask->mat);
+    self->mat = res;
+    self->SyncExternalMemory();
   } else {
-    cv::bitwise_and(src1->mat, src2->mat, self->mat);
+    cv::Mat res;
+    cv::bitwise_and(src1->mat, src2->mat, res);
+    self->mat = res;
+    self->SyncExternalMemory();
   }
 
   info.GetReturnValue().Set(Nan::Null());
@@ -1395,32 +1966,32 @@ NAN_METHOD(Matrix::Moments) {
 
   Local<Object> res = Nan::New<Object>();
 
-  res->Set(Nan::New("m00").ToLocalChecked(), Nan::New<Number>(mo.m00));
-  res->Set(Nan::New("m10").ToLocalChecked(), Nan::New<Number>(mo.m10));
-  res->Set(Nan::New("m01").ToLocalChecked(), Nan::New<Number>(mo.m01));
-  res->Set(Nan::New("m20").ToLocalChecked(), Nan::New<Number>(mo.m20));
-  res->Set(Nan::New("m11").ToLocalChecked(), Nan::New<Number>(mo.m11));
-  res->Set(Nan::New("m02").ToLocalChecked(), Nan::New<Number>(mo.m02));
-  res->Set(Nan::New("m30").ToLocalChecked(), Nan::New<Number>(mo.m30));
-  res->Set(Nan::New("m21").ToLocalChecked(), Nan::New<Number>(mo.m21));
-  res->Set(Nan::New("m12").ToLocalChecked(), Nan::New<Number>(mo.m12));
-  res->Set(Nan::New("m03").ToLocalChecked(), Nan::New<Number>(mo.m03));
-
-  res->Set(Nan::New("mu20").ToLocalChecked(), Nan::New<Number>(mo.mu20));
-  res->Set(Nan::New("mu11").ToLocalChecked(), Nan::New<Number>(mo.mu11));
-  res->Set(Nan::New("mu02").ToLocalChecked(), Nan::New<Number>(mo.mu02));
-  res->Set(Nan::New("mu30").ToLocalChecked(), Nan::New<Number>(mo.mu30));
-  res->Set(Nan::New("mu21").ToLocalChecked(), Nan::New<Number>(mo.mu21));
-  res->Set(Nan::New("mu12").ToLocalChecked(), Nan::New<Number>(mo.mu12));
-  res->Set(Nan::New("mu03").ToLocalChecked(), Nan::New<Number>(mo.mu03));
-
-  res->Set(Nan::New("nu20").ToLocalChecked(), Nan::New<Number>(mo.nu20));
-  res->Set(Nan::New("nu11").ToLocalChecked(), Nan::New<Number>(mo.nu11));
-  res->Set(Nan::New("nu02").ToLocalChecked(), Nan::New<Number>(mo.nu02));
-  res->Set(Nan::New("nu30").ToLocalChecked(), Nan::New<Number>(mo.nu30));
-  res->Set(Nan::New("nu21").ToLocalChecked(), Nan::New<Number>(mo.nu21));
-  res->Set(Nan::New("nu12").ToLocalChecked(), Nan::New<Number>(mo.nu12));
-  res->Set(Nan::New("nu03").ToLocalChecked(), Nan::New<Number>(mo.nu03));
+  Nan::Set(res, Nan::New("m00").ToLocalChecked(), Nan::New<Number>(mo.m00));
+  Nan::Set(res, Nan::New("m10").ToLocalChecked(), Nan::New<Number>(mo.m10));
+  Nan::Set(res, Nan::New("m01").ToLocalChecked(), Nan::New<Number>(mo.m01));
+  Nan::Set(res, Nan::New("m20").ToLocalChecked(), Nan::New<Number>(mo.m20));
+  Nan::Set(res, Nan::New("m11").ToLocalChecked(), Nan::New<Number>(mo.m11));
+  Nan::Set(res, Nan::New("m02").ToLocalChecked(), Nan::New<Number>(mo.m02));
+  Nan::Set(res, Nan::New("m30").ToLocalChecked(), Nan::New<Number>(mo.m30));
+  Nan::Set(res, Nan::New("m21").ToLocalChecked(), Nan::New<Number>(mo.m21));
+  Nan::Set(res, Nan::New("m12").ToLocalChecked(), Nan::New<Number>(mo.m12));
+  Nan::Set(res, Nan::New("m03").ToLocalChecked(), Nan::New<Number>(mo.m03));
+
+  Nan::Set(res, Nan::New("mu20").ToLocalChecked(), Nan::New<Number>(mo.mu20));
+  Nan::Set(res, Nan::New("mu11").ToLocalChecked(), Nan::New<Number>(mo.mu11));
+  Nan::Set(res, Nan::New("mu02").ToLocalChecked(), Nan::New<Number>(mo.mu02));
+  Nan::Set(res, Nan::New("mu30").ToLocalChecked(), Nan::New<Number>(mo.mu30));
+  Nan::Set(res, Nan::New("mu21").ToLocalChecked(), Nan::New<Number>(mo.mu21));
+  Nan::Set(res, Nan::New("mu12").ToLocalChecked(), Nan::New<Number>(mo.mu12));
+  Nan::Set(res, Nan::New("mu03").ToLocalChecked(), Nan::New<Number>(mo.mu03));
+
+  Nan::Set(res, Nan::New("nu20").ToLocalChecked(), Nan::New<Number>(mo.nu20));
+  Nan::Set(res, Nan::New("nu11").ToLocalChecked(), Nan::New<Number>(mo.nu11));
+  Nan::Set(res, Nan::New("nu02").ToLocalChecked(), Nan::New<Number>(mo.nu02));
+  Nan::Set(res, Nan::New("nu30").ToLocalChecked(), Nan::New<Number>(mo.nu30));
+  Nan::Set(res, Nan::New("nu21").ToLocalChecked(), Nan::New<Number>(mo.nu21));
+  Nan::Set(res, Nan::New("nu12").ToLocalChecked(), Nan::New<Number>(mo.nu12));
+  Nan::Set(res, Nan::New("nu03").ToLocalChecked(), Nan::New<Number>(mo.nu03));
 
   info.GetReturnValue().Set(res);
 }
@@ -1429,10 +2000,13 @@ NAN_METHOD(Matrix::Canny) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  int lowThresh = info[0]->NumberValue();
-  int highThresh = info[1]->NumberValue();
+  int lowThresh = Nan::To<double>(info[0]).FromJust();
+  int highThresh = Nan::To<double>(info[1]).FromJust();
 
-  cv::Canny(self->mat, self->mat, lowThresh, highThresh);
+  cv::Mat res;
+  cv::Canny(self->mat, res, lowThresh, highThresh);
+  self->mat = res;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1441,15 +2015,18 @@ NAN_METHOD(Matrix::Dilate) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  int niters = info[0]->NumberValue();
+  int niters = Nan::To<double>(info[0]).FromJust();
 
   cv::Mat kernel = cv::Mat();
   if (info.Length() == 2) {
-    Matrix *kernelMatrix = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+    Matrix *kernelMatrix = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
     kernel = kernelMatrix->mat;
   }
 
-  cv::dilate(self->mat, self->mat, kernel, cv::Point(-1, -1), niters);
+  cv::Mat res;
+  cv::dilate(self->mat, res, kernel, cv::Point(-1, -1), niters);
+  self->mat = res;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1458,14 +2035,17 @@ NAN_METHOD(Matrix::Erode) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  int niters = info[0]->NumberValue();
+  int niters = Nan::To<double>(info[0]).FromJust();
 
   cv::Mat kernel = cv::Mat();
   if (info.Length() == 2) {
-    Matrix *kernelMatrix = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+    Matrix *kernelMatrix = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
     kernel = kernelMatrix->mat;
   }
-  cv::erode(self->mat, self->mat, kernel, cv::Point(-1, -1), niters);
+  cv::Mat res;
+  cv::erode(self->mat, res, kernel, cv::Point(-1, -1), niters);
+  self->mat = res;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1477,15 +2057,15 @@ NAN_METHOD(Matrix::FindContours) {
   int chain = CV_CHAIN_APPROX_SIMPLE;
 
   if (info.Length() > 0) {
-    if (info[0]->IsNumber()) mode = info[0]->IntegerValue();
+    if (info[0]->IsNumber()) mode = Nan::To<int64_t>(info[0]).FromJust();
   }
 
   if (info.Length() > 1) {
-    if (info[1]->IsNumber()) chain = info[1]->IntegerValue();
+    if (info[1]->IsNumber()) chain = Nan::To<int64_t>(info[1]).FromJust();
   }
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  Local<Object> conts_to_return= Nan::New(Contour::constructor)->GetFunction()->NewInstance();
+  Local<Object> conts_to_return= Nan::NewInstance(Nan::GetFunction(Nan::New(Contour::constructor)).ToLocalChecked()).ToLocalChecked();
   Contour *contours = Nan::ObjectWrap::Unwrap<Contour>(conts_to_return);
 
   cv::findContours(self->mat, contours->contours, contours->hierarchy, mode, chain);
@@ -1498,23 +2078,23 @@ NAN_METHOD(Matrix::DrawContour) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  Contour *cont = Nan::ObjectWrap::Unwrap<Contour>(info[0]->ToObject());
-  int pos = info[1]->NumberValue();
+  Contour *cont = Nan::ObjectWrap::Unwrap<Contour>(Nan::To<Object>(info[0]).ToLocalChecked());
+  int pos = Nan::To<double>(info[1]).FromJust();
   cv::Scalar color(0, 0, 255);
 
   if (info[2]->IsArray()) {
-    Local<Object> objColor = info[2]->ToObject();
+    Local<Object> objColor = Nan::To<Object>(info[2]).ToLocalChecked();
     color = setColor(objColor);
   }
 
-  int thickness = info.Length() < 4 ? 1 : info[3]->NumberValue();
-  int lineType = info.Length() < 5 ? 8 : info[4]->NumberValue();
-  int maxLevel = info.Length() < 6 ? 0 : info[5]->NumberValue();
+  int thickness = info.Length() < 4 ? 1 : Nan::To<double>(info[3]).FromJust();
+  int lineType = info.Length() < 5 ? 8 : Nan::To<double>(info[4]).FromJust();
+  int maxLevel = info.Length() < 6 ? 0 : Nan::To<double>(info[5]).FromJust();
 
   cv::Point offset;
   if (info.Length() == 6) {
     Local<Array> _offset = Local<Array>::Cast(info[5]);
-    offset = cv::Point(_offset->Get(0)->ToNumber()->Value(), _offset->Get(1)->ToNumber()->Value());
+    offset = cv::Point(Nan::To<Number>(Nan::Get(_offset, 0).ToLocalChecked()).ToLocalChecked()->Value(), Nan::To<Number>(Nan::Get(_offset, 1).ToLocalChecked()).ToLocalChecked()->Value());
   }
 
   cv::drawContours(self->mat, cont->contours, pos, color, thickness, lineType, cont->hierarchy, maxLevel, offset);
@@ -1526,15 +2106,15 @@ NAN_METHOD(Matrix::DrawAllContours) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  Contour *cont = Nan::ObjectWrap::Unwrap<Contour>(info[0]->ToObject());
+  Contour *cont = Nan::ObjectWrap::Unwrap<Contour>(Nan::To<Object>(info[0]).ToLocalChecked());
   cv::Scalar color(0, 0, 255);
 
   if (info[1]->IsArray()) {
-    Local<Object> objColor = info[1]->ToObject();
+    Local<Object> objColor = Nan::To<Object>(info[1]).ToLocalChecked();
     color = setColor(objColor);
   }
 
-  int thickness = info.Length() < 3 ? 1 : info[2]->NumberValue();
+  int thickness = info.Length() < 3 ? 1 : Nan::To<double>(info[2]).FromJust();
   cv::drawContours(self->mat, cont->contours, -1, color, thickness);
 
   return;
@@ -1555,9 +2135,9 @@ NAN_METHOD(Matrix::GoodFeaturesToTrack) {
 
   for (unsigned int i=0; i<corners.size(); i++) {
     v8::Local<v8::Array> pt = Nan::New<Array>(2);
-    pt->Set(0, Nan::New<Number>((double) corners[i].x));
-    pt->Set(1, Nan::New<Number>((double) corners[i].y));
-    arr->Set(i, pt);
+    Nan::Set(pt, 0, Nan::New<Number>((double) corners[i].x));
+    Nan::Set(pt, 1, Nan::New<Number>((double) corners[i].y));
+    Nan::Set(arr, i, pt);
   }
 
   info.GetReturnValue().Set(arr);
@@ -1567,11 +2147,11 @@ NAN_METHOD(Matrix::HoughLinesP) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  double rho = info.Length() < 1 ? 1 : info[0]->NumberValue();
-  double theta = info.Length() < 2 ? CV_PI/180 : info[1]->NumberValue();
-  int threshold = info.Length() < 3 ? 80 : info[2]->Uint32Value();
-  double minLineLength = info.Length() < 4 ? 30 : info[3]->NumberValue();
-  double maxLineGap = info.Length() < 5 ? 10 : info[4]->NumberValue();
+  double rho = info.Length() < 1 ? 1 : Nan::To<double>(info[0]).FromJust();
+  double theta = info.Length() < 2 ? CV_PI/180 : Nan::To<double>(info[1]).FromJust();
+  int threshold = info.Length() < 3 ? 80 : Nan::To<uint32_t>(info[2]).FromJust();
+  double minLineLength = info.Length() < 4 ? 30 : Nan::To<double>(info[3]).FromJust();
+  double maxLineGap = info.Length() < 5 ? 10 : Nan::To<double>(info[4]).FromJust();
   std::vector<cv::Vec4i> lines;
 
   cv::Mat gray;
@@ -1584,11 +2164,11 @@ NAN_METHOD(Matrix::HoughLinesP) {
 
   for (unsigned int i=0; i<lines.size(); i++) {
     v8::Local<v8::Array> pt = Nan::New<Array>(4);
-    pt->Set(0, Nan::New<Number>((double) lines[i][0]));
-    pt->Set(1, Nan::New<Number>((double) lines[i][1]));
-    pt->Set(2, Nan::New<Number>((double) lines[i][2]));
-    pt->Set(3, Nan::New<Number>((double) lines[i][3]));
-    arr->Set(i, pt);
+    Nan::Set(pt, 0, Nan::New<Number>((double) lines[i][0]));
+    Nan::Set(pt, 1, Nan::New<Number>((double) lines[i][1]));
+    Nan::Set(pt, 2, Nan::New<Number>((double) lines[i][2]));
+    Nan::Set(pt, 3, Nan::New<Number>((double) lines[i][3]));
+    Nan::Set(arr, i, pt);
   }
 
   info.GetReturnValue().Set(arr);
@@ -1599,12 +2179,12 @@ NAN_METHOD(Matrix::HoughCircles) {
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
 
-  double dp = info.Length() < 1 ? 1 : info[0]->NumberValue();
-  double minDist = info.Length() < 2 ? 1 : info[1]->NumberValue();
-  double higherThreshold = info.Length() < 3 ? 100 : info[2]->NumberValue();
-  double accumulatorThreshold = info.Length() < 4 ? 100 : info[3]->NumberValue();
-  int minRadius = info.Length() < 5 ? 0 : info[4]->Uint32Value();
-  int maxRadius = info.Length() < 6 ? 0 : info[5]->Uint32Value();
+  double dp = info.Length() < 1 ? 1 : Nan::To<double>(info[0]).FromJust();
+  double minDist = info.Length() < 2 ? 1 : Nan::To<double>(info[1]).FromJust();
+  double higherThreshold = info.Length() < 3 ? 100 : Nan::To<double>(info[2]).FromJust();
+  double accumulatorThreshold = info.Length() < 4 ? 100 : Nan::To<double>(info[3]).FromJust();
+  int minRadius = info.Length() < 5 ? 0 : Nan::To<uint32_t>(info[4]).FromJust();
+  int maxRadius = info.Length() < 6 ? 0 : Nan::To<uint32_t>(info[5]).FromJust();
   std::vector<cv::Vec3f> circles;
 
   cv::Mat gray;
@@ -1618,10 +2198,10 @@ NAN_METHOD(Matrix::HoughCircles) {
 
   for (unsigned int i=0; i < circles.size(); i++) {
     v8::Local<v8::Array> pt = Nan::New<Array>(3);
-    pt->Set(0, Nan::New<Number>((double) circles[i][0]));  // center x
-    pt->Set(1, Nan::New<Number>((double) circles[i][1]));// center y
-    pt->Set(2, Nan::New<Number>((double) circles[i][2]));// radius
-    arr->Set(i, pt);
+    Nan::Set(pt, 0, Nan::New<Number>((double) circles[i][0]));  // center x
+    Nan::Set(pt, 1, Nan::New<Number>((double) circles[i][1]));// center y
+    Nan::Set(pt, 2, Nan::New<Number>((double) circles[i][2]));// radius
+    Nan::Set(arr, i, pt);
   }
 
   info.GetReturnValue().Set(arr);
@@ -1633,43 +2213,43 @@ cv::Scalar setColor(Local<Object> objColor) {
   // We'll accomodate a channel count up to 4 and fall back to the old
   // "assume it's always 3" in the default case
   if (!objColor->HasRealIndexedProperty(1)) {
-    channels[0] = objColor->Get(0)->IntegerValue();
+    channels[0] = Nan::To<int64_t>(Nan::Get(objColor, 0).ToLocalChecked()).FromJust();
   } else if (!objColor->HasRealIndexedProperty(2)) {
-    channels[0] = objColor->Get(0)->IntegerValue();
-    channels[1] = objColor->Get(1)->IntegerValue();
+    channels[0] = Nan::To<int64_t>(Nan::Get(objColor, 0).ToLocalChecked()).FromJust();
+    channels[1] = Nan::To<int64_t>(Nan::Get(objColor, 1).ToLocalChecked()).FromJust();
   } else if (!objColor->HasRealIndexedProperty(4)) {
-    channels[0] = objColor->Get(0)->IntegerValue();
-    channels[1] = objColor->Get(1)->IntegerValue();
-    channels[2] = objColor->Get(2)->IntegerValue();
-    channels[3] = objColor->Get(3)->IntegerValue();
+    channels[0] = Nan::To<int64_t>(Nan::Get(objColor, 0).ToLocalChecked()).FromJust();
+    channels[1] = Nan::To<int64_t>(Nan::Get(objColor, 1).ToLocalChecked()).FromJust();
+    channels[2] = Nan::To<int64_t>(Nan::Get(objColor, 2).ToLocalChecked()).FromJust();
+    channels[3] = Nan::To<int64_t>(Nan::Get(objColor, 3).ToLocalChecked()).FromJust();
   } else {
-    channels[0] = objColor->Get(0)->IntegerValue();
-    channels[1] = objColor->Get(1)->IntegerValue();
-    channels[2] = objColor->Get(2)->IntegerValue();
+    channels[0] = Nan::To<int64_t>(Nan::Get(objColor, 0).ToLocalChecked()).FromJust();
+    channels[1] = Nan::To<int64_t>(Nan::Get(objColor, 1).ToLocalChecked()).FromJust();
+    channels[2] = Nan::To<int64_t>(Nan::Get(objColor, 2).ToLocalChecked()).FromJust();
   }
 
   return cv::Scalar(channels[0], channels[1], channels[2], channels[3]);
 }
 
 cv::Point setPoint(Local<Object> objPoint) {
-  return cv::Point(objPoint->Get(0)->IntegerValue(),
-      objPoint->Get(1)->IntegerValue());
+  return cv::Point(Nan::To<int64_t>(Nan::Get(objPoint, 0).ToLocalChecked()).FromJust(),
+      Nan::To<int64_t>(Nan::Get(objPoint, 1).ToLocalChecked()).FromJust());
 }
 
 cv::Rect* setRect(Local<Object> objRect, cv::Rect &result) {
-  if (!objRect->IsArray() || !objRect->Get(0)->IsArray()
-      || !objRect->Get(0)->IsArray()) {
+  if (!objRect->IsArray() || !Nan::Get(objRect, 0).ToLocalChecked()->IsArray()
+      || !Nan::Get(objRect, 0).ToLocalChecked()->IsArray()) {
     printf("error");
     return 0;
   };
 
-  Local < Object > point = objRect->Get(0)->ToObject();
-  Local < Object > size = objRect->Get(1)->ToObject();
+  Local < Object > point = Nan::To<Object>(Nan::Get(objRect, 0).ToLocalChecked()).ToLocalChecked();
+  Local < Object > size = Nan::To<Object>(Nan::Get(objRect, 1).ToLocalChecked()).ToLocalChecked();
 
-  result.x = point->Get(0)->IntegerValue();
-  result.y = point->Get(1)->IntegerValue();
-  result.width = size->Get(0)->IntegerValue();
-  result.height = size->Get(1)->IntegerValue();
+  result.x = Nan::To<int64_t>(Nan::Get(point, 0).ToLocalChecked()).FromJust();
+  result.y = Nan::To<int64_t>(Nan::Get(point, 1).ToLocalChecked()).FromJust();
+  result.width = Nan::To<int64_t>(Nan::Get(size, 0).ToLocalChecked()).FromJust();
+  result.height = Nan::To<int64_t>(Nan::Get(size, 1).ToLocalChecked()).FromJust();
 
   return &result;
 }
@@ -1677,8 +2257,8 @@ cv::Rect* setRect(Local<Object> objRect, cv::Rect &result) {
 NAN_METHOD(Matrix::Resize) {
   Nan::HandleScope scope;
 
-  int x = info[0]->Uint32Value();
-  int y = info[1]->Uint32Value();
+  int x = Nan::To<uint32_t>(info[0]).FromJust();
+  int y = Nan::To<uint32_t>(info[1]).FromJust();
   /*
    CV_INTER_NN        =0,
    CV_INTER_LINEAR    =1,
@@ -1686,13 +2266,14 @@ NAN_METHOD(Matrix::Resize) {
    CV_INTER_AREA      =3,
    CV_INTER_LANCZOS4  =4
    */
-  int interpolation = (info.Length() < 3) ? (int)cv::INTER_LINEAR : info[2]->Uint32Value();
+  int interpolation = (info.Length() < 3) ? (int)cv::INTER_LINEAR : Nan::To<uint32_t>(info[2]).FromJust();
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
   cv::Mat res = cv::Mat(x, y, CV_32FC3);
   cv::resize(self->mat, res, cv::Size(x, y), 0, 0, interpolation);
   ~self->mat;
   self->mat = res;
+  self->SyncExternalMemory();
 
   return;
 }
@@ -1704,7 +2285,7 @@ NAN_METHOD(Matrix::Rotate) {
   cv::Mat rotMatrix(2, 3, CV_32FC1);
   cv::Mat res;
 
-  float angle = info[0]->ToNumber()->Value();
+  float angle = Nan::To<Number>(info[0]).ToLocalChecked()->Value();
 
   // Modification by SergeMv
   //-------------
@@ -1721,6 +2302,7 @@ NAN_METHOD(Matrix::Rotate) {
       cv::transpose(self->mat, res);
       ~self->mat;
       self->mat = res;
+      self->SyncExternalMemory();
     }
     // Now flip the image
     int mode = -1;// flip around both axes
@@ -1728,15 +2310,18 @@ NAN_METHOD(Matrix::Rotate) {
     if (angle2 == 90) {mode = 0;}
     // If clockwise, flip around the y-axis
     if (angle2 == 270) {mode = 1;}
-    cv::flip(self->mat, self->mat, mode);
+    cv::Mat flipped;
+    cv::flip(self->mat, flipped, mode);
+    self->mat = flipped;
+    self->SyncExternalMemory();
     return;
   }
 
   //-------------
   int x = info[1]->IsUndefined() ? round(self->mat.size().width / 2) :
-      info[1]->Uint32Value();
+      Nan::To<uint32_t>(info[1]).FromJust();
   int y = info[1]->IsUndefined() ? round(self->mat.size().height / 2) :
-      info[2]->Uint32Value();
+      Nan::To<uint32_t>(info[2]).FromJust();
 
   cv::Point center = cv::Point(x,y);
   rotMatrix = getRotationMatrix2D(center, angle, 1.0);
@@ -1744,6 +2329,7 @@ NAN_METHOD(Matrix::Rotate) {
   cv::warpAffine(self->mat, res, rotMatrix, self->mat.size());
   ~self->mat;
   self->mat = res;
+  self->SyncExternalMemory();
 
   return;
 }
@@ -1754,17 +2340,18 @@ NAN_METHOD(Matrix::GetRotationMatrix2D) {
     JSTHROW("Invalid number of arguments");
   }
 
-  float angle = info[0]->ToNumber()->Value();
-  int x = info[1]->Uint32Value();
-  int y = info[2]->Uint32Value();
-  double scale = info[3]->IsUndefined() ? 1.0 : info[3]->NumberValue();
+  float angle = Nan::To<Number>(info[0]).ToLocalChecked()->Value();
+  int x = Nan::To<uint32_t>(info[1]).FromJust();
+  int y = Nan::To<uint32_t>(info[2]).FromJust();
+  double scale = info[3]->IsUndefined() ? 1.0 : Nan::To<double>(info[3]).FromJust();
 
   Local<Object> img_to_return =
-      Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+      Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(img_to_return);
 
   cv::Point center = cv::Point(x,y);
   img->mat = getRotationMatrix2D(center, angle, scale);
+  img->SyncExternalMemory();
 
   info.GetReturnValue().Set(img_to_return);
 }
@@ -1775,16 +2362,17 @@ NAN_METHOD(Matrix::WarpAffine) {
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
   cv::Mat res;
 
-  Matrix *rotMatrix = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *rotMatrix = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
 
   // Resize the image if size is specified
-  int dstRows = info[1]->IsUndefined() ? self->mat.rows : info[1]->Uint32Value();
-  int dstCols = info[2]->IsUndefined() ? self->mat.cols : info[2]->Uint32Value();
+  int dstRows = info[1]->IsUndefined() ? self->mat.rows : Nan::To<uint32_t>(info[1]).FromJust();
+  int dstCols = info[2]->IsUndefined() ? self->mat.cols : Nan::To<uint32_t>(info[2]).FromJust();
   cv::Size resSize = cv::Size(dstRows, dstCols);
 
   cv::warpAffine(self->mat, res, rotMatrix->mat, resSize);
   ~self->mat;
   self->mat = res;
+  self->SyncExternalMemory();
 
   return;
 }
@@ -1792,14 +2380,20 @@ NAN_METHOD(Matrix::WarpAffine) {
 NAN_METHOD(Matrix::PyrDown) {
   SETUP_FUNCTION(Matrix)
 
-  cv::pyrDown(self->mat, self->mat);
+  cv::Mat res;
+  cv::pyrDown(self->mat, res);
+  self->mat = res;
+  self->SyncExternalMemory();
   return;
 }
 
 NAN_METHOD(Matrix::PyrUp) {
   SETUP_FUNCTION(Matrix)
 
-  cv::pyrUp(self->mat, self->mat);
+  cv::Mat res;
+  cv::pyrUp(self->mat, res);
+  self->mat = res;
+  self->SyncExternalMemory();
   return;
 }
 
@@ -1811,8 +2405,8 @@ NAN_METHOD(Matrix::inRange) {
    Nan::ThrowError(String::New("Image is no 3-channel"));*/
 
   if (info[0]->IsArray() && info[1]->IsArray()) {
-    Local<Object> args_lowerb = info[0]->ToObject();
-    Local<Object> args_upperb = info[1]->ToObject();
+    Local<Object> args_lowerb = Nan::To<Object>(info[0]).ToLocalChecked();
+    Local<Object> args_upperb = Nan::To<Object>(info[1]).ToLocalChecked();
 
     cv::Scalar lowerb(0, 0, 0);
     cv::Scalar upperb(0, 0, 0);
@@ -1822,7 +2416,8 @@ NAN_METHOD(Matrix::inRange) {
 
     cv::Mat mask;
     cv::inRange(self->mat, lowerb, upperb, mask);
-    mask.copyTo(self->mat);
+    self->mat = mask;
+    self->SyncExternalMemory();
   }
 
   info.GetReturnValue().Set(Nan::Null());
@@ -1830,10 +2425,10 @@ NAN_METHOD(Matrix::inRange) {
 
 NAN_METHOD(Matrix::AdjustROI) {
   SETUP_FUNCTION(Matrix)
-  int dtop = info[0]->Uint32Value();
-  int dbottom = info[1]->Uint32Value();
-  int dleft = info[2]->Uint32Value();
-  int dright = info[3]->Uint32Value();
+  int dtop = Nan::To<uint32_t>(info[0]).FromJust();
+  int dbottom = Nan::To<uint32_t>(info[1]).FromJust();
+  int dleft = Nan::To<uint32_t>(info[2]).FromJust();
+  int dright = Nan::To<uint32_t>(info[3]).FromJust();
 
   self->mat.adjustROI(dtop, dbottom, dleft, dright);
 
@@ -1849,10 +2444,10 @@ NAN_METHOD(Matrix::LocateROI) {
   self->mat.locateROI(wholeSize, ofs);
 
   v8::Local < v8::Array > arr = Nan::New<Array>(4);
-  arr->Set(0, Nan::New<Number>(wholeSize.width));
-  arr->Set(1, Nan::New<Number>(wholeSize.height));
-  arr->Set(2, Nan::New<Number>(ofs.x));
-  arr->Set(3, Nan::New<Number>(ofs.y));
+  Nan::Set(arr, 0, Nan::New<Number>(wholeSize.width));
+  Nan::Set(arr, 1, Nan::New<Number>(wholeSize.height));
+  Nan::Set(arr, 2, Nan::New<Number>(ofs.x));
+  Nan::Set(arr, 3, Nan::New<Number>(ofs.y));
 
   info.GetReturnValue().Set(arr);
 }
@@ -1860,8 +2455,8 @@ NAN_METHOD(Matrix::LocateROI) {
 NAN_METHOD(Matrix::Threshold) {
   SETUP_FUNCTION(Matrix)
 
-  double threshold = info[0]->NumberValue();
-  double maxVal = info[1]->NumberValue();
+  double threshold = Nan::To<double>(info[0]).FromJust();
+  double maxVal = Nan::To<double>(info[1]).FromJust();
   int typ = cv::THRESH_BINARY;
 
   if (info.Length() >= 3) {
@@ -1924,11 +2519,12 @@ NAN_METHOD(Matrix::Threshold) {
   }
 
   Local < Object > img_to_return =
-      Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+      Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(img_to_return);
   self->mat.copyTo(img->mat);
 
   cv::threshold(self->mat, img->mat, threshold, maxVal, typ);
+  img->SyncExternalMemory();
 
   info.GetReturnValue().Set(img_to_return);
 }
@@ -1936,19 +2532,20 @@ NAN_METHOD(Matrix::Threshold) {
 NAN_METHOD(Matrix::AdaptiveThreshold) {
   SETUP_FUNCTION(Matrix)
 
-  double maxVal = info[0]->NumberValue();
-  double adaptiveMethod = info[1]->NumberValue();
-  double thresholdType = info[2]->NumberValue();
-  double blockSize = info[3]->NumberValue();
-  double C = info[4]->NumberValue();
+  double maxVal = Nan::To<double>(info[0]).FromJust();
+  double adaptiveMethod = Nan::To<double>(info[1]).FromJust();
+  double thresholdType = Nan::To<double>(info[2]).FromJust();
+  double blockSize = Nan::To<double>(info[3]).FromJust();
+  double C = Nan::To<double>(info[4]).FromJust();
 
   Local < Object > img_to_return =
-      Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+      Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(img_to_return);
   self->mat.copyTo(img->mat);
 
   cv::adaptiveThreshold(self->mat, img->mat, maxVal, adaptiveMethod,
       thresholdType, blockSize, C);
+  img->SyncExternalMemory();
 
   info.GetReturnValue().Set(img_to_return);
 }
@@ -1958,16 +2555,18 @@ NAN_METHOD(Matrix::MeanStdDev) {
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
 
-  Local<Object> mean = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> mean = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *m_mean = Nan::ObjectWrap::Unwrap<Matrix>(mean);
-  Local<Object> stddev = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> stddev = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *m_stddev = Nan::ObjectWrap::Unwrap<Matrix>(stddev);
 
   cv::meanStdDev(self->mat, m_mean->mat, m_stddev->mat);
+  m_mean->SyncExternalMemory();
+  m_stddev->SyncExternalMemory();
 
   Local<Object> data = Nan::New<Object>();
-  data->Set(Nan::New<String>("mean").ToLocalChecked(), mean);
-  data->Set(Nan::New<String>("stddev").ToLocalChecked(), stddev);
+  Nan::Set(data, Nan::New<String>("mean").ToLocalChecked(), mean);
+  Nan::Set(data, Nan::New<String>("stddev").ToLocalChecked(), stddev);
 
   info.GetReturnValue().Set(data);
 }
@@ -1989,11 +2588,11 @@ NAN_METHOD(Matrix::CopyTo) {
   int height = self->mat.size().height;
 
   // param 0 - destination image:
-  Matrix *dest = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *dest = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
   // param 1 - x coord of the destination
-  int x = info[1]->IntegerValue();
+  int x = Nan::To<int64_t>(info[1]).FromJust();
   // param 2 - y coord of the destination
-  int y = info[2]->IntegerValue();
+  int y = Nan::To<int64_t>(info[2]).FromJust();
 
   cv::Mat dstROI = cv::Mat(dest->mat, cv::Rect(x, y, width, height));
   self->mat.copyTo(dstROI);
@@ -2013,7 +2612,7 @@ NAN_METHOD(Matrix::ConvertTo) {
   }
 
   // param 0 - destination image
-  Matrix *dest = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *dest = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
 
   // param 1 - desired matrix type
   int rtype = -1;
@@ -2048,55 +2647,16 @@ NAN_METHOD(Matrix::CvtColor) {
   }
 
   // Get transform string
-  v8::String::Utf8Value str (info[0]->ToString());
-  std::string str2 = std::string(*str);
-  const char * sTransform = (const char *) str2.c_str();
-  int iTransform;
-
-  if (!strcmp(sTransform, "CV_BGR2GRAY")) {
-    iTransform = CV_BGR2GRAY;
-  } else if (!strcmp(sTransform, "CV_GRAY2BGR")) {
-    iTransform = CV_GRAY2BGR;
-  } else if (!strcmp(sTransform, "CV_BGR2XYZ")) {
-    iTransform = CV_BGR2XYZ;
-  } else if (!strcmp(sTransform, "CV_XYZ2BGR")) {
-    iTransform = CV_XYZ2BGR;
-  } else if (!strcmp(sTransform, "CV_BGR2YCrCb")) {
-    iTransform = CV_BGR2YCrCb;
-  } else if (!strcmp(sTransform, "CV_YCrCb2BGR")) {
-    iTransform = CV_YCrCb2BGR;
-  } else if (!strcmp(sTransform, "CV_BGR2HSV")) {
-    iTransform = CV_BGR2HSV;
-  } else if (!strcmp(sTransform, "CV_HSV2BGR")) {
-    iTransform = CV_HSV2BGR;
-  } else if (!strcmp(sTransform, "CV_BGR2HLS")) {
-    iTransform = CV_BGR2HLS;
-  } else if (!strcmp(sTransform, "CV_HLS2BGR")) {
-    iTransform = CV_HLS2BGR;
-  } else if (!strcmp(sTransform, "CV_BGR2Lab")) {
-    iTransform = CV_BGR2Lab;
-  } else if (!strcmp(sTransform, "CV_Lab2BGR")) {
-    iTransform = CV_Lab2BGR;
-  } else if (!strcmp(sTransform, "CV_BGR2Luv")) {
-    iTransform = CV_BGR2Luv;
-  } else if (!strcmp(sTransform, "CV_Luv2BGR")) {
-    iTransform = CV_Luv2BGR;
-  } else if (!strcmp(sTransform, "CV_BayerBG2BGR")) {
-    iTransform = CV_BayerBG2BGR;
-  } else if (!strcmp(sTransform, "CV_BayerGB2BGR")) {
-    iTransform = CV_BayerGB2BGR;
-  } else if (!strcmp(sTransform, "CV_BayerRG2BGR")) {
-    iTransform = CV_BayerRG2BGR;
-  } else if (!strcmp(sTransform, "CV_BayerGR2BGR")) {
-    iTransform = CV_BayerGR2BGR;
-  } else if (!strcmp(sTransform, "CV_BGR2RGB")) {
-    iTransform = CV_BGR2RGB;
-  } else {
-    iTransform = 0;  // to avoid compiler warning
-    Nan::ThrowTypeError("Conversion code is unsupported");
+  Nan::Utf8String str (Nan::To<String>(info[0]).ToLocalChecked());
+  int iTransform = ColorConversionCode(std::string(*str));
+  if (iTransform < 0) {
+    return Nan::ThrowTypeError("Conversion code is unsupported");
   }
 
-  cv::cvtColor(self->mat, self->mat, iTransform);
+  cv::Mat res;
+  cv::cvtColor(self->mat, res, iTransform);
+  self->mat = res;
+  self->SyncExternalMemory();
 
   return;
 }
@@ -2121,10 +2681,11 @@ NAN_METHOD(Matrix::Split) {
   v8::Local<v8::Array> arrChannels = Nan::New<Array>(size);
   for (unsigned int i = 0; i < size; i++) {
     Local<Object> matObject =
-        Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+        Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix * m = Nan::ObjectWrap::Unwrap<Matrix>(matObject);
     m->mat = channels[i];
-    arrChannels->Set(i, matObject);
+    m->SyncExternalMemory();
+    Nan::Set(arrChannels, i, matObject);
   }
 
   info.GetReturnValue().Set(arrChannels);
@@ -2144,10 +2705,13 @@ NAN_METHOD(Matrix::Merge) {
   unsigned int L = jsChannels->Length();
   std::vector<cv::Mat> vChannels(L);
   for (unsigned int i = 0; i < L; i++) {
-    Matrix * matObject = Nan::ObjectWrap::Unwrap<Matrix>(jsChannels->Get(i)->ToObject());
+    Matrix * matObject = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(Nan::Get(jsChannels, i).ToLocalChecked()).ToLocalChecked());
     vChannels[i] = matObject->mat;
   }
-  cv::merge(vChannels, self->mat);
+  cv::Mat res;
+  cv::merge(vChannels, res);
+  self->mat = res;
+  self->SyncExternalMemory();
 
   return;
 }
@@ -2159,7 +2723,10 @@ NAN_METHOD(Matrix::EqualizeHist) {
   Nan::HandleScope scope;
   Matrix * self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
 
-  cv::equalizeHist(self->mat, self->mat);
+  cv::Mat res;
+  cv::equalizeHist(self->mat, res);
+  self->mat = res;
+  self->SyncExternalMemory();
 
   return;
 }
@@ -2180,16 +2747,16 @@ NAN_METHOD(Matrix::FloodFill) {
     // error
   }
 
-  Local < Object > obj = info[0]->ToObject();
+  Local < Object > obj = Nan::To<Object>(info[0]).ToLocalChecked();
   cv::Rect rect;
 
   int ret = cv::floodFill(self->mat,
-      setPoint(obj->Get(Nan::New<String>("seedPoint").ToLocalChecked())->ToObject()),
-      setColor(obj->Get(Nan::New<String>("newColor").ToLocalChecked())->ToObject()),
-      obj->Get(Nan::New<String>("rect").ToLocalChecked())->IsUndefined() ?
-          0 : setRect(obj->Get(Nan::New<String>("rect").ToLocalChecked())->ToObject(), rect),
-      setColor(obj->Get(Nan::New<String>("loDiff").ToLocalChecked())->ToObject()),
-      setColor(obj->Get(Nan::New<String>("upDiff").ToLocalChecked())->ToObject()), 4);
+      setPoint(Nan::To<Object>(Nan::Get(obj, Nan::New<String>("seedPoint").ToLocalChecked()).ToLocalChecked()).ToLocalChecked()),
+      setColor(Nan::To<Object>(Nan::Get(obj, Nan::New<String>("newColor").ToLocalChecked()).ToLocalChecked()).ToLocalChecked()),
+      Nan::Get(obj, Nan::New<String>("rect").ToLocalChecked()).ToLocalChecked()->IsUndefined() ?
+          0 : setRect(Nan::To<Object>(Nan::Get(obj, Nan::New<String>("rect").ToLocalChecked()).ToLocalChecked()).ToLocalChecked(), rect),
+      setColor(Nan::To<Object>(Nan::Get(obj, Nan::New<String>("loDiff").ToLocalChecked()).ToLocalChecked()).ToLocalChecked()),
+      setColor(Nan::To<Object>(Nan::Get(obj, Nan::New<String>("upDiff").ToLocalChecked()).ToLocalChecked()).ToLocalChecked()), 4);
 
   info.GetReturnValue().Set(Nan::New<Number>(ret));
 }
@@ -2204,12 +2771,12 @@ NAN_METHOD(Matrix::TemplateMatches) {
       (info.Length() >= 1) ? info[0]->IsNumber() : false;
   bool filter_max_probability =
       (info.Length() >= 2) ? info[1]->IsNumber() : false;
-  double min_probability = filter_min_probability ? info[0]->NumberValue() : 0;
-  double max_probability = filter_max_probability ? info[1]->NumberValue() : 0;
-  int limit = (info.Length() >= 3) ? info[2]->IntegerValue() : 0;
-  bool ascending = (info.Length() >= 4) ? info[3]->BooleanValue() : false;
-  int min_x_distance = (info.Length() >= 5) ? info[4]->IntegerValue() : 0;
-  int min_y_distance = (info.Length() >= 6) ? info[5]->IntegerValue() : 0;
+  double min_probability = filter_min_probability ? Nan::To<double>(info[0]).FromJust() : 0;
+  double max_probability = filter_max_probability ? Nan::To<double>(info[1]).FromJust() : 0;
+  int limit = (info.Length() >= 3) ? Nan::To<int64_t>(info[2]).FromJust() : 0;
+  bool ascending = (info.Length() >= 4) ? Nan::To<bool>(info[3]).FromJust() : false;
+  int min_x_distance = (info.Length() >= 5) ? Nan::To<int64_t>(info[4]).FromJust() : 0;
+  int min_y_distance = (info.Length() >= 6) ? Nan::To<int64_t>(info[5]).FromJust() : 0;
 
   cv::Mat_<int> indices;
 
@@ -2281,11 +2848,11 @@ NAN_METHOD(Matrix::TemplateMatches) {
     Local<Value> probability_value = Nan::New<Number>(probability);
 
     Local < Object > probability_object = Nan::New<Object>();
-    probability_object->Set(Nan::New<String>("x").ToLocalChecked(), x_value);
-    probability_object->Set(Nan::New<String>("y").ToLocalChecked(), y_value);
-    probability_object->Set(Nan::New<String>("probability").ToLocalChecked(), probability_value);
+    Nan::Set(probability_object, Nan::New<String>("x").ToLocalChecked(), x_value);
+    Nan::Set(probability_object, Nan::New<String>("y").ToLocalChecked(), y_value);
+    Nan::Set(probability_object, Nan::New<String>("probability").ToLocalChecked(), probability_value);
 
-    probabilites_array->Set(index, probability_object);
+    Nan::Set(probabilites_array, index, probability_object);
     index++;
   }
 
@@ -2295,13 +2862,120 @@ NAN_METHOD(Matrix::TemplateMatches) {
 // @author Evilcat325
 // MatchTemplate accept a Matrix
 // Usage: output = input.matchTemplateByMatrix(matrix. method);
+class AsyncMatchTemplateWorker: public AsyncBaseWorker {
+public:
+  AsyncMatchTemplateWorker(Nan::Callback *callback, Local<Object> matrix,
+      std::string filename, int method, bool draw) :
+      AsyncBaseWorker(callback),
+      filename(filename),
+      method(method),
+      draw(draw) {
+    mat = PinMatrix("matrix", matrix);
+  }
+
+  void Execute() {
+    try {
+      cv::Mat templ = cv::imread(filename, -1);
+      if (templ.empty()) {
+        SetErrorMessage("Could not read the template image");
+        return;
+      }
+
+      cv::matchTemplate(mat, templ, res, method);
+      cv::normalize(res, res, 0, 1, cv::NORM_MINMAX, -1, cv::Mat());
+
+      double minVal;
+      double maxVal;
+      cv::Point minLoc;
+      cv::Point maxLoc;
+      cv::minMaxLoc(res, &minVal, &maxVal, &minLoc, &maxLoc, cv::Mat());
+
+      if (method == CV_TM_SQDIFF || method == CV_TM_SQDIFF_NORMED) {
+        roi = cv::Rect(minLoc.x, minLoc.y, templ.cols, templ.rows);
+      } else {
+        roi = cv::Rect(maxLoc.x, maxLoc.y, templ.cols, templ.rows);
+      }
+
+      res.convertTo(res, CV_8UC1, 255, 0);
+
+      if (draw) {
+        drawn = mat.clone();
+        cv::rectangle(drawn, roi, cv::Scalar(0, 0, 255));
+      }
+    } catch (cv::Exception& e) {
+      SetErrorMessage(e.what());
+    }
+  }
+
+  // [result, x, y, width, height], like matchTemplate, followed by a copy of
+  // the image with the match drawn on it when `draw` is set; the matrix
+  // itself is left untouched
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
+
+    Local<Object> out = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
+    Matrix *m_out = Nan::ObjectWrap::Unwrap<Matrix>(out);
+    m_out->mat = res;
+    m_out->SyncExternalMemory();
+
+    v8::Local <v8::Array> arr = Nan::New<v8::Array>(draw ? 6 : 5);
+    Nan::Set(arr, 0, out);
+    Nan::Set(arr, 1, Nan::New<Number>(roi.x));
+    Nan::Set(arr, 2, Nan::New<Number>(roi.y));
+    Nan::Set(arr, 3, Nan::New<Number>(roi.width));
+    Nan::Set(arr, 4, Nan::New<Number>(roi.height));
+
+    if (draw) {
+      Local<Object> image = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
+      Matrix *m_image = Nan::ObjectWrap::Unwrap<Matrix>(image);
+      m_image->mat = drawn;
+      m_image->SyncExternalMemory();
+      Nan::Set(arr, 5, image);
+    }
+
+    return scope.Escape(arr);
+  }
+
+private:
+  cv::Mat mat;
+  std::string filename;
+  int method;
+  bool draw;
+  cv::Mat res;
+  cv::Mat drawn;
+  cv::Rect roi;
+};
+
+// im.matchTemplateAsync(filename[, method[, draw]][, callback])
+NAN_METHOD(Matrix::MatchTemplateAsync) {
+  SETUP_FUNCTION(Matrix)
+
+  int argc = info.Length();
+  Nan::Callback *callback = NULL;
+  if (argc > 0 && info[argc - 1]->IsFunction()) {
+    callback = new Nan::Callback(info[argc - 1].As<Function>());
+    argc--;
+  }
+
+  if (argc < 1) {
+    delete callback;
+    return Nan::ThrowTypeError("matchTemplateAsync takes a template filename");
+  }
+
+  std::string filename(*Nan::Utf8String(info[0]));
+  int method = (argc < 2) ? (int)cv::TM_CCORR_NORMED : Nan::To<uint32_t>(info[1]).FromJust();
+
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(new AsyncMatchTemplateWorker(
+      callback, info.This(), filename, method, argc >= 3)));
+}
+
 NAN_METHOD(Matrix::MatchTemplateByMatrix) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  Matrix *templ = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *templ = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
 
-  Local<Object> out = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> out = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *m_out = Nan::ObjectWrap::Unwrap<Matrix>(out);
   int cols = self->mat.cols - templ->mat.cols + 1;
   int rows = self->mat.rows - templ->mat.rows + 1;
@@ -2316,9 +2990,10 @@ NAN_METHOD(Matrix::MatchTemplateByMatrix) {
    TM_CCOEFF_NORMED =5
    */
 
-  int method = (info.Length() < 2) ? (int)cv::TM_CCORR_NORMED : info[1]->Uint32Value();
+  int method = (info.Length() < 2) ? (int)cv::TM_CCORR_NORMED : Nan::To<uint32_t>(info[1]).FromJust();
   if (!(method >= 0 && method <= 5)) method = (int)cv::TM_CCORR_NORMED;
   cv::matchTemplate(self->mat, templ->mat, m_out->mat, method);
+  m_out->SyncExternalMemory();
   info.GetReturnValue().Set(out);
 }
 
@@ -2330,12 +3005,12 @@ NAN_METHOD(Matrix::MatchTemplate) {
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
 
-  v8::String::Utf8Value args0(info[0]->ToString());
+  Nan::Utf8String args0(Nan::To<String>(info[0]).ToLocalChecked());
   std::string filename = std::string(*args0);
   cv::Mat templ;
   templ = cv::imread(filename, -1);
 
-  Local<Object> out = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> out = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *m_out = Nan::ObjectWrap::Unwrap<Matrix>(out);
   int cols = self->mat.cols - templ.cols + 1;
   int rows = self->mat.rows - templ.rows + 1;
@@ -2350,9 +3025,10 @@ NAN_METHOD(Matrix::MatchTemplate) {
    TM_CCOEFF_NORMED =5
    */
 
-  int method = (info.Length() < 2) ? (int)cv::TM_CCORR_NORMED : info[1]->Uint32Value();
+  int method = (info.Length() < 2) ? (int)cv::TM_CCORR_NORMED : Nan::To<uint32_t>(info[1]).FromJust();
   cv::matchTemplate(self->mat, templ, m_out->mat, method);
   cv::normalize(m_out->mat, m_out->mat, 0, 1, cv::NORM_MINMAX, -1, cv::Mat());
+  m_out->SyncExternalMemory();
   double minVal;
   double maxVal;
   cv::Point minLoc;
@@ -2383,11 +3059,11 @@ NAN_METHOD(Matrix::MatchTemplate) {
   m_out->mat.convertTo(m_out->mat, CV_8UC1, 255, 0);
 
   v8::Local <v8::Array> arr = Nan::New<v8::Array>(5);
-  arr->Set(0, out);
-  arr->Set(1, Nan::New<Number>(roi_x));
-  arr->Set(2, Nan::New<Number>(roi_y));
-  arr->Set(3, Nan::New<Number>(roi_width));
-  arr->Set(4, Nan::New<Number>(roi_height));
+  Nan::Set(arr, 0, out);
+  Nan::Set(arr, 1, Nan::New<Number>(roi_x));
+  Nan::Set(arr, 2, Nan::New<Number>(roi_y));
+  Nan::Set(arr, 3, Nan::New<Number>(roi_width));
+  Nan::Set(arr, 4, Nan::New<Number>(roi_height));
 
   info.GetReturnValue().Set(arr);
 }
@@ -2409,19 +3085,19 @@ NAN_METHOD(Matrix::MinMaxLoc) {
   Local<Value> v_maxLoc_y = Nan::New<Number>(maxLoc.y);
 
   Local<Object> o_minLoc = Nan::New<Object>();
-  o_minLoc->Set(Nan::New<String>("x").ToLocalChecked(), v_minLoc_x);
-  o_minLoc->Set(Nan::New<String>("y").ToLocalChecked(), v_minLoc_y);
+  Nan::Set(o_minLoc, Nan::New<String>("x").ToLocalChecked(), v_minLoc_x);
+  Nan::Set(o_minLoc, Nan::New<String>("y").ToLocalChecked(), v_minLoc_y);
 
   Local<Object> o_maxLoc = Nan::New<Object>();
-  o_maxLoc->Set(Nan::New<String>("x").ToLocalChecked(), v_maxLoc_x);
-  o_maxLoc->Set(Nan::New<String>("y").ToLocalChecked(), v_maxLoc_y);
+  Nan::Set(o_maxLoc, Nan::New<String>("x").ToLocalChecked(), v_maxLoc_x);
+  Nan::Set(o_maxLoc, Nan::New<String>("y").ToLocalChecked(), v_maxLoc_y);
 
   // Output result object
   Local<Object> result = Nan::New<Object>();
-  result->Set(Nan::New<String>("minVal").ToLocalChecked(), v_minVal);
-  result->Set(Nan::New<String>("maxVal").ToLocalChecked(), v_maxVal);
-  result->Set(Nan::New<String>("minLoc").ToLocalChecked(), o_minLoc);
-  result->Set(Nan::New<String>("maxLoc").ToLocalChecked(), o_maxLoc);
+  Nan::Set(result, Nan::New<String>("minVal").ToLocalChecked(), v_minVal);
+  Nan::Set(result, Nan::New<String>("maxVal").ToLocalChecked(), v_maxVal);
+  Nan::Set(result, Nan::New<String>("minLoc").ToLocalChecked(), o_minLoc);
+  Nan::Set(result, Nan::New<String>("maxLoc").ToLocalChecked(), o_maxLoc);
 
   info.GetReturnValue().Set(result);
 }
@@ -2432,8 +3108,9 @@ NAN_METHOD(Matrix::PushBack) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  Matrix *m_input = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *m_input = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
   self->mat.push_back(m_input->mat);
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(info.This());
 }
@@ -2446,8 +3123,8 @@ NAN_METHOD(Matrix::PutText) {
   char *text = *textString;//(char *) malloc(textString.length() + 1);
   //strcpy(text, *textString);
 
-  int x = info[1]->IntegerValue();
-  int y = info[2]->IntegerValue();
+  int x = Nan::To<int64_t>(info[1]).FromJust();
+  int y = Nan::To<int64_t>(info[2]).FromJust();
 
   Nan::Utf8String fontString(info[3]);
   char *font = *fontString;//(char *) malloc(fontString.length() + 1);
@@ -2467,12 +3144,12 @@ NAN_METHOD(Matrix::PutText) {
   cv::Scalar color(0, 0, 255);
 
   if (info[4]->IsArray()) {
-    Local<Object> objColor = info[4]->ToObject();
+    Local<Object> objColor = Nan::To<Object>(info[4]).ToLocalChecked();
     color = setColor(objColor);
   }
 
-  double scale = info.Length() < 6 ? 1 : info[5]->NumberValue();
-  double thickness = info.Length() < 7 ? 1 : info[6]->NumberValue();
+  double scale = info.Length() < 6 ? 1 : Nan::To<double>(info[5]).FromJust();
+  double thickness = info.Length() < 7 ? 1 : Nan::To<double>(info[6]).FromJust();
 
   cv::putText(self->mat, text, cv::Point(x, y), constFont, scale, color, thickness);
 
@@ -2483,19 +3160,20 @@ NAN_METHOD(Matrix::GetPerspectiveTransform) {
   Nan::HandleScope scope;
 
   // extract quad info
-  Local<Object> srcArray = info[0]->ToObject();
-  Local<Object> tgtArray = info[1]->ToObject();
+  Local<Object> srcArray = Nan::To<Object>(info[0]).ToLocalChecked();
+  Local<Object> tgtArray = Nan::To<Object>(info[1]).ToLocalChecked();
 
   std::vector<cv::Point2f> src_corners(4);
   std::vector<cv::Point2f> tgt_corners(4);
   for (unsigned int i = 0; i < 4; i++) {
-    src_corners[i] = cvPoint(srcArray->Get(i*2)->IntegerValue(),srcArray->Get(i*2+1)->IntegerValue());
-    tgt_corners[i] = cvPoint(tgtArray->Get(i*2)->IntegerValue(),tgtArray->Get(i*2+1)->IntegerValue());
+    src_corners[i] = cvPoint(Nan::To<int64_t>(Nan::Get(srcArray, i*2).ToLocalChecked()).FromJust(),Nan::To<int64_t>(Nan::Get(srcArray, i*2+1).ToLocalChecked()).FromJust());
+    tgt_corners[i] = cvPoint(Nan::To<int64_t>(Nan::Get(tgtArray, i*2).ToLocalChecked()).FromJust(),Nan::To<int64_t>(Nan::Get(tgtArray, i*2+1).ToLocalChecked()).FromJust());
   }
 
-  Local<Object> xfrm = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> xfrm = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *xfrmmat = Nan::ObjectWrap::Unwrap<Matrix>(xfrm);
   xfrmmat->mat = cv::getPerspectiveTransform(src_corners, tgt_corners);
+  xfrmmat->SyncExternalMemory();
 
   info.GetReturnValue().Set(xfrm);
 }
@@ -2503,10 +3181,10 @@ NAN_METHOD(Matrix::GetPerspectiveTransform) {
 NAN_METHOD(Matrix::WarpPerspective) {
   SETUP_FUNCTION(Matrix)
 
-  Matrix *xfrm = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *xfrm = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
 
-  int width = info[1]->IntegerValue();
-  int height = info[2]->IntegerValue();
+  int width = Nan::To<int64_t>(info[1]).FromJust();
+  int height = Nan::To<int64_t>(info[2]).FromJust();
 
   int flags = cv::INTER_LINEAR;
   int borderMode = cv::BORDER_REPLICATE;
@@ -2514,7 +3192,7 @@ NAN_METHOD(Matrix::WarpPerspective) {
   cv::Scalar borderColor(0, 0, 255);
 
   if (info[3]->IsArray()) {
-    Local < Object > objColor = info[3]->ToObject();
+    Local < Object > objColor = Nan::To<Object>(info[3]).ToLocalChecked();
     borderColor = setColor(objColor);
   }
 
@@ -2525,6 +3203,7 @@ NAN_METHOD(Matrix::WarpPerspective) {
 
   ~self->mat;
   self->mat = res;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -2533,11 +3212,12 @@ NAN_METHOD(Matrix::CopyWithMask) {
   SETUP_FUNCTION(Matrix)
 
   // param 0 - destination image:
-  Matrix *dest = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *dest = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
   // param 1 - mask. same size as src and dest
-  Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+  Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
 
   self->mat.copyTo(dest->mat, mask->mat);
+  dest->SyncExternalMemory();
 
   return;
 }
@@ -2546,14 +3226,14 @@ NAN_METHOD(Matrix::SetWithMask) {
   SETUP_FUNCTION(Matrix)
 
   // param 0 - target value:
-  Local < Object > valArray = info[0]->ToObject();
+  Local < Object > valArray = Nan::To<Object>(info[0]).ToLocalChecked();
   cv::Scalar newvals;
-  newvals.val[0] = valArray->Get(0)->NumberValue();
-  newvals.val[1] = valArray->Get(1)->NumberValue();
-  newvals.val[2] = valArray->Get(2)->NumberValue();
+  newvals.val[0] = Nan::To<double>(Nan::Get(valArray, 0).ToLocalChecked()).FromJust();
+  newvals.val[1] = Nan::To<double>(Nan::Get(valArray, 1).ToLocalChecked()).FromJust();
+  newvals.val[2] = Nan::To<double>(Nan::Get(valArray, 2).ToLocalChecked()).FromJust();
 
   // param 1 - mask. same size as src and dest
-  Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+  Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
 
   self->mat.setTo(newvals, mask->mat);
 
@@ -2564,14 +3244,14 @@ NAN_METHOD(Matrix::MeanWithMask) {
   SETUP_FUNCTION(Matrix)
 
   // param 0 - mask. same size as src and dest
-  Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *mask = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
 
   cv::Scalar means = cv::mean(self->mat, mask->mat);
   v8::Local < v8::Array > arr = Nan::New<Array>(4);
-  arr->Set(0, Nan::New<Number>(means[0]));
-  arr->Set(1, Nan::New<Number>(means[1]));
-  arr->Set(2, Nan::New<Number>(means[2]));
-  arr->Set(3, Nan::New<Number>(means[3]));
+  Nan::Set(arr, 0, Nan::New<Number>(means[0]));
+  Nan::Set(arr, 1, Nan::New<Number>(means[1]));
+  Nan::Set(arr, 2, Nan::New<Number>(means[2]));
+  Nan::Set(arr, 3, Nan::New<Number>(means[3]));
 
   info.GetReturnValue().Set(arr);
 }
@@ -2581,10 +3261,10 @@ NAN_METHOD(Matrix::Mean) {
 
   cv::Scalar means = cv::mean(self->mat);
   v8::Local<v8::Array> arr = Nan::New<Array>(4);
-  arr->Set(0, Nan::New<Number>(means[0]));
-  arr->Set(1, Nan::New<Number>(means[1]));
-  arr->Set(2, Nan::New<Number>(means[2]));
-  arr->Set(3, Nan::New<Number>(means[3]));
+  Nan::Set(arr, 0, Nan::New<Number>(means[0]));
+  Nan::Set(arr, 1, Nan::New<Number>(means[1]));
+  Nan::Set(arr, 2, Nan::New<Number>(means[2]));
+  Nan::Set(arr, 3, Nan::New<Number>(means[3]));
 
   info.GetReturnValue().Set(arr);
 }
@@ -2594,8 +3274,8 @@ NAN_METHOD(Matrix::Shift) {
 
   cv::Mat res;
 
-  double tx = info[0]->NumberValue();
-  double ty = info[1]->NumberValue();
+  double tx = Nan::To<double>(info[0]).FromJust();
+  double ty = Nan::To<double>(info[1]).FromJust();
 
   // get the integer values of info
   cv::Point2i deltai(ceil(tx), ceil(ty));
@@ -2627,6 +3307,7 @@ NAN_METHOD(Matrix::Shift) {
   res = padded(roi);
   ~self->mat;
   self->mat = res;
+  self->SyncExternalMemory();
 
   return;
 }
@@ -2651,10 +3332,12 @@ NAN_METHOD(Matrix::Reshape) {
   }
 
   Local<Object> img_to_return =
-      Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+      Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(img_to_return);
 
   img->mat = self->mat.reshape(cn, rows);
+  img->SyncExternalMemory();
+  self->ShareBacking(img);
 
   info.GetReturnValue().Set(img_to_return);
 }
@@ -2664,6 +3347,8 @@ NAN_METHOD(Matrix::Release) {
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
   self->mat.release();
+  self->backing.Reset();
+  self->SyncExternalMemory();
 
   return;
 }
@@ -2675,9 +3360,79 @@ NAN_METHOD(Matrix::Subtract) {
     Nan::ThrowTypeError("Invalid number of arguments");
   }
 
-  Matrix *other = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+  Matrix *other = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
 
   self->mat -= other->mat;
 
   return;
 }
+
+// Runs one MatOp over a snapshot of a matrix on a worker. The worker holds
+// the matrix until it is done; in-place ops then swap the result in.
+class AsyncMatOpWorker: public AsyncBaseWorker {
+public:
+  AsyncMatOpWorker(Nan::Callback *callback, Local<Object> matrix, MatOp *op) :
+      AsyncBaseWorker(callback),
+      op(op) {
+    mat = PinMatrix("matrix", matrix);
+  }
+
+  ~AsyncMatOpWorker() {
+    delete op;
+  }
+
+  void Execute() {
+    try {
+      op->Apply(mat, res);
+    } catch (cv::Exception& e) {
+      SetErrorMessage(e.what());
+    }
+  }
+
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
+
+    Local<Object> img_to_return = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
+    Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(img_to_return);
+    img->mat = res;
+    img->SyncExternalMemory();
+
+    return scope.Escape(img_to_return);
+  }
+
+private:
+  cv::Mat mat;
+  MatOp *op;
+  cv::Mat res;
+};
+
+// im.<op>Async(...args[, callback]) takes the same arguments as im.<op>(...)
+// and runs it on a worker. It resolves with a new Matrix, even for ops whose
+// sync form changes the matrix in place, and leaves the matrix untouched.
+NAN_METHOD(Matrix::OpAsync) {
+  SETUP_FUNCTION(Matrix)
+
+  std::string name(*Nan::Utf8String(info.Data()));
+
+  int argc = info.Length();
+  Nan::Callback *callback = NULL;
+  if (argc > 0 && info[argc - 1]->IsFunction()) {
+    callback = new Nan::Callback(info[argc - 1].As<Function>());
+    argc--;
+  }
+
+  Local<Array> args = Nan::New<Array>(argc);
+  for (int i = 0; i < argc; i++) {
+    Nan::Set(args, i, info[i]);
+  }
+
+  std::string error;
+  MatOp *op = MatOp::Create(name, args, error);
+  if (!op) {
+    delete callback;
+    return Nan::ThrowError(error.c_str());
+  }
+
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(
+      new AsyncMatOpWorker(callback, info.This(), op)));
+}
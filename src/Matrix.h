@@ -5,6 +5,13 @@
 class Matrix: public node_opencv::Matrix{
 public:
   static Nan::Persistent<FunctionTemplate> constructor;
+  // The JS Buffer that `mat`'s data lives in, kept alive while `mat` points
+  // into it: the one Matrix.fromBuffer({copy: false}) was given, or the one
+  // getData({copy: false}) and rowData() first wrapped OpenCV's data in.
+  // Later views are made on the same Buffer, since V8 may abort on a second
+  // external Buffer over the same memory. SyncExternalMemory drops it once
+  // `mat` no longer points into it.
+  Nan::Persistent<Object> backing;
   static void Init(Local<Object> target);
   static NAN_METHOD(New);
   Matrix();
@@ -12,12 +19,35 @@ public:
   Matrix(int rows, int cols);
   Matrix(int rows, int cols, int type);
   Matrix(int rows, int cols, int type, Local<Object> scalarObj);
+  ~Matrix();
 
-  static double DblGet(cv::Mat mat, int i, int j);
+  // Reports the allocation behind `mat` to V8 through
+  // Nan::AdjustExternalMemory, so GC pacing follows the native footprint.
+  // Data shared between matrices (crops, assignments) is counted once.
+  // Call after anything that may assign or reallocate `mat`.
+  void SyncExternalMemory();
+
+  static double DblGet(const cv::Mat &mat, int i, int j);
+
+  // Gives `view`, whose mat shares this matrix's data (a crop, roi or
+  // reshape), the same hold on `backing`
+  void ShareBacking(Matrix *view);
+
+  // Wraps `length` bytes at `data` (which must live inside `mat`'s
+  // allocation) in a Buffer without copying. The Buffer holds a reference on
+  // `mat`, and on `backing` if set, until V8 collects it.
+  static Local<Object> NewExternalBuffer(const cv::Mat &mat, uchar *data,
+      size_t length, const Nan::Persistent<Object> &backing);
+
+  // The ArrayBuffer behind `backing`, and the offset of `data` (which must
+  // lie in `mat`'s data) in it. When `backing` doesn't hold `mat`'s data,
+  // wraps the whole allocation in an external Buffer and keeps it there.
+  Local<ArrayBuffer> BackingArrayBuffer(const uchar *data, size_t *offset);
 
   JSFUNC(Zeros)  // factory
   JSFUNC(Ones)  // factory
   JSFUNC(Eye)  // factory
+  JSFUNC(FromBuffer)  // factory
 
   JSFUNC(Get)  // at
   JSFUNC(Set)
@@ -32,11 +62,26 @@ public:
   JSFUNC(PixelRow)
   JSFUNC(Col)
   JSFUNC(PixelCol)
+  JSFUNC(GetRegion)
+  JSFUNC(SetRegion)
+  JSFUNC(RowData)
+  JSFUNC(ColData)
 
   JSFUNC(Size)
   JSFUNC(Width)
   JSFUNC(Height)
   JSFUNC(Channels)
+  JSFUNC(Describe)
+
+  // Read-only header fields, as accessors on every instance
+  static NAN_GETTER(GetRows);
+  static NAN_GETTER(GetCols);
+  static NAN_GETTER(GetType);
+  static NAN_GETTER(GetDepth);
+  static NAN_GETTER(GetStep);
+  static NAN_GETTER(GetIsContinuous);
+  static NAN_GETTER(GetTotal);
+  static NAN_GETTER(GetElemSize);
   JSFUNC(Clone)
   JSFUNC(Ellipse)
   JSFUNC(Rectangle)
@@ -111,6 +156,10 @@ public:
 
   JSFUNC(MatchTemplate)
   JSFUNC(MatchTemplateByMatrix)
+  JSFUNC(MatchTemplateAsync)
+
+  // Backs the <op>Async methods, with the op name as the function's data
+  JSFUNC(OpAsync)
   JSFUNC(TemplateMatches)
   JSFUNC(MinMaxLoc)
 
@@ -130,6 +179,11 @@ public:
   JSFUNC(Release)
 
   JSFUNC(Subtract)
+
+private:
+  // Allocation this matrix holds a share of in the reported total, if any.
+  const void *allocation;
+  void ReleaseAllocation();
   /*
    static Handle<Value> Val(const Arguments& info);
    static Handle<Value> RowRange(const Arguments& info);
@@ -0,0 +1,281 @@
+#include "MatrixPool.h"
+#include "Matrix.h"
+#include "OpenCV.h"
+#include "OpStats.h"
+#include <nan.h>
+
+// Byte size of one buffer for a rows x cols matrix of the given type, in the
+// layout the allocate() below produces.
+static size_t PooledBufferSize(int rows, int cols, int type) {
+  size_t total = (size_t) rows * cols * CV_ELEM_SIZE(type);
+#if CV_MAJOR_VERSION >= 3
+  return total;
+#else
+  // OpenCV 2.x keeps the refcount in the allocation, right after the data
+  return cv::alignSize(total, (int) sizeof(int)) + sizeof(int);
+#endif
+}
+
+PooledAllocator::PooledAllocator(int rows, int cols, int type,
+    unsigned int capacity) :
+    bufferSize(PooledBufferSize(rows, cols, type)),
+    capacity(capacity),
+    refs(1),
+    hits(0),
+    misses(0) {
+  uv_mutex_init(&mutex);
+
+  // Allocate and touch the whole pool up front so that the first frames
+  // don't pay for the page faults either.
+  for (unsigned int i = 0; i < capacity; i++) {
+    uchar *buffer = (uchar*) cv::fastMalloc(bufferSize);
+    memset(buffer, 0, bufferSize);
+    available.push_back(buffer);
+  }
+}
+
+void PooledAllocator::Retire() const {
+  std::vector<uchar*> buffers;
+
+  uv_mutex_lock(&mutex);
+  buffers.swap(available);
+  capacity = 0;
+  uv_mutex_unlock(&mutex);
+
+  for (size_t i = 0; i < buffers.size(); i++) {
+    cv::fastFree(buffers[i]);
+  }
+}
+
+void PooledAllocator::Ref() const {
+  uv_mutex_lock(&mutex);
+  refs++;
+  uv_mutex_unlock(&mutex);
+}
+
+void PooledAllocator::Unref() const {
+  uv_mutex_lock(&mutex);
+  bool last = --refs == 0;
+  uv_mutex_unlock(&mutex);
+
+  if (last) {
+    Retire();
+  }
+}
+
+unsigned int PooledAllocator::Available() const {
+  uv_mutex_lock(&mutex);
+  unsigned int count = available.size();
+  uv_mutex_unlock(&mutex);
+  return count;
+}
+
+unsigned int PooledAllocator::Hits() const {
+  uv_mutex_lock(&mutex);
+  unsigned int count = hits;
+  uv_mutex_unlock(&mutex);
+  return count;
+}
+
+unsigned int PooledAllocator::Misses() const {
+  uv_mutex_lock(&mutex);
+  unsigned int count = misses;
+  uv_mutex_unlock(&mutex);
+  return count;
+}
+
+uchar* PooledAllocator::Acquire(size_t size) const {
+  uchar *buffer = NULL;
+
+  uv_mutex_lock(&mutex);
+  refs++;
+  if (size == bufferSize) {
+    if (!available.empty()) {
+      buffer = available.back();
+      available.pop_back();
+      hits++;
+    } else {
+      misses++;
+    }
+  }
+  uv_mutex_unlock(&mutex);
+
+  if (buffer == NULL) {
+    buffer = (uchar*) cv::fastMalloc(size);
+  }
+  return buffer;
+}
+
+void PooledAllocator::Recycle(uchar* buffer, size_t size) const {
+  uv_mutex_lock(&mutex);
+  bool keep = size == bufferSize && available.size() < capacity;
+  if (keep) {
+    available.push_back(buffer);
+  }
+  uv_mutex_unlock(&mutex);
+
+  if (!keep) {
+    cv::fastFree(buffer);
+  }
+  Unref();
+}
+
+#if CV_MAJOR_VERSION >= 3
+
+// Mirrors cv::StdMatAllocator, with the buffers coming from the pool.
+cv::UMatData* PooledAllocator::allocate(int dims, const int* sizes, int type,
+    void* data0, size_t* step, int /*flags*/,
+    cv::UMatUsageFlags /*usageFlags*/) const {
+  size_t total = CV_ELEM_SIZE(type);
+  for (int i = dims - 1; i >= 0; i--) {
+    if (step) {
+      if (data0 && step[i] != CV_AUTOSTEP) {
+        CV_Assert(total <= step[i]);
+        total = step[i];
+      } else {
+        step[i] = total;
+      }
+    }
+    total *= sizes[i];
+  }
+
+  uchar* data = data0 ? (uchar*) data0 : Acquire(total);
+  cv::UMatData* u = new cv::UMatData(this);
+  u->data = u->origdata = data;
+  u->size = total;
+  if (data0) {
+    u->flags |= cv::UMatData::USER_ALLOCATED;
+  }
+
+  return u;
+}
+
+bool PooledAllocator::allocate(cv::UMatData* u, int /*accessFlags*/,
+    cv::UMatUsageFlags /*usageFlags*/) const {
+  return u != NULL;
+}
+
+void PooledAllocator::deallocate(cv::UMatData* u) const {
+  if (!u) {
+    return;
+  }
+
+  CV_Assert(u->urefcount == 0);
+  CV_Assert(u->refcount == 0);
+  if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+    Recycle(u->origdata, u->size);
+    u->origdata = 0;
+  }
+  delete u;
+}
+
+#else
+
+void PooledAllocator::allocate(int dims, const int* sizes, int type,
+    int*& refcount, uchar*& datastart, uchar*& data, size_t* step) {
+  size_t total = CV_ELEM_SIZE(type);
+  for (int i = dims - 1; i >= 0; i--) {
+    step[i] = total;
+    total *= sizes[i];
+  }
+  total = cv::alignSize(total, (int) sizeof(*refcount));
+
+  datastart = data = Acquire(total + sizeof(*refcount));
+  refcount = (int*) (data + total);
+  *refcount = 1;
+}
+
+void PooledAllocator::deallocate(int* refcount, uchar* datastart,
+    uchar* /*data*/) {
+  Recycle(datastart, ((uchar*) refcount - datastart) + sizeof(*refcount));
+}
+
+#endif
+
+Nan::Persistent<FunctionTemplate> MatrixPool::constructor;
+
+void MatrixPool::Init(Local<Object> target) {
+  Nan::HandleScope scope;
+
+  // Constructor
+  Local<FunctionTemplate> ctor = Nan::New<FunctionTemplate>(MatrixPool::New);
+  constructor.Reset(ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("MatrixPool").ToLocalChecked());
+
+  OpStats::SetPrototypeMethod(ctor, "MatrixPool.allocate", Allocate);
+  OpStats::SetPrototypeMethod(ctor, "MatrixPool.stats", Stats);
+
+  Nan::Set(target, Nan::New("MatrixPool").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
+}
+
+// new cv.MatrixPool({rows: 1080, cols: 1920, type: cv.Constants.CV_8UC3, capacity: 8})
+NAN_METHOD(MatrixPool::New) {
+  Nan::HandleScope scope;
+
+  if (info.This()->InternalFieldCount() == 0) {
+    return Nan::ThrowTypeError("Cannot Instantiate without new");
+  }
+
+  if (info.Length() < 1 || !info[0]->IsObject()) {
+    return Nan::ThrowTypeError("MatrixPool takes an options object");
+  }
+
+  Local<Object> options = Nan::To<Object>(info[0]).ToLocalChecked();
+  int rows = Nan::To<int64_t>(Nan::Get(options, Nan::New("rows").ToLocalChecked()).ToLocalChecked()).FromJust();
+  int cols = Nan::To<int64_t>(Nan::Get(options, Nan::New("cols").ToLocalChecked()).ToLocalChecked()).FromJust();
+  int type = CV_8UC3;
+  if (Nan::Has(options, Nan::New("type").ToLocalChecked()).FromJust()) {
+    type = Nan::To<int64_t>(Nan::Get(options, Nan::New("type").ToLocalChecked()).ToLocalChecked()).FromJust();
+  }
+  int capacity = 4;
+  if (Nan::Has(options, Nan::New("capacity").ToLocalChecked()).FromJust()) {
+    capacity = Nan::To<int64_t>(Nan::Get(options, Nan::New("capacity").ToLocalChecked()).ToLocalChecked()).FromJust();
+  }
+
+  if (rows <= 0 || cols <= 0 || capacity < 0) {
+    return Nan::ThrowRangeError("rows and cols must be positive, capacity must not be negative");
+  }
+
+  MatrixPool *pool = new MatrixPool(rows, cols, type, capacity);
+  pool->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+MatrixPool::MatrixPool(int rows, int cols, int type, unsigned int capacity) :
+    Nan::ObjectWrap(),
+    allocator(new PooledAllocator(rows, cols, type, capacity)),
+    rows(rows),
+    cols(cols),
+    type(type) {
+}
+
+MatrixPool::~MatrixPool() {
+  allocator->Unref();
+}
+
+// Returns a Matrix of the pool's size and type backed by a pooled buffer. The
+// buffer goes back to the pool once the matrix is released or collected.
+NAN_METHOD(MatrixPool::Allocate) {
+  SETUP_FUNCTION(MatrixPool)
+
+  Local<Object> im_h = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
+  Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im_h);
+  img->mat.allocator = self->allocator;
+  img->mat.create(self->rows, self->cols, self->type);
+  img->SyncExternalMemory();
+
+  info.GetReturnValue().Set(im_h);
+}
+
+NAN_METHOD(MatrixPool::Stats) {
+  SETUP_FUNCTION(MatrixPool)
+
+  Local<Object> res = Nan::New<Object>();
+  Nan::Set(res, Nan::New("capacity").ToLocalChecked(), Nan::New<Number>(self->allocator->Capacity()));
+  Nan::Set(res, Nan::New("available").ToLocalChecked(), Nan::New<Number>(self->allocator->Available()));
+  Nan::Set(res, Nan::New("hits").ToLocalChecked(), Nan::New<Number>(self->allocator->Hits()));
+  Nan::Set(res, Nan::New("misses").ToLocalChecked(), Nan::New<Number>(self->allocator->Misses()));
+
+  info.GetReturnValue().Set(res);
+}
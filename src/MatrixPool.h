@@ -0,0 +1,71 @@
+#include "OpenCV.h"
+
+#include <vector>
+
+// A cv::MatAllocator that recycles buffers of one fixed size. Allocations of
+// any other size fall through to plain cv::fastMalloc.
+//
+// The pool is shared between its JS wrapper and every buffer it has handed
+// out, so its buffers are kept until the last pooled cv::Mat is released.
+// The allocator itself is never freed: a cv::Mat keeps its `allocator` after
+// releasing its data and uses it again on the next create(), so it falls back
+// to plain allocations instead. Buffers can be returned from worker threads,
+// hence the mutex.
+class PooledAllocator: public cv::MatAllocator {
+public:
+  PooledAllocator(int rows, int cols, int type, unsigned int capacity);
+
+  void Ref() const;
+  void Unref() const;
+
+  unsigned int Capacity() const { return capacity; }
+  unsigned int Available() const;
+  unsigned int Hits() const;
+  unsigned int Misses() const;
+
+#if CV_MAJOR_VERSION >= 3
+  cv::UMatData* allocate(int dims, const int* sizes, int type, void* data,
+      size_t* step, int flags, cv::UMatUsageFlags usageFlags) const;
+  bool allocate(cv::UMatData* data, int accessflags,
+      cv::UMatUsageFlags usageFlags) const;
+  void deallocate(cv::UMatData* data) const;
+#else
+  void allocate(int dims, const int* sizes, int type, int*& refcount,
+      uchar*& datastart, uchar*& data, size_t* step);
+  void deallocate(int* refcount, uchar* datastart, uchar* data);
+#endif
+
+private:
+  // Frees the pooled buffers once nothing refers to the pool
+  void Retire() const;
+
+  uchar* Acquire(size_t size) const;
+  void Recycle(uchar* buffer, size_t size) const;
+
+  size_t bufferSize;
+  mutable unsigned int capacity;
+
+  mutable uv_mutex_t mutex;
+  mutable std::vector<uchar*> available;
+  mutable unsigned int refs;
+  mutable unsigned int hits;
+  mutable unsigned int misses;
+};
+
+class MatrixPool: public Nan::ObjectWrap {
+public:
+  PooledAllocator *allocator;
+  int rows;
+  int cols;
+  int type;
+
+  static Nan::Persistent<FunctionTemplate> constructor;
+  static void Init(Local<Object> target);
+  static NAN_METHOD(New);
+
+  MatrixPool(int rows, int cols, int type, unsigned int capacity);
+  ~MatrixPool();
+
+  JSFUNC(Allocate)
+  JSFUNC(Stats)
+};
@@ -0,0 +1,262 @@
+#include "OpStats.h"
+#include "OpTrace.h"
+#include "OpenCV.h"
+#include <nan.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool OpStats::enabled = false;
+OpCounter *OpStats::current = NULL;
+std::map<std::string, OpCounter*> OpStats::counters;
+uv_mutex_t OpStats::mutex;
+
+static int HighestBit(uint64_t value) {
+  int bit = 0;
+  for (int shift = 32; shift > 0; shift /= 2) {
+    if (value >> shift) {
+      value >>= shift;
+      bit += shift;
+    }
+  }
+  return bit;
+}
+
+OpTiming::OpTiming() {
+  Reset();
+}
+
+void OpTiming::Reset() {
+  count = 0;
+  total = 0;
+  memset(buckets, 0, sizeof(buckets));
+}
+
+void OpTiming::Add(uint64_t ns) {
+  int bucket;
+  if (ns < 4) {
+    bucket = (int) ns;
+  } else {
+    // The highest bit picks the power of two, the next two bits the quarter
+    int bit = HighestBit(ns);
+    bucket = bit * 4 + (int) ((ns >> (bit - 2)) & 3);
+  }
+
+  count++;
+  total += ns;
+  buckets[bucket]++;
+}
+
+uint64_t OpTiming::Percentile(double p) const {
+  if (count == 0) {
+    return 0;
+  }
+
+  uint64_t rank = (uint64_t) (p * (count - 1)) + 1;
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < kBuckets; bucket++) {
+    seen += buckets[bucket];
+    if (seen >= rank) {
+      if (bucket < 4) {
+        return bucket;
+      }
+      int bit = bucket / 4;
+      return ((uint64_t) (4 + bucket % 4 + 1) << (bit - 2)) - 1;
+    }
+  }
+  return total;
+}
+
+void OpStats::Init(Local<Object> target) {
+  Nan::HandleScope scope;
+
+  static bool initialized = false;
+  if (!initialized) {
+    uv_mutex_init(&mutex);
+    const char *env = getenv("NODE_OPENCV_STATS");
+    enabled = env != NULL && strcmp(env, "") != 0 && strcmp(env, "0") != 0;
+    initialized = true;
+  }
+
+  // Not instrumented themselves
+  Nan::SetMethod(target, "stats", GetStats);
+  Nan::SetMethod(target, "resetStats", ResetStats);
+  Nan::SetMethod(target, "enableStats", EnableStats);
+}
+
+OpCounter* OpStats::Counter(const std::string &key) {
+  std::map<std::string, OpCounter*>::iterator it = counters.find(key);
+  if (it != counters.end()) {
+    return it->second;
+  }
+
+  OpCounter *counter = new OpCounter();
+  counter->name = key;
+  counter->bytes = 0;
+  counters[key] = counter;
+  return counter;
+}
+
+// Lives as long as the function it backs, i.e. the process
+struct OpMethod {
+  Nan::FunctionCallback callback;
+  OpCounter *counter;
+  // Empty for the many methods registered without data
+  Nan::Persistent<Value> data;
+};
+
+void OpStats::Call(const v8::FunctionCallbackInfo<v8::Value> &args) {
+  OpMethod *method = static_cast<OpMethod*>(args.Data().As<External>()->Value());
+  // Undefined is a root, so methods without data don't take a new handle
+  Nan::FunctionCallbackInfo<Value> info(args, method->data.IsEmpty()
+      ? Local<Value>(Nan::Undefined()) : Nan::New(method->data));
+
+  if (!enabled && !OpTrace::Enabled()) {
+    method->callback(info);
+    return;
+  }
+
+  OpCounter *previous = SetCurrent(method->counter);
+  uint64_t start = uv_hrtime();
+  method->callback(info);
+  if (enabled) {
+    method->counter->calls.Add(uv_hrtime() - start);
+  }
+  SetCurrent(previous);
+}
+
+Local<FunctionTemplate> OpStats::Trampoline(const char *key,
+    Nan::FunctionCallback callback, Local<Value> data,
+    Local<Signature> signature) {
+  Nan::EscapableHandleScope scope;
+
+  OpMethod *method = new OpMethod();
+  method->callback = callback;
+  method->counter = Counter(key);
+  if (!data.IsEmpty()) {
+    method->data.Reset(data);
+  }
+
+  Local<FunctionTemplate> tpl = FunctionTemplate::New(v8::Isolate::GetCurrent(),
+      Call, Nan::New<External>(method), signature);
+
+  const char *name = strrchr(key, '.');
+  tpl->SetClassName(Nan::New(name ? name + 1 : key).ToLocalChecked());
+
+  return scope.Escape(tpl);
+}
+
+void OpStats::SetPrototypeMethod(Local<FunctionTemplate> tpl, const char *key,
+    Nan::FunctionCallback callback, Local<Value> data) {
+  Nan::HandleScope scope;
+
+  const char *name = strrchr(key, '.');
+  Nan::SetPrototypeTemplate(tpl, name ? name + 1 : key,
+      Trampoline(key, callback, data, Nan::New<Signature>(tpl)));
+}
+
+void OpStats::SetMethod(Local<FunctionTemplate> tpl, const char *key,
+    Nan::FunctionCallback callback) {
+  Nan::HandleScope scope;
+
+  const char *name = strrchr(key, '.');
+  Nan::SetTemplate(tpl, name ? name + 1 : key,
+      Trampoline(key, callback, Local<Value>(), Local<Signature>()));
+}
+
+void OpStats::SetMethod(Local<Object> target, const char *key,
+    Nan::FunctionCallback callback) {
+  Nan::HandleScope scope;
+
+  const char *name = strrchr(key, '.');
+  Nan::Set(target, Nan::New(name ? name + 1 : key).ToLocalChecked(),
+      Nan::GetFunction(Trampoline(key, callback, Local<Value>(),
+          Local<Signature>())).ToLocalChecked());
+}
+
+OpCounter* OpStats::SetCurrent(OpCounter *counter) {
+  OpCounter *previous = current;
+  current = counter;
+  return previous;
+}
+
+void OpStats::AddBytes(size_t bytes) {
+  if (enabled && current) {
+    current->bytes += bytes;
+  }
+}
+
+void OpStats::RecordRun(OpCounter *counter, uint64_t queuedNs, uint64_t runNs) {
+  if (!enabled) {
+    return;
+  }
+
+  uv_mutex_lock(&mutex);
+  counter->queued.Add(queuedNs);
+  counter->runs.Add(runNs);
+  uv_mutex_unlock(&mutex);
+}
+
+static void SetTiming(Local<Object> res, const char *prefix, const OpTiming &timing) {
+  std::string name(prefix);
+  // Milliseconds, like process.hrtime-based timings in JS
+  Nan::Set(res, Nan::New(name + "Count").ToLocalChecked(), Nan::New<Number>((double) timing.Count()));
+  Nan::Set(res, Nan::New(name + "Total").ToLocalChecked(), Nan::New<Number>(timing.Total() / 1e6));
+  Nan::Set(res, Nan::New(name + "P50").ToLocalChecked(), Nan::New<Number>(timing.Percentile(0.5) / 1e6));
+  Nan::Set(res, Nan::New(name + "P99").ToLocalChecked(), Nan::New<Number>(timing.Percentile(0.99) / 1e6));
+}
+
+// cv.stats() returns, for each method called since the last reset,
+//   {callCount, callTotal, callP50, callP99, bytes}
+// plus, for methods that run work on the thread pool,
+//   {queuedCount, queuedTotal, queuedP50, queuedP99,
+//    runCount, runTotal, runP50, runP99}
+// keyed by "Class.method". Times are in milliseconds.
+NAN_METHOD(OpStats::GetStats) {
+  Nan::HandleScope scope;
+
+  Local<Object> res = Nan::New<Object>();
+
+  uv_mutex_lock(&mutex);
+  for (std::map<std::string, OpCounter*>::iterator it = counters.begin();
+      it != counters.end(); ++it) {
+    OpCounter *counter = it->second;
+    if (counter->calls.Count() == 0 && counter->runs.Count() == 0) {
+      continue;
+    }
+
+    Local<Object> op = Nan::New<Object>();
+    SetTiming(op, "call", counter->calls);
+    if (counter->runs.Count() > 0) {
+      SetTiming(op, "queued", counter->queued);
+      SetTiming(op, "run", counter->runs);
+    }
+    Nan::Set(op, Nan::New("bytes").ToLocalChecked(), Nan::New<Number>((double) counter->bytes));
+
+    Nan::Set(res, Nan::New(it->first).ToLocalChecked(), op);
+  }
+  uv_mutex_unlock(&mutex);
+
+  info.GetReturnValue().Set(res);
+}
+
+NAN_METHOD(OpStats::ResetStats) {
+  Nan::HandleScope scope;
+
+  uv_mutex_lock(&mutex);
+  for (std::map<std::string, OpCounter*>::iterator it = counters.begin();
+      it != counters.end(); ++it) {
+    it->second->calls.Reset();
+    it->second->queued.Reset();
+    it->second->runs.Reset();
+    it->second->bytes = 0;
+  }
+  uv_mutex_unlock(&mutex);
+}
+
+// cv.enableStats([enable = true]). Stats start enabled when the
+// NODE_OPENCV_STATS environment variable is set.
+NAN_METHOD(OpStats::EnableStats) {
+  Nan::HandleScope scope;
+
+  enabled = info.Length() < 1 || Nan::To<bool>(info[0]).FromJust();
+}
@@ -0,0 +1,96 @@
+#include "OpenCV.h"
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+// Durations of one kind of event, in a log-linear histogram: four buckets
+// per power of two of nanoseconds, so percentiles are within ~20%.
+class OpTiming {
+public:
+  OpTiming();
+
+  void Add(uint64_t ns);
+  void Reset();
+
+  uint64_t Count() const { return count; }
+  uint64_t Total() const { return total; }
+  // Upper bound of the bucket holding the `p` quantile, 0 <= p <= 1
+  uint64_t Percentile(double p) const;
+
+private:
+  static const int kBuckets = 64 * 4;
+
+  uint64_t count;
+  uint64_t total;
+  uint64_t buckets[kBuckets];
+};
+
+// What is known about one native method, e.g. "Matrix.resize"
+struct OpCounter {
+  // Its "Class.method" key
+  std::string name;
+  // Time spent in the method itself, on the main thread
+  OpTiming calls;
+  // Work it queued on the thread pool: time waiting for a thread, and time
+  // running on it
+  OpTiming queued;
+  OpTiming runs;
+  // Matrix buffers allocated by the method and its async results, counted
+  // once per allocation when a matrix takes it on
+  uint64_t bytes;
+};
+
+// Per-method counters for every native method, exposed as cv.stats().
+//
+// Methods are registered through OpStats::SetPrototypeMethod / SetMethod
+// instead of Nan's, with a "Class.method" key. Each call then goes through a
+// trampoline that, when stats are enabled, times it and makes its counter
+// current, so that the thread pool and Matrix::SyncExternalMemory can charge
+// queued work and allocations to it. The current method also names the spans
+// OpTrace emits. When neither is on, a call does what Nan's own wrapper does
+// (unwrapping the callback and building its `info`) plus one branch on the
+// two flags.
+class OpStats {
+public:
+  static void Init(Local<Object> target);
+
+  // Adds the method named after the last '.' of `key` to `tpl`'s prototype
+  static void SetPrototypeMethod(Local<FunctionTemplate> tpl, const char *key,
+      Nan::FunctionCallback callback, Local<Value> data = Local<Value>());
+  // Adds a static method named after the last '.' of `key`
+  static void SetMethod(Local<FunctionTemplate> tpl, const char *key,
+      Nan::FunctionCallback callback);
+  static void SetMethod(Local<Object> target, const char *key,
+      Nan::FunctionCallback callback);
+
+  static bool Enabled() { return enabled; }
+
+  // The counter of the method running on the main thread, or NULL. Only
+  // set while stats or tracing are enabled.
+  static OpCounter* Current() { return current; }
+  static OpCounter* SetCurrent(OpCounter *counter);
+
+  // Charges a new matrix allocation to the current method. Main thread only.
+  static void AddBytes(size_t bytes);
+
+  // Thread safe: records work that waited `queuedNs` and ran for `runNs`
+  static void RecordRun(OpCounter *counter, uint64_t queuedNs, uint64_t runNs);
+
+  static NAN_METHOD(GetStats);
+  static NAN_METHOD(ResetStats);
+  static NAN_METHOD(EnableStats);
+
+private:
+  static OpCounter* Counter(const std::string &key);
+  static Local<FunctionTemplate> Trampoline(const char *key,
+      Nan::FunctionCallback callback, Local<Value> data,
+      Local<Signature> signature);
+  static void Call(const v8::FunctionCallbackInfo<v8::Value> &args);
+
+  static bool enabled;
+  static OpCounter *current;
+  static std::map<std::string, OpCounter*> counters;
+  // Guards `queued` and `runs`, which pool threads update
+  static uv_mutex_t mutex;
+};
@@ -0,0 +1,56 @@
+#include "OpTrace.h"
+#include "OpenCV.h"
+#include <nan.h>
+
+#if NODE_MAJOR_VERSION >= 12
+#include <memory>
+
+// From V8's trace_event_common.h, which isn't part of Node's headers
+#define TRACE_EVENT_PHASE_NESTABLE_ASYNC_BEGIN ('b')
+#define TRACE_EVENT_PHASE_NESTABLE_ASYNC_END ('e')
+#define TRACE_EVENT_FLAG_HAS_ID (1 << 1)
+#define TRACE_VALUE_TYPE_INT (3)
+#endif
+
+const uint8_t *OpTrace::category = NULL;
+
+void OpTrace::Init() {
+#if NODE_MAJOR_VERSION >= 12
+  if (category == NULL) {
+    // The flag's value changes as tracing starts and stops, so it is looked
+    // up once and read on every call
+    category = node::GetTracingController()->GetCategoryGroupEnabled("node.opencv");
+  }
+#endif
+}
+
+// Main thread only
+uint64_t OpTrace::NewId() {
+  static uint64_t next = 0;
+  return ++next;
+}
+
+void OpTrace::Begin(const char *name, uint64_t id, cv::Size size) {
+  Add(TRACE_EVENT_PHASE_NESTABLE_ASYNC_BEGIN, name, id, size);
+}
+
+void OpTrace::End(const char *name, uint64_t id, cv::Size size) {
+  Add(TRACE_EVENT_PHASE_NESTABLE_ASYNC_END, name, id, size);
+}
+
+void OpTrace::Add(char phase, const char *name, uint64_t id, cv::Size size) {
+#if NODE_MAJOR_VERSION >= 12
+  if (!Enabled()) {
+    return;
+  }
+
+  const char *argNames[] = {"width", "height"};
+  uint8_t argTypes[] = {TRACE_VALUE_TYPE_INT, TRACE_VALUE_TYPE_INT};
+  uint64_t argValues[] = {(uint64_t) size.width, (uint64_t) size.height};
+  int32_t args = size.area() > 0 ? 2 : 0;
+
+  // Node's controller is safe to call from any thread
+  node::GetTracingController()->AddTraceEvent(phase, category, name, NULL, id,
+      0, args, argNames, argTypes, argValues, NULL, TRACE_EVENT_FLAG_HAS_ID);
+#endif
+}
@@ -0,0 +1,34 @@
+#include "OpenCV.h"
+
+#include <stdint.h>
+
+// Spans for async work in Node's trace events, under the "node.opencv"
+// category, e.g.
+//
+//   node --trace-event-categories node.opencv app.js
+//
+// gives a node_trace.*.log that chrome://tracing shows as a timeline. Each
+// piece of work queued on the ThreadPool is a span named after the method
+// that queued it ("Matrix.resizeAsync"), with "queued", "execute" and
+// "callback" spans nested inside, tagged with the image size where known.
+//
+// Needs Node 12 or later; on older versions Enabled() is always false.
+class OpTrace {
+public:
+  static void Init();
+
+  // Whether the category is being recorded. Cheap enough to check per call.
+  static bool Enabled() { return category != NULL && *category != 0; }
+
+  // An id tying together the begin and end of a span and the spans within it
+  static uint64_t NewId();
+
+  // Thread safe. `name` must outlive the trace, e.g. a string literal.
+  static void Begin(const char *name, uint64_t id, cv::Size size = cv::Size());
+  static void End(const char *name, uint64_t id, cv::Size size = cv::Size());
+
+private:
+  static void Add(char phase, const char *name, uint64_t id, cv::Size size);
+
+  static const uint8_t *category;
+};
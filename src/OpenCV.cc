@@ -1,6 +1,11 @@
 #include "OpenCV.h"
+#include "OpStats.h"
 #include "Matrix.h"
+#include "AsyncBaseWorker.h"
+#include "ThreadPool.h"
 #include <nan.h>
+#include <fstream>
+#include <sstream>
 
 void OpenCV::Init(Local<Object> target) {
   Nan::HandleScope scope;
@@ -8,61 +13,467 @@ void OpenCV::Init(Local<Object> target) {
   // Version string.
   char out [21];
   int n = sprintf(out, "%i.%i", CV_MAJOR_VERSION, CV_MINOR_VERSION);
-  target->Set(Nan::New<String>("version").ToLocalChecked(), Nan::New<String>(out, n).ToLocalChecked());
+  Nan::Set(target, Nan::New<String>("version").ToLocalChecked(), Nan::New<String>(out, n).ToLocalChecked());
 
-  Nan::SetMethod(target, "readImage", ReadImage);
+  OpStats::SetMethod(target, "readImage", ReadImage);
+  OpStats::SetMethod(target, "readImages", ReadImages);
 }
 
-NAN_METHOD(OpenCV::ReadImage) {
-  Nan::EscapableHandleScope scope;
+// IMREAD_REDUCED_* decode JPEGs at 1/2, 1/4 or 1/8 scale directly
+#if CV_MAJOR_VERSION > 3 || (CV_MAJOR_VERSION == 3 && CV_MINOR_VERSION >= 2)
+#define HAVE_IMREAD_REDUCED
+#endif
+
+// Reads the size of a JPEG from its SOF header. Returns false for anything
+// that isn't a JPEG, or when the header isn't within `len` bytes.
+static bool JpegSize(const uchar *data, size_t len, cv::Size &size) {
+  if (len < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+    return false;
+  }
+
+  size_t pos = 2;
+  while (pos + 4 <= len) {
+    if (data[pos] != 0xFF) {
+      return false;
+    }
+    uchar marker = data[pos + 1];
+    if (marker == 0xFF) {
+      // Fill byte
+      pos++;
+      continue;
+    }
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+      // Standalone markers
+      pos += 2;
+      continue;
+    }
+    if (marker == 0xD9 || marker == 0xDA) {
+      // End of image or start of scan before any frame header
+      return false;
+    }
+
+    size_t length = (data[pos + 2] << 8) | data[pos + 3];
+    // SOF0 to SOF15, less DHT (C4), JPG (C8) and DAC (CC)
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+        marker != 0xCC) {
+      if (pos + 9 > len) {
+        return false;
+      }
+      size.height = (data[pos + 5] << 8) | data[pos + 6];
+      size.width = (data[pos + 7] << 8) | data[pos + 8];
+      return size.width > 0 && size.height > 0;
+    }
+    pos += 2 + length;
+  }
+
+  return false;
+}
+
+// How readImage and readImages decode; see OpenCV::ReadImage
+struct DecodeOptions {
+  DecodeOptions() :
+      grayscale(false),
+      reduce(1),
+      maxDimension(0) {
+  }
+
+  bool grayscale;
+  int reduce;
+  int maxDimension;
+};
+
+// An image file, or encoded data borrowed from a Buffer
+struct EncodedImage {
+  std::string filename;
+  cv::Mat data;
+};
+
+static int DecodeFlags(const DecodeOptions &options, int reduce) {
+  if (options.reduce <= 1 && options.maxDimension <= 0) {
+    return options.grayscale ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_UNCHANGED;
+  }
+
+  // A reduced decode always gives 8-bit BGR (or gray) in the stored
+  // orientation, so do the same whatever factor was picked, or whether the
+  // image looks the same would depend on its size
+  int flags = options.grayscale ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR;
+#ifdef HAVE_IMREAD_REDUCED
+  switch (reduce) {
+    case 2: flags = options.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2; break;
+    case 4: flags = options.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4; break;
+    case 8: flags = options.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8; break;
+  }
+  flags |= cv::IMREAD_IGNORE_ORIENTATION;
+#endif
+  return flags;
+}
+
+// The largest power-of-two reduction that keeps the image at least
+// `maxDimension` wide or high. Only JPEGs decode faster when reduced, so
+// anything else is decoded at full size.
+static int ThumbnailReduction(const EncodedImage &image, int maxDimension) {
+  cv::Size size;
+  if (image.filename.empty()) {
+    if (!JpegSize(image.data.data, image.data.total(), size)) {
+      return 1;
+    }
+  } else {
+    // The frame header follows the EXIF data, which is at most 64KiB
+    std::vector<uchar> header(65536 + 1024);
+    std::ifstream file(image.filename.c_str(), std::ios::binary);
+    file.read((char*) &header[0], header.size());
+    if (!JpegSize(&header[0], file.gcount(), size)) {
+      return 1;
+    }
+  }
+
+  int largest = std::max(size.width, size.height);
+  int scale = 8;
+  while (scale > 1 && (largest + scale - 1) / scale < maxDimension) {
+    scale /= 2;
+  }
+  return scale;
+}
+
+// Decodes on the calling thread. Returns an empty matrix if the image can't
+// be read; OpenCV errors are thrown.
+static cv::Mat DecodeImage(const EncodedImage &image, const DecodeOptions &options) {
+  int reduce = options.reduce;
+#ifdef HAVE_IMREAD_REDUCED
+  if (options.maxDimension > 0) {
+    reduce = ThumbnailReduction(image, options.maxDimension);
+  }
+#endif
 
-  REQ_FUN_ARG(1, cb);
+  int flags = DecodeFlags(options, reduce);
+  cv::Mat mat = image.filename.empty() ? cv::imdecode(image.data, flags) :
+      cv::imread(image.filename, flags);
+  if (mat.empty()) {
+    return mat;
+  }
+
+#ifndef HAVE_IMREAD_REDUCED
+  // Rounded up, like libjpeg's scaled decode
+  if (reduce > 1 && options.maxDimension <= 0) {
+    cv::resize(mat, mat, cv::Size((mat.cols + reduce - 1) / reduce,
+        (mat.rows + reduce - 1) / reduce), 0, 0, cv::INTER_AREA);
+  }
+#endif
 
-  Local<Value> argv[2];
-  argv[0] = Nan::Null();
+  // The decoder only scales by powers of two; the rest is a resize
+  int largest = std::max(mat.cols, mat.rows);
+  if (options.maxDimension > 0 && largest > options.maxDimension) {
+    double f = (double) options.maxDimension / largest;
+    cv::Size size(std::max(1, cvRound(mat.cols * f)), std::max(1, cvRound(mat.rows * f)));
+    cv::resize(mat, mat, size, 0, 0, cv::INTER_AREA);
+  }
 
-  Local<Object> im_h = Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  return mat;
+}
+
+// Reads readImage's options object. Throws a JS exception and returns false
+// when an option is out of range.
+static bool ReadDecodeOptions(Local<Object> object, DecodeOptions &options) {
+  options.grayscale = Nan::To<bool>(Nan::Get(object, Nan::New("grayscale").ToLocalChecked()).ToLocalChecked()).FromJust();
+
+  Local<Value> value = Nan::Get(object, Nan::New("reduce").ToLocalChecked()).ToLocalChecked();
+  if (!value->IsUndefined()) {
+    options.reduce = Nan::To<int32_t>(value).FromJust();
+    if (options.reduce != 1 && options.reduce != 2 && options.reduce != 4 &&
+        options.reduce != 8) {
+      Nan::ThrowRangeError("reduce must be 1, 2, 4 or 8");
+      return false;
+    }
+  }
+
+  value = Nan::Get(object, Nan::New("maxDimension").ToLocalChecked()).ToLocalChecked();
+  if (!value->IsUndefined()) {
+    options.maxDimension = Nan::To<int32_t>(value).FromJust();
+    if (options.maxDimension < 1) {
+      Nan::ThrowRangeError("maxDimension must be a positive integer");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static Local<Object> NewMatrix(const cv::Mat &mat) {
+  Nan::EscapableHandleScope scope;
+
+  Local<Object> im_h = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im_h);
-  argv[1] = im_h;
+  img->mat = mat;
+  img->SyncExternalMemory();
 
-  try {
-    cv::Mat mat;
+  return scope.Escape(im_h);
+}
 
-    if (info[0]->IsNumber() && info[1]->IsNumber()) {
-      int width, height;
+// Decodes an image file or an encoded Buffer on a worker, or makes a blank
+// matrix for readImage(width, height).
+class AsyncReadImageWorker: public AsyncBaseWorker {
+public:
+  AsyncReadImageWorker(Nan::Callback *callback, const DecodeOptions &options) :
+      AsyncBaseWorker(callback),
+      options(options),
+      width(0),
+      height(0) {
+  }
 
-      width = info[0]->Uint32Value();
-      height = info[1]->Uint32Value();
-      mat = *(new cv::Mat(width, height, CV_64FC1));
+  void SetFilename(const std::string &name) {
+    image.filename = name;
+  }
 
-    } else if (info[0]->IsString()) {
-      std::string filename = std::string(*Nan::Utf8String(info[0]->ToString()));
-      mat = cv::imread(filename, CV_LOAD_IMAGE_UNCHANGED);
+  // Borrows the Buffer's memory; the worker holds the Buffer until it is done
+  void SetBuffer(Local<Object> buffer) {
+    SaveToPersistent("buffer", buffer);
+    image.data = cv::Mat(Buffer::Length(buffer), 1, CV_8UC1, Buffer::Data(buffer));
+  }
 
-    } else if (Buffer::HasInstance(info[0])) {
-      uint8_t *buf = (uint8_t *) Buffer::Data(info[0]->ToObject());
-      unsigned len = Buffer::Length(info[0]->ToObject());
+  void SetSize(int w, int h) {
+    width = w;
+    height = h;
+  }
 
-      cv::Mat *mbuf = new cv::Mat(len, 1, CV_64FC1, buf);
-      mat = cv::imdecode(*mbuf, CV_LOAD_IMAGE_UNCHANGED);
+  void Execute() {
+    try {
+      if (image.filename.empty() && image.data.empty()) {
+        mat = cv::Mat(width, height, CV_64FC1);
+        return;
+      }
 
+      mat = DecodeImage(image, options);
       if (mat.empty()) {
-        argv[0] = Nan::Error("Error loading file");
+        SetErrorMessage("Error loading file");
+      }
+      imageSize = mat.size();
+    } catch (cv::Exception& e) {
+      SetErrorMessage(e.what());
+    }
+  }
+
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
+    return scope.Escape(NewMatrix(mat));
+  }
+
+private:
+  DecodeOptions options;
+  EncodedImage image;
+  int width;
+  int height;
+  cv::Mat mat;
+};
+
+// readImage(filename or buffer[, options][, callback]) or
+// readImage(width, height[, callback])
+//
+// Options: {grayscale: true} decodes to one channel, {reduce: 2, 4 or 8}
+// decodes at that fraction of the size, {maxDimension: n} scales the image
+// down to fit in n x n, decoding JPEGs at a reduced size where possible (and
+// takes precedence over reduce). Without a callback, returns a promise.
+NAN_METHOD(OpenCV::ReadImage) {
+  Nan::HandleScope scope;
+
+  bool blank = info.Length() > 1 && info[0]->IsNumber() && info[1]->IsNumber();
+  if (!blank && (info.Length() < 1 ||
+      (!info[0]->IsString() && !Buffer::HasInstance(info[0])))) {
+    return Nan::ThrowTypeError("readImage takes a filename or a Buffer");
+  }
+
+  int callbackIndex = blank ? 2 : 1;
+  DecodeOptions options;
+  if (!blank && info.Length() > 1 && info[1]->IsObject() && !info[1]->IsFunction()) {
+    if (!ReadDecodeOptions(Nan::To<Object>(info[1]).ToLocalChecked(), options)) {
+      return;
+    }
+    callbackIndex = 2;
+  } else if (!blank && info.Length() > 1 && (info[1]->IsNull() || info[1]->IsUndefined())) {
+    // An empty options slot, as in readImage(buf, null, cb)
+    callbackIndex = 2;
+  }
+
+  Nan::Callback *callback = NULL;
+  if (info.Length() > callbackIndex && info[callbackIndex]->IsFunction()) {
+    callback = new Nan::Callback(info[callbackIndex].As<Function>());
+  }
+
+  AsyncReadImageWorker *worker = new AsyncReadImageWorker(callback, options);
+  if (blank) {
+    worker->SetSize(Nan::To<uint32_t>(info[0]).FromJust(), Nan::To<uint32_t>(info[1]).FromJust());
+  } else if (info[0]->IsString()) {
+    worker->SetFilename(*Nan::Utf8String(info[0]));
+  } else {
+    worker->SetBuffer(Nan::To<Object>(info[0]).ToLocalChecked());
+  }
+
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(worker));
+}
+
+// Decodes images[i] into results[i], or sets errors[i]
+class DecodeBatchJob: public ParallelJob {
+public:
+  DecodeBatchJob(const std::vector<EncodedImage> &images,
+      const DecodeOptions &options) :
+      ParallelJob(images.size()),
+      results(images.size()),
+      errors(images.size()),
+      images(images),
+      options(options) {
+  }
+
+  void Run() {
+    for (int i = Next(); i >= 0; i = Next()) {
+      try {
+        results[i] = DecodeImage(images[i], options);
+        if (results[i].empty()) {
+          errors[i] = "Error loading file";
+        }
+      } catch (cv::Exception& e) {
+        errors[i] = e.what();
+      }
+    }
+  }
+
+  std::vector<cv::Mat> results;
+  std::vector<std::string> errors;
+
+private:
+  const std::vector<EncodedImage> &images;
+  const DecodeOptions &options;
+};
+
+class AsyncReadImagesWorker: public AsyncBaseWorker {
+public:
+  AsyncReadImagesWorker(Nan::Callback *callback, Local<Array> sources,
+      const DecodeOptions &options) :
+      AsyncBaseWorker(callback),
+      images(sources->Length()),
+      options(options) {
+    for (uint32_t i = 0; i < sources->Length(); i++) {
+      Local<Value> source = Nan::Get(sources, i).ToLocalChecked();
+      if (source->IsString()) {
+        images[i].filename = *Nan::Utf8String(source);
+      } else {
+        // Held by the worker, so JS can't free the memory under a decode
+        std::ostringstream key;
+        key << "buffer" << i;
+        SaveToPersistent(key.str().c_str(), Nan::To<Object>(source).ToLocalChecked());
+        images[i].data = cv::Mat(Buffer::Length(source), 1, CV_8UC1, Buffer::Data(source));
+      }
+    }
+  }
+
+  void Execute() {
+    DecodeBatchJob job(images, options);
+    ThreadPool::ParallelFor(job);
+    results.swap(job.results);
+    errors.swap(job.errors);
+  }
+
+  // A Matrix, or an Error, per input
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
+
+    Local<Array> arr = Nan::New<Array>(results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+      if (errors[i].empty()) {
+        Nan::Set(arr, i, NewMatrix(results[i]));
+      } else {
+        Nan::Set(arr, i, Nan::Error(errors[i].c_str()));
       }
     }
 
-    img->mat = mat;
-  } catch (cv::Exception& e) {
-    argv[0] = Nan::Error(e.what());
-    argv[1] = Nan::Null();
+    return scope.Escape(arr);
   }
 
-  Nan::TryCatch try_catch;
-  cb->Call(Nan::GetCurrentContext()->Global(), 2, argv);
+private:
+  std::vector<EncodedImage> images;
+  DecodeOptions options;
+  std::vector<cv::Mat> results;
+  std::vector<std::string> errors;
+};
+
+// readImages(sources[, options][, callback])
+//
+// Decodes an array of Buffers and/or filenames in parallel on the thread
+// pool, with readImage's options. The result has one entry per source, in
+// order: a Matrix, or an Error for a source that failed to decode. Without a
+// callback, returns a promise.
+NAN_METHOD(OpenCV::ReadImages) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 1 || !info[0]->IsArray()) {
+    return Nan::ThrowTypeError("readImages takes an array of Buffers or filenames");
+  }
+
+  Local<Array> sources = info[0].As<Array>();
+  for (uint32_t i = 0; i < sources->Length(); i++) {
+    Local<Value> source = Nan::Get(sources, i).ToLocalChecked();
+    if (!source->IsString() && !Buffer::HasInstance(source)) {
+      return Nan::ThrowTypeError("readImages takes an array of Buffers or filenames");
+    }
+  }
+
+  int callbackIndex = 1;
+  DecodeOptions options;
+  if (info.Length() > 1 && info[1]->IsObject() && !info[1]->IsFunction()) {
+    if (!ReadDecodeOptions(Nan::To<Object>(info[1]).ToLocalChecked(), options)) {
+      return;
+    }
+    callbackIndex = 2;
+  } else if (info.Length() > 1 && (info[1]->IsNull() || info[1]->IsUndefined())) {
+    callbackIndex = 2;
+  }
 
-  if (try_catch.HasCaught()) {
-    Nan::FatalException(try_catch);
+  Nan::Callback *callback = NULL;
+  if (info.Length() > callbackIndex && info[callbackIndex]->IsFunction()) {
+    callback = new Nan::Callback(info[callbackIndex].As<Function>());
   }
 
-  return;
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(
+      new AsyncReadImagesWorker(callback, sources, options)));
+}
+
+Local<Object> OpenCV::NewTypedArray(int depth, size_t length, void **data) {
+  Nan::EscapableHandleScope scope;
+
+  Local<ArrayBuffer> buffer = ArrayBuffer::New(v8::Isolate::GetCurrent(),
+      length * CV_ELEM_SIZE1(depth));
+  Local<Object> array = NewTypedArray(depth, buffer, 0, length);
+
+  Nan::TypedArrayContents<char> contents(array);
+  *data = *contents;
+
+  return scope.Escape(array);
+}
+
+Local<Object> OpenCV::NewTypedArray(int depth, Local<ArrayBuffer> buffer,
+    size_t offset, size_t length) {
+  Nan::EscapableHandleScope scope;
+
+  Local<TypedArray> array;
+  switch (depth) {
+    case CV_8U: array = Uint8Array::New(buffer, offset, length); break;
+    case CV_8S: array = Int8Array::New(buffer, offset, length); break;
+    case CV_16U: array = Uint16Array::New(buffer, offset, length); break;
+    case CV_16S: array = Int16Array::New(buffer, offset, length); break;
+    case CV_32S: array = Int32Array::New(buffer, offset, length); break;
+    case CV_32F: array = Float32Array::New(buffer, offset, length); break;
+    default: array = Float64Array::New(buffer, offset, length); break;
+  }
+
+  return scope.Escape(array);
+}
+
+int OpenCV::TypedArrayDepth(Local<Value> value) {
+  // Buffers are Uint8Arrays too
+  if (value->IsUint8Array()) return CV_8U;
+  if (value->IsInt8Array()) return CV_8S;
+  if (value->IsUint16Array()) return CV_16U;
+  if (value->IsInt16Array()) return CV_16S;
+  if (value->IsInt32Array()) return CV_32S;
+  if (value->IsFloat32Array()) return CV_32F;
+  if (value->IsFloat64Array()) return CV_64F;
+  return -1;
 }
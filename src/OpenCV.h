@@ -39,6 +39,15 @@ using namespace node;
     return Nan::ThrowTypeError("Argument " #I " must be a function");  \
   Local<Function> VAR = Local<Function>::Cast(info[I]);
 
+// Optional callback: VAR is a new Nan::Callback, or NULL when the argument is
+// missing, undefined or null
+#define OPT_FUN_ARG(I, VAR)                                             \
+  if (info.Length() > (I) && !info[I]->IsFunction()                     \
+      && !info[I]->IsUndefined() && !info[I]->IsNull())                 \
+    return Nan::ThrowTypeError("Argument " #I " must be a function");  \
+  Nan::Callback *VAR = (info.Length() > (I) && info[I]->IsFunction()) ? \
+      new Nan::Callback(info[I].As<Function>()) : NULL;
+
 #define SETUP_FUNCTION(TYP)	\
 	Nan::HandleScope scope;		\
 	TYP *self = Nan::ObjectWrap::Unwrap<TYP>(info.This());
@@ -54,12 +63,12 @@ using namespace node;
 
 #define INT_FROM_ARGS(NAME, IND) \
   if (info[IND]->IsInt32()){ \
-    NAME = info[IND]->Uint32Value(); \
+    NAME = Nan::To<uint32_t>(info[IND]).FromJust(); \
   }
 
 #define DOUBLE_FROM_ARGS(NAME, IND) \
   if (info[IND]->IsInt32()){ \
-    NAME = info[IND]->NumberValue(); \
+    NAME = Nan::To<double>(info[IND]).FromJust(); \
   }
 
 class OpenCV: public Nan::ObjectWrap {
@@ -67,6 +76,19 @@ public:
   static void Init(Local<Object> target);
 
   static NAN_METHOD(ReadImage);
+  static NAN_METHOD(ReadImages);
+
+  // Creates a zero-filled typed array of `length` elements of an OpenCV
+  // depth (CV_8U gives a Uint8Array, CV_32S an Int32Array, CV_64F a
+  // Float64Array, ...) and points `data` at its storage.
+  static Local<Object> NewTypedArray(int depth, size_t length, void **data);
+  // A typed array of that depth viewing `length` elements of `buffer` from
+  // `offset` bytes, without copying.
+  static Local<Object> NewTypedArray(int depth, Local<ArrayBuffer> buffer,
+      size_t offset, size_t length);
+  // The OpenCV depth matching a typed array's element type, or -1 for
+  // anything else (e.g. a DataView or a Uint8ClampedArray).
+  static int TypedArrayDepth(Local<Value> value);
 };
 
 #endif
@@ -0,0 +1,142 @@
+#include "Pipeline.h"
+#include "Matrix.h"
+#include "Contours.h"
+#include "MatOp.h"
+#include "AsyncBaseWorker.h"
+#include "OpenCV.h"
+#include "OpStats.h"
+#include <nan.h>
+
+void Pipeline::Init(Local<Object> target) {
+  Nan::HandleScope scope;
+
+  OpStats::SetMethod(target, "_runPipeline", Run);
+}
+
+class PipelineWorker: public AsyncBaseWorker {
+public:
+  PipelineWorker(Nan::Callback *callback, Local<Object> source,
+      std::vector<MatOp*> ops, bool contours, int mode, int chain) :
+      AsyncBaseWorker(callback),
+      ops(ops),
+      contours(contours),
+      mode(mode),
+      chain(chain) {
+    mat = PinMatrix("source", source);
+  }
+
+  ~PipelineWorker() {
+    for (size_t i = 0; i < ops.size(); i++) {
+      delete ops[i];
+    }
+  }
+
+  void Execute() {
+    try {
+      // Each step reads from one buffer and writes to the other, so the
+      // pipeline holds at most two intermediates whatever its length.
+      cv::Mat buffers[2];
+      const cv::Mat *current = &mat;
+      for (size_t i = 0; i < ops.size(); i++) {
+        ops[i]->Apply(*current, buffers[i % 2]);
+        current = &buffers[i % 2];
+      }
+
+      // findContours may write to its input, which must not be the source
+      result = current == &mat ? mat.clone() : *current;
+
+      if (contours) {
+        cv::findContours(result, points, hierarchy, mode, chain);
+      }
+    } catch (cv::Exception& e) {
+      SetErrorMessage(e.what());
+    }
+  }
+
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
+
+    if (contours) {
+      Local<Object> conts_to_return = Nan::NewInstance(Nan::GetFunction(Nan::New(Contour::constructor)).ToLocalChecked()).ToLocalChecked();
+      Contour *conts = Nan::ObjectWrap::Unwrap<Contour>(conts_to_return);
+      conts->contours.swap(points);
+      conts->hierarchy.swap(hierarchy);
+      return scope.Escape(conts_to_return);
+    }
+
+    Local<Object> im_to_return = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
+    Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im_to_return);
+    img->mat = result;
+    img->SyncExternalMemory();
+
+    return scope.Escape(im_to_return);
+  }
+
+private:
+  cv::Mat mat;
+  std::vector<MatOp*> ops;
+  bool contours;
+  int mode;
+  int chain;
+
+  cv::Mat result;
+  std::vector<std::vector<cv::Point> > points;
+  std::vector<cv::Vec4i> hierarchy;
+};
+
+NAN_METHOD(Pipeline::Run) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 2 || !info[0]->IsObject() ||
+      !Nan::New(Matrix::constructor)->HasInstance(info[0]) ||
+      !info[1]->IsArray()) {
+    return Nan::ThrowTypeError("_runPipeline takes a Matrix and an array of operations");
+  }
+
+  Local<Object> source = Nan::To<Object>(info[0]).ToLocalChecked();
+  Local<Array> steps = info[1].As<Array>();
+
+  OPT_FUN_ARG(2, callback);
+
+  std::vector<MatOp*> ops;
+  bool contours = false;
+  int mode = CV_RETR_LIST;
+  int chain = CV_CHAIN_APPROX_SIMPLE;
+  std::string error;
+
+  for (uint32_t i = 0; i < steps->Length() && error.empty(); i++) {
+    Local<Object> step = Nan::To<Object>(Nan::Get(steps, i).ToLocalChecked()).ToLocalChecked();
+    std::string name(*Nan::Utf8String(Nan::Get(step, Nan::New("name").ToLocalChecked()).ToLocalChecked()));
+    Local<Value> argsValue = Nan::Get(step, Nan::New("args").ToLocalChecked()).ToLocalChecked();
+    Local<Array> args = argsValue->IsArray() ? argsValue.As<Array>() : Nan::New<Array>();
+
+    if (contours) {
+      error = "findContours must be the last operation";
+    } else if (name == "findContours") {
+      // Terminal: the pipeline resolves to a Contours object
+      contours = true;
+      if (args->Length() > 0 && Nan::Get(args, 0).ToLocalChecked()->IsNumber()) {
+        mode = Nan::To<int64_t>(Nan::Get(args, 0).ToLocalChecked()).FromJust();
+      }
+      if (args->Length() > 1 && Nan::Get(args, 1).ToLocalChecked()->IsNumber()) {
+        chain = Nan::To<int64_t>(Nan::Get(args, 1).ToLocalChecked()).FromJust();
+      }
+    } else {
+      MatOp *op = MatOp::Create(name, args, error);
+      if (op) {
+        ops.push_back(op);
+      }
+    }
+  }
+
+  if (!error.empty()) {
+    for (size_t i = 0; i < ops.size(); i++) {
+      delete ops[i];
+    }
+    delete callback;
+    return Nan::ThrowError(error.c_str());
+  }
+
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(new PipelineWorker(callback,
+      source, ops, contours, mode, chain)));
+}
@@ -0,0 +1,11 @@
+#include "OpenCV.h"
+
+// Native side of cv.pipeline(): runs a recorded list of MatOps over a matrix
+// in a single worker job (see lib/opencv.js for the builder).
+class Pipeline {
+public:
+  static void Init(Local<Object> target);
+
+  // cv._runPipeline(matrix, [{name, args}, ...][, callback])
+  static NAN_METHOD(Run);
+};
@@ -1,5 +1,6 @@
 #include "Point.h"
 #include "OpenCV.h"
+#include "OpStats.h"
 
 Nan::Persistent<FunctionTemplate> Point::constructor;
 
@@ -17,9 +18,9 @@ void Point::Init(Local<Object> target) {
   Nan::SetAccessor(proto, Nan::New("x").ToLocalChecked(), GetX, RaiseImmutable);
   Nan::SetAccessor(proto, Nan::New("y").ToLocalChecked(), GetY, RaiseImmutable);
 
-  Nan::SetPrototypeMethod(ctor, "dot", Dot);
+  OpStats::SetPrototypeMethod(ctor, "Point.dot", Dot);
 
-  target->Set(Nan::New("Point").ToLocalChecked(), ctor->GetFunction());
+  Nan::Set(target, Nan::New("Point").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 };
 
 NAN_METHOD(Point::New) {
@@ -31,10 +32,10 @@ NAN_METHOD(Point::New) {
 
   double x = 0, y = 0;
   if (info[0]->IsNumber()) {
-    x = info[0]->NumberValue();
+    x = Nan::To<double>(info[0]).FromJust();
   }
   if (info[1]->IsNumber()) {
-    y = info[1]->NumberValue();
+    y = Nan::To<double>(info[1]).FromJust();
   }
   Point *pt = new Point(x, y);
   pt->Wrap(info.This());
@@ -60,7 +61,7 @@ NAN_SETTER(Point::RaiseImmutable) {
 NAN_METHOD(Point::Dot) {
   Nan::HandleScope scope;
   Point *p1 = Nan::ObjectWrap::Unwrap<Point>(info.This());
-  Point *p2 = Nan::ObjectWrap::Unwrap<Point>(info[0]->ToObject());
+  Point *p2 = Nan::ObjectWrap::Unwrap<Point>(Nan::To<Object>(info[0]).ToLocalChecked());
 
   // Since V 2.3 Native Dot no longer supported
   info.GetReturnValue().Set(Nan::New<Number>(p1->point.x * p2->point.x + p1->point.y * p2->point.y));
@@ -1,5 +1,6 @@
 
 #include "Stereo.h"
+#include "OpStats.h"
 
 #if CV_MAJOR_VERSION >= 3
 #warning TODO: port me to OpenCV 3
@@ -21,13 +22,13 @@ void StereoBM::Init(Local<Object> target) {
   ctor->InstanceTemplate()->SetInternalFieldCount(1);
   ctor->SetClassName(Nan::New("StereoBM").ToLocalChecked());
 
-  Nan::SetPrototypeMethod(ctor, "compute", Compute);
+  OpStats::SetPrototypeMethod(ctor, "StereoBM.compute", Compute);
 
   ctor->Set(Nan::New<String>("BASIC_PRESET").ToLocalChecked(), Nan::New<Integer>((int)cv::StereoBM::BASIC_PRESET));
   ctor->Set(Nan::New<String>("FISH_EYE_PRESET").ToLocalChecked(), Nan::New<Integer>((int)cv::StereoBM::FISH_EYE_PRESET));
   ctor->Set(Nan::New<String>("NARROW_PRESET").ToLocalChecked(), Nan::New<Integer>((int)cv::StereoBM::NARROW_PRESET));
 
-  target->Set(Nan::New("StereoBM").ToLocalChecked(), ctor->GetFunction());
+  Nan::Set(target, Nan::New("StereoBM").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 }
 
 NAN_METHOD(StereoBM::New) {
@@ -43,14 +44,14 @@ NAN_METHOD(StereoBM::New) {
     stereo = new StereoBM();
   } else if (info.Length() == 1) {
     // preset
-    stereo = new StereoBM(info[0]->IntegerValue());
+    stereo = new StereoBM(Nan::To<int64_t>(info[0]).FromJust());
   } else if (info.Length() == 2) {
     // preset, disparity search range
-    stereo = new StereoBM(info[0]->IntegerValue(), info[1]->IntegerValue());
+    stereo = new StereoBM(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust());
   } else {
-    stereo = new StereoBM(info[0]->IntegerValue(), info[1]->IntegerValue(),
+    stereo = new StereoBM(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
         // preset, disparity search range, sum of absolute differences window size
-        info[2]->IntegerValue());
+        Nan::To<int64_t>(info[2]).FromJust());
   }
 
   stereo->Wrap(info.Holder());
@@ -70,17 +71,17 @@ NAN_METHOD(StereoBM::Compute) {
     // Get the arguments
 
     // Arg 0, the 'left' image
-    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
     cv::Mat left = m0->mat;
 
     // Arg 1, the 'right' image
-    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
     cv::Mat right = m1->mat;
 
     // Optional 3rd arg, the disparty depth
     int type = CV_16S;
     if (info.Length() > 2) {
-      type = info[2]->IntegerValue();
+      type = Nan::To<int64_t>(info[2]).FromJust();
     }
 
     // Compute stereo using the block matching algorithm
@@ -89,9 +90,10 @@ NAN_METHOD(StereoBM::Compute) {
 
     // Wrap the returned disparity map
     Local < Object > disparityWrap =
-        Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+        Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix *disp = Nan::ObjectWrap::Unwrap<Matrix>(disparityWrap);
     disp->mat = disparity;
+    disp->SyncExternalMemory();
 
     info.GetReturnValue().Set(disparityWrap);
 
@@ -113,9 +115,9 @@ void StereoSGBM::Init(Local<Object> target) {
   ctor->InstanceTemplate()->SetInternalFieldCount(1);
   ctor->SetClassName(Nan::New("StereoSGBM").ToLocalChecked());
 
-  Nan::SetPrototypeMethod(ctor, "compute", Compute);
+  OpStats::SetPrototypeMethod(ctor, "StereoSGBM.compute", Compute);
 
-  target->Set(Nan::New("StereoSGBM").ToLocalChecked(), ctor->GetFunction());
+  Nan::Set(target, Nan::New("StereoSGBM").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 }
 
 NAN_METHOD(StereoSGBM::New) {
@@ -134,49 +136,49 @@ NAN_METHOD(StereoSGBM::New) {
     if (info.Length() >= 3) {
       switch (info.Length()) {
         case 3:
-        stereo = new StereoSGBM(info[0]->IntegerValue(), info[1]->IntegerValue(),
-            info[2]->IntegerValue());
+        stereo = new StereoSGBM(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
+            Nan::To<int64_t>(info[2]).FromJust());
         break;
         case 4:
-        stereo = new StereoSGBM(info[0]->IntegerValue(), info[1]->IntegerValue(),
-            info[2]->IntegerValue(), info[3]->IntegerValue());
+        stereo = new StereoSGBM(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
+            Nan::To<int64_t>(info[2]).FromJust(), Nan::To<int64_t>(info[3]).FromJust());
         break;
         case 5:
-        stereo = new StereoSGBM(info[0]->IntegerValue(), info[1]->IntegerValue(),
-            info[2]->IntegerValue(), info[3]->IntegerValue(), info[4]->IntegerValue());
+        stereo = new StereoSGBM(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
+            Nan::To<int64_t>(info[2]).FromJust(), Nan::To<int64_t>(info[3]).FromJust(), Nan::To<int64_t>(info[4]).FromJust());
         break;
         case 6:
-        stereo = new StereoSGBM(info[0]->IntegerValue(), info[1]->IntegerValue(),
-            info[2]->IntegerValue(), info[3]->IntegerValue(), info[4]->IntegerValue(),
-            info[5]->IntegerValue());
+        stereo = new StereoSGBM(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
+            Nan::To<int64_t>(info[2]).FromJust(), Nan::To<int64_t>(info[3]).FromJust(), Nan::To<int64_t>(info[4]).FromJust(),
+            Nan::To<int64_t>(info[5]).FromJust());
         break;
         case 7:
-        stereo = new StereoSGBM(info[0]->IntegerValue(), info[1]->IntegerValue(),
-            info[2]->IntegerValue(), info[3]->IntegerValue(), info[4]->IntegerValue(),
-            info[5]->IntegerValue(), info[6]->IntegerValue());
+        stereo = new StereoSGBM(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
+            Nan::To<int64_t>(info[2]).FromJust(), Nan::To<int64_t>(info[3]).FromJust(), Nan::To<int64_t>(info[4]).FromJust(),
+            Nan::To<int64_t>(info[5]).FromJust(), Nan::To<int64_t>(info[6]).FromJust());
         break;
         case 8:
-        stereo = new StereoSGBM(info[0]->IntegerValue(), info[1]->IntegerValue(),
-            info[2]->IntegerValue(), info[3]->IntegerValue(), info[4]->IntegerValue(),
-            info[5]->IntegerValue(), info[6]->IntegerValue(), info[7]->IntegerValue());
+        stereo = new StereoSGBM(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
+            Nan::To<int64_t>(info[2]).FromJust(), Nan::To<int64_t>(info[3]).FromJust(), Nan::To<int64_t>(info[4]).FromJust(),
+            Nan::To<int64_t>(info[5]).FromJust(), Nan::To<int64_t>(info[6]).FromJust(), Nan::To<int64_t>(info[7]).FromJust());
         break;
         case 9:
-        stereo = new StereoSGBM(info[0]->IntegerValue(), info[1]->IntegerValue(),
-            info[2]->IntegerValue(), info[3]->IntegerValue(), info[4]->IntegerValue(),
-            info[5]->IntegerValue(), info[6]->IntegerValue(), info[7]->IntegerValue(),
-            info[8]->IntegerValue());
+        stereo = new StereoSGBM(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
+            Nan::To<int64_t>(info[2]).FromJust(), Nan::To<int64_t>(info[3]).FromJust(), Nan::To<int64_t>(info[4]).FromJust(),
+            Nan::To<int64_t>(info[5]).FromJust(), Nan::To<int64_t>(info[6]).FromJust(), Nan::To<int64_t>(info[7]).FromJust(),
+            Nan::To<int64_t>(info[8]).FromJust());
         break;
         case 10:
-        stereo = new StereoSGBM(info[0]->IntegerValue(), info[1]->IntegerValue(),
-            info[2]->IntegerValue(), info[3]->IntegerValue(), info[4]->IntegerValue(),
-            info[5]->IntegerValue(), info[6]->IntegerValue(), info[7]->IntegerValue(),
-            info[8]->IntegerValue(), info[9]->IntegerValue());
+        stereo = new StereoSGBM(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
+            Nan::To<int64_t>(info[2]).FromJust(), Nan::To<int64_t>(info[3]).FromJust(), Nan::To<int64_t>(info[4]).FromJust(),
+            Nan::To<int64_t>(info[5]).FromJust(), Nan::To<int64_t>(info[6]).FromJust(), Nan::To<int64_t>(info[7]).FromJust(),
+            Nan::To<int64_t>(info[8]).FromJust(), Nan::To<int64_t>(info[9]).FromJust());
         break;
         default:
-        stereo = new StereoSGBM(info[0]->IntegerValue(), info[1]->IntegerValue(),
-            info[2]->IntegerValue(), info[3]->IntegerValue(), info[4]->IntegerValue(),
-            info[5]->IntegerValue(), info[6]->IntegerValue(), info[7]->IntegerValue(),
-            info[8]->IntegerValue(), info[9]->IntegerValue(), info[10]->ToBoolean()->Value());
+        stereo = new StereoSGBM(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust(),
+            Nan::To<int64_t>(info[2]).FromJust(), Nan::To<int64_t>(info[3]).FromJust(), Nan::To<int64_t>(info[4]).FromJust(),
+            Nan::To<int64_t>(info[5]).FromJust(), Nan::To<int64_t>(info[6]).FromJust(), Nan::To<int64_t>(info[7]).FromJust(),
+            Nan::To<int64_t>(info[8]).FromJust(), Nan::To<int64_t>(info[9]).FromJust(), Nan::To<Boolean>(info[10]).ToLocalChecked()->Value());
         break;
       }
     } else {
@@ -211,11 +213,11 @@ NAN_METHOD(StereoSGBM::Compute) {
     // Get the arguments
 
     // Arg 0, the 'left' image
-    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
     cv::Mat left = m0->mat;
 
     // Arg 1, the 'right' image
-    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
     cv::Mat right = m1->mat;
 
     // Compute stereo using the block matching algorithm
@@ -224,9 +226,10 @@ NAN_METHOD(StereoSGBM::Compute) {
 
     // Wrap the returned disparity map
     Local < Object > disparityWrap =
-        Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+        Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix *disp = Nan::ObjectWrap::Unwrap<Matrix>(disparityWrap);
     disp->mat = disparity;
+    disp->SyncExternalMemory();
 
     info.GetReturnValue().Set(disparityWrap);
   } catch (cv::Exception &e) {
@@ -248,9 +251,9 @@ void StereoGC::Init(Local<Object> target) {
   ctor->InstanceTemplate()->SetInternalFieldCount(1);
   ctor->SetClassName(Nan::New("StereoGC").ToLocalChecked());
 
-  Nan::SetPrototypeMethod(ctor, "compute", Compute);
+  OpStats::SetPrototypeMethod(ctor, "StereoGC.compute", Compute);
 
-  target->Set(Nan::New("StereoGC").ToLocalChecked(), ctor->GetFunction());
+  Nan::Set(target, Nan::New("StereoGC").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 }
 
 NAN_METHOD(StereoGC::New) {
@@ -265,10 +268,10 @@ NAN_METHOD(StereoGC::New) {
     stereo = new StereoGC();
   } else if (info.Length() == 1) {
     // numberOfDisparities
-    stereo = new StereoGC(info[0]->IntegerValue());
+    stereo = new StereoGC(Nan::To<int64_t>(info[0]).FromJust());
   } else {
     // max iterations
-    stereo = new StereoGC(info[0]->IntegerValue(), info[1]->IntegerValue());
+    stereo = new StereoGC(Nan::To<int64_t>(info[0]).FromJust(), Nan::To<int64_t>(info[1]).FromJust());
   }
 
   stereo->Wrap(info.Holder());
@@ -288,11 +291,11 @@ NAN_METHOD(StereoGC::Compute) {
     // Get the arguments
 
     // Arg 0, the 'left' image
-    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
+    Matrix* m0 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[0]).ToLocalChecked());
     cv::Mat left = m0->mat;
 
     // Arg 1, the 'right' image
-    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
+    Matrix* m1 = Nan::ObjectWrap::Unwrap<Matrix>(Nan::To<Object>(info[1]).ToLocalChecked());
     cv::Mat right = m1->mat;
 
     // Compute stereo using the block matching algorithm
@@ -308,9 +311,10 @@ NAN_METHOD(StereoGC::Compute) {
 
     // Wrap the returned disparity map
     Local < Object > disparityWrap =
-        Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+        Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix *disp = Nan::ObjectWrap::Unwrap<Matrix>(disparityWrap);
     disp->mat = disparity;
+    disp->SyncExternalMemory();
 
     info.GetReturnValue().Set(disparityWrap);
   } catch (cv::Exception &e) {
@@ -0,0 +1,265 @@
+#include "ThreadPool.h"
+#include "AsyncBaseWorker.h"
+#include "OpenCV.h"
+#include "OpStats.h"
+#include "OpTrace.h"
+#include <nan.h>
+
+bool ThreadPool::initialized = false;
+uv_mutex_t ThreadPool::mutex;
+uv_cond_t ThreadPool::cond;
+uv_cond_t ThreadPool::helpersDone;
+uv_async_t ThreadPool::completion;
+unsigned int ThreadPool::size = 0;
+std::vector<uv_thread_t> ThreadPool::threads;
+std::deque<ThreadPool::Task> ThreadPool::pending;
+std::deque<ThreadPool::Task> ThreadPool::done;
+unsigned int ThreadPool::outstanding = 0;
+unsigned int ThreadPool::active = 0;
+uint64_t ThreadPool::completed = 0;
+
+void ThreadPool::Init(Local<Object> target) {
+  Nan::HandleScope scope;
+
+  if (!initialized) {
+    uv_mutex_init(&mutex);
+    uv_cond_init(&cond);
+    uv_cond_init(&helpersDone);
+    uv_async_init(uv_default_loop(), &completion, Complete);
+    // Only keeps the loop alive while work is outstanding
+    uv_unref((uv_handle_t*) &completion);
+    initialized = true;
+
+    SetSize(std::max(1, std::min(4, cv::getNumberOfCPUs())));
+  }
+
+  OpStats::SetMethod(target, "setNumThreads", SetNumThreads);
+  OpStats::SetMethod(target, "getNumThreads", GetNumThreads);
+  OpStats::SetMethod(target, "getThreadPoolStats", GetStats);
+}
+
+void ThreadPool::SetSize(unsigned int threadCount) {
+  uv_mutex_lock(&mutex);
+  size = threadCount;
+  // Wake parked threads that are back in the pool
+  uv_cond_broadcast(&cond);
+  uv_mutex_unlock(&mutex);
+
+  // Split the cores between the pool's threads and OpenCV's parallel loops
+  cv::setNumThreads(std::max(1, cv::getNumberOfCPUs() / (int) threadCount));
+}
+
+// The span of a task, named after the method that queued it
+static const char* TaskName(OpCounter *counter) {
+  return counter ? counter->name.c_str() : "AsyncWorker";
+}
+
+void ThreadPool::Queue(AsyncBaseWorker *worker) {
+  if (outstanding++ == 0) {
+    uv_ref((uv_handle_t*) &completion);
+  }
+
+  Task task = {worker, NULL, OpStats::Current(), 0, 0};
+  if (task.counter) {
+    task.queuedAt = uv_hrtime();
+  }
+  if (OpTrace::Enabled()) {
+    task.traceId = OpTrace::NewId();
+    OpTrace::Begin(TaskName(task.counter), task.traceId, worker->ImageSize());
+    OpTrace::Begin("queued", task.traceId);
+  }
+
+  uv_mutex_lock(&mutex);
+  // Threads are started on demand and never exit; a shrunk pool parks them.
+  while (threads.size() < size) {
+    uv_thread_t thread;
+    uv_thread_create(&thread, ThreadMain, (void*) (intptr_t) threads.size());
+    threads.push_back(thread);
+  }
+  pending.push_back(task);
+  if (threads.size() > size) {
+    // A parked thread could swallow a signal, so wake everybody
+    uv_cond_broadcast(&cond);
+  } else {
+    uv_cond_signal(&cond);
+  }
+  uv_mutex_unlock(&mutex);
+}
+
+void ThreadPool::ThreadMain(void *arg) {
+  unsigned int index = (unsigned int) (intptr_t) arg;
+
+  uv_mutex_lock(&mutex);
+  for (;;) {
+    while (pending.empty() || index >= size) {
+      uv_cond_wait(&cond, &mutex);
+    }
+
+    Task task = pending.front();
+    pending.pop_front();
+    active++;
+    uv_mutex_unlock(&mutex);
+
+    if (task.job) {
+      task.job->Run();
+    } else if (task.counter || task.traceId) {
+      uint64_t start = uv_hrtime();
+      if (task.traceId) {
+        OpTrace::End("queued", task.traceId);
+        OpTrace::Begin("execute", task.traceId);
+      }
+      task.worker->Execute();
+      if (task.traceId) {
+        OpTrace::End("execute", task.traceId, task.worker->ImageSize());
+      }
+      if (task.counter) {
+        OpStats::RecordRun(task.counter, start - task.queuedAt, uv_hrtime() - start);
+      }
+    } else {
+      task.worker->Execute();
+    }
+
+    uv_mutex_lock(&mutex);
+    active--;
+    if (task.job) {
+      if (--task.job->helpers == 0) {
+        uv_cond_broadcast(&helpersDone);
+      }
+    } else {
+      done.push_back(task);
+      uv_async_send(&completion);
+    }
+  }
+}
+
+void ThreadPool::ParallelFor(ParallelJob &job) {
+  uv_mutex_lock(&mutex);
+  // Helpers go to the front: the caller already holds a thread and is
+  // waiting on them
+  unsigned int helpers = std::min(size - 1, (unsigned int) std::max(job.count - 1, 0));
+  for (unsigned int i = 0; i < helpers; i++) {
+    Task task = {NULL, &job, NULL, 0, 0};
+    pending.push_front(task);
+  }
+  job.helpers = helpers;
+  uv_cond_broadcast(&cond);
+  uv_mutex_unlock(&mutex);
+
+  job.Run();
+
+  uv_mutex_lock(&mutex);
+  for (std::deque<Task>::iterator it = pending.begin(); it != pending.end();) {
+    if (it->job == &job) {
+      it = pending.erase(it);
+      job.helpers--;
+    } else {
+      ++it;
+    }
+  }
+  while (job.helpers > 0) {
+    uv_cond_wait(&helpersDone, &mutex);
+  }
+  uv_mutex_unlock(&mutex);
+}
+
+ParallelJob::ParallelJob(int count) :
+    count(count),
+    next(0),
+    helpers(0) {
+  uv_mutex_init(&mutex);
+}
+
+ParallelJob::~ParallelJob() {
+  uv_mutex_destroy(&mutex);
+}
+
+int ParallelJob::Next() {
+  uv_mutex_lock(&mutex);
+  int item = next < count ? next++ : -1;
+  uv_mutex_unlock(&mutex);
+  return item;
+}
+
+void ParallelJob::SetError(const std::string &message) {
+  uv_mutex_lock(&mutex);
+  if (error.empty()) {
+    error = message;
+  }
+  uv_mutex_unlock(&mutex);
+}
+
+std::string ParallelJob::Error() {
+  uv_mutex_lock(&mutex);
+  std::string message = error;
+  uv_mutex_unlock(&mutex);
+  return message;
+}
+
+// Runs on the main thread. uv_async_send coalesces, so drain everything.
+NAUV_WORK_CB(ThreadPool::Complete) {
+  std::deque<Task> finished;
+
+  uv_mutex_lock(&mutex);
+  finished.swap(done);
+  uv_mutex_unlock(&mutex);
+
+  for (size_t i = 0; i < finished.size(); i++) {
+    Task &task = finished[i];
+    // Results allocated here are charged to the method that queued the work
+    OpCounter *previous = OpStats::SetCurrent(task.counter);
+    if (task.traceId) {
+      OpTrace::Begin("callback", task.traceId);
+    }
+    task.worker->WorkComplete();
+    if (task.traceId) {
+      OpTrace::End("callback", task.traceId);
+      OpTrace::End(TaskName(task.counter), task.traceId);
+    }
+    task.worker->Destroy();
+    OpStats::SetCurrent(previous);
+    completed++;
+    if (--outstanding == 0) {
+      uv_unref((uv_handle_t*) &completion);
+    }
+  }
+}
+
+// cv.setNumThreads(n)
+NAN_METHOD(ThreadPool::SetNumThreads) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 1 || !info[0]->IsNumber() || Nan::To<int64_t>(info[0]).FromJust() < 1) {
+    return Nan::ThrowTypeError("setNumThreads takes a positive number of threads");
+  }
+
+  SetSize(Nan::To<int64_t>(info[0]).FromJust());
+}
+
+NAN_METHOD(ThreadPool::GetNumThreads) {
+  Nan::HandleScope scope;
+
+  uv_mutex_lock(&mutex);
+  unsigned int threadCount = size;
+  uv_mutex_unlock(&mutex);
+
+  info.GetReturnValue().Set(Nan::New<Number>(threadCount));
+}
+
+NAN_METHOD(ThreadPool::GetStats) {
+  Nan::HandleScope scope;
+
+  uv_mutex_lock(&mutex);
+  unsigned int threadCount = size;
+  unsigned int running = active;
+  unsigned int queued = pending.size();
+  uv_mutex_unlock(&mutex);
+
+  Local<Object> res = Nan::New<Object>();
+  Nan::Set(res, Nan::New("threads").ToLocalChecked(), Nan::New<Number>(threadCount));
+  Nan::Set(res, Nan::New("active").ToLocalChecked(), Nan::New<Number>(running));
+  Nan::Set(res, Nan::New("queued").ToLocalChecked(), Nan::New<Number>(queued));
+  Nan::Set(res, Nan::New("completed").ToLocalChecked(), Nan::New<Number>((double) completed));
+  Nan::Set(res, Nan::New("opencvThreads").ToLocalChecked(), Nan::New<Number>(cv::getNumThreads()));
+
+  info.GetReturnValue().Set(res);
+}
@@ -0,0 +1,101 @@
+#include "OpenCV.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+class AsyncBaseWorker;
+struct OpCounter;
+
+// Work on `count` items, shared out by ThreadPool::ParallelFor. Every thread
+// taking part calls Run() once; Run claims item indices with Next() until it
+// returns -1, so per-thread state can live in Run's locals.
+class ParallelJob {
+public:
+  explicit ParallelJob(int count);
+  virtual ~ParallelJob();
+
+  virtual void Run() = 0;
+
+  // The first error a participant reported, or an empty string
+  std::string Error();
+
+protected:
+  int Next();
+  void SetError(const std::string &message);
+
+private:
+  friend class ThreadPool;
+
+  int count;
+  int next;
+  std::string error;
+  uv_mutex_t mutex;
+
+  // Helper threads queued or running, guarded by the pool's mutex
+  unsigned int helpers;
+};
+
+// Worker threads dedicated to node-opencv, so that image work doesn't compete
+// with fs and dns for the libuv threadpool.
+//
+// Workers run `Execute` on one of the pool's threads. Their `WorkComplete`
+// and `Destroy` then run on the main thread, as with Nan::AsyncQueueWorker.
+// While tracing, each worker is an OpTrace span from Queue to the end of its
+// callback.
+// The pool also sets OpenCV's own thread count so that the pool's threads
+// and OpenCV's parallel loops don't oversubscribe the cores together.
+class ThreadPool {
+public:
+  static void Init(Local<Object> target);
+
+  // Takes ownership of the worker. Must be called on the main thread.
+  static void Queue(AsyncBaseWorker *worker);
+
+  // Runs `job` on the calling thread, helped by pool threads that are free,
+  // and returns once every participant is done. Meant for a worker's Execute,
+  // or for short jobs on the main thread; helpers that haven't started by the
+  // time the caller runs out of items are dropped, so a busy pool never holds
+  // the caller up.
+  static void ParallelFor(ParallelJob &job);
+
+  static NAN_METHOD(SetNumThreads);
+  static NAN_METHOD(GetNumThreads);
+  static NAN_METHOD(GetStats);
+
+private:
+  static void SetSize(unsigned int size);
+  static void ThreadMain(void *arg);
+  static NAUV_WORK_CB(Complete);
+
+  static bool initialized;
+  static uv_mutex_t mutex;
+  static uv_cond_t cond;
+  static uv_async_t completion;
+
+  // Threads with an index of `size` or more sleep until the pool grows again
+  static unsigned int size;
+  static std::vector<uv_thread_t> threads;
+
+  // A queued worker, or a helper for a ParallelJob. Workers remember the
+  // method that queued them when stats or tracing are enabled, and their
+  // span's id (or 0) when tracing.
+  struct Task {
+    AsyncBaseWorker *worker;
+    ParallelJob *job;
+    OpCounter *counter;
+    uint64_t queuedAt;
+    uint64_t traceId;
+  };
+
+  static uv_cond_t helpersDone;
+  static std::deque<Task> pending;
+  static std::deque<Task> done;
+
+  // Queued and not yet completed, main thread only
+  static unsigned int outstanding;
+  static unsigned int active;
+  static uint64_t completed;
+};
@@ -1,20 +1,15 @@
 #include "VideoCaptureWrap.h"
 #include "Matrix.h"
+#include "MatrixPool.h"
+#include "FramePrefetcher.h"
+#include "AsyncBaseWorker.h"
 #include "OpenCV.h"
+#include "OpStats.h"
 
 #include  <iostream>
 
 Nan::Persistent<FunctionTemplate> VideoCaptureWrap::constructor;
 
-struct videocapture_baton {
-
-  Nan::Persistent<Function> cb;
-  VideoCaptureWrap *vc;
-  Matrix *im;
-
-  uv_work_t request;
-};
-
 void VideoCaptureWrap::Init(Local<Object> target) {
   Nan::HandleScope scope;
 
@@ -27,18 +22,23 @@ void VideoCaptureWrap::Init(Local<Object> target) {
   // Prototype
   //Local<ObjectTemplate> proto = constructor->PrototypeTemplate();
 
-  Nan::SetPrototypeMethod(ctor, "read", Read);
-  Nan::SetPrototypeMethod(ctor, "setWidth", SetWidth);
-  Nan::SetPrototypeMethod(ctor, "setHeight", SetHeight);
-  Nan::SetPrototypeMethod(ctor, "setPosition", SetPosition);
-  Nan::SetPrototypeMethod(ctor, "getFrameAt", GetFrameAt);
-  Nan::SetPrototypeMethod(ctor, "getFrameCount", GetFrameCount);
-  Nan::SetPrototypeMethod(ctor, "release", Release);
-  Nan::SetPrototypeMethod(ctor, "ReadSync", ReadSync);
-  Nan::SetPrototypeMethod(ctor, "grab", Grab);
-  Nan::SetPrototypeMethod(ctor, "retrieve", Retrieve);
-
-  target->Set(Nan::New("VideoCapture").ToLocalChecked(), ctor->GetFunction());
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.read", Read);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.setWidth", SetWidth);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.setHeight", SetHeight);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.setPosition", SetPosition);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.getFrameAt", GetFrameAt);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.getFrameCount", GetFrameCount);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.release", Release);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.ReadSync", ReadSync);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.grab", Grab);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.retrieve", Retrieve);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.setPool", SetPool);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.startPrefetch", StartPrefetch);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.stopPrefetch", StopPrefetch);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.readLatest", ReadLatest);
+  OpStats::SetPrototypeMethod(ctor, "VideoCapture.queueDepth", QueueDepth);
+
+  Nan::Set(target, Nan::New("VideoCapture").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 }
 
 NAN_METHOD(VideoCaptureWrap::New) {
@@ -50,10 +50,10 @@ NAN_METHOD(VideoCaptureWrap::New) {
   VideoCaptureWrap *v;
 
   if (info[0]->IsNumber()) {
-    v = new VideoCaptureWrap(info[0]->NumberValue());
+    v = new VideoCaptureWrap(Nan::To<double>(info[0]).FromJust());
   } else {
     //TODO - assumes that we have string, verify
-    v = new VideoCaptureWrap(std::string(*Nan::Utf8String(info[0]->ToString())));
+    v = new VideoCaptureWrap(std::string(*Nan::Utf8String(Nan::To<String>(info[0]).ToLocalChecked())));
   }
 
   v->Wrap(info.This());
@@ -61,7 +61,10 @@ NAN_METHOD(VideoCaptureWrap::New) {
   info.GetReturnValue().Set(info.This());
 }
 
-VideoCaptureWrap::VideoCaptureWrap(int device) {
+VideoCaptureWrap::VideoCaptureWrap(int device) :
+    pool(NULL),
+    prefetcher(NULL),
+    pendingReads(0) {
   Nan::HandleScope scope;
   cap.open(device);
 
@@ -70,7 +73,10 @@ VideoCaptureWrap::VideoCaptureWrap(int device) {
   }
 }
 
-VideoCaptureWrap::VideoCaptureWrap(const std::string& filename) {
+VideoCaptureWrap::VideoCaptureWrap(const std::string& filename) :
+    pool(NULL),
+    prefetcher(NULL),
+    pendingReads(0) {
   Nan::HandleScope scope;
   cap.open(filename);
   // TODO! At the moment this only takes a full path - do relative too.
@@ -79,14 +85,36 @@ VideoCaptureWrap::VideoCaptureWrap(const std::string& filename) {
   }
 }
 
+VideoCaptureWrap::~VideoCaptureWrap() {
+  if (prefetcher) {
+    prefetcher->Stop();
+    prefetcher->Unref();
+  }
+  if (pool) {
+    pool->Unref();
+  }
+}
+
+// The capture belongs to the decode thread while prefetching
+static bool ThrowIfPrefetching(VideoCaptureWrap *v) {
+  if (v->prefetcher) {
+    Nan::ThrowError("Not available while prefetching, call stopPrefetch() first");
+    return true;
+  }
+  return false;
+}
+
 NAN_METHOD(VideoCaptureWrap::SetWidth) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+  if (ThrowIfPrefetching(v)) {
+    return;
+  }
 
   if(info.Length() != 1)
   return;
 
-  int w = info[0]->IntegerValue();
+  int w = Nan::To<int64_t>(info[0]).FromJust();
 
   if(v->cap.isOpened())
   v->cap.set(CV_CAP_PROP_FRAME_WIDTH, w);
@@ -97,6 +125,9 @@ NAN_METHOD(VideoCaptureWrap::SetWidth) {
 NAN_METHOD(VideoCaptureWrap::GetFrameCount) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+  if (ThrowIfPrefetching(v)) {
+    return;
+  }
 
   int cnt = int(v->cap.get(CV_CAP_PROP_FRAME_COUNT));
 
@@ -106,11 +137,14 @@ NAN_METHOD(VideoCaptureWrap::GetFrameCount) {
 NAN_METHOD(VideoCaptureWrap::SetHeight) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+  if (ThrowIfPrefetching(v)) {
+    return;
+  }
 
   if(info.Length() != 1)
   return;
 
-  int h = info[0]->IntegerValue();
+  int h = Nan::To<int64_t>(info[0]).FromJust();
 
   v->cap.set(CV_CAP_PROP_FRAME_HEIGHT, h);
 
@@ -120,11 +154,14 @@ NAN_METHOD(VideoCaptureWrap::SetHeight) {
 NAN_METHOD(VideoCaptureWrap::SetPosition) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+  if (ThrowIfPrefetching(v)) {
+    return;
+  }
 
   if(info.Length() != 1)
   return;
 
-  int pos = info[0]->IntegerValue();
+  int pos = Nan::To<int64_t>(info[0]).FromJust();
 
   v->cap.set(CV_CAP_PROP_POS_FRAMES, pos);
 
@@ -134,37 +171,86 @@ NAN_METHOD(VideoCaptureWrap::SetPosition) {
 NAN_METHOD(VideoCaptureWrap::GetFrameAt) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+  if (ThrowIfPrefetching(v)) {
+    return;
+  }
 
   if(info.Length() != 1)
   return;
 
-  int pos = info[0]->IntegerValue();
+  int pos = Nan::To<int64_t>(info[0]).FromJust();
 
   v->cap.set(CV_CAP_PROP_POS_MSEC, pos);
 
   return;
 }
 
+// video.setPool(pool) decodes frames into buffers from a cv.MatrixPool,
+// video.setPool(null) goes back to regular allocations.
+NAN_METHOD(VideoCaptureWrap::SetPool) {
+  Nan::HandleScope scope;
+  VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+
+  PooledAllocator *pool = NULL;
+  if (info.Length() > 0 && Nan::New(MatrixPool::constructor)->HasInstance(info[0])) {
+    pool = Nan::ObjectWrap::Unwrap<MatrixPool>(Nan::To<Object>(info[0]).ToLocalChecked())->allocator;
+    pool->Ref();
+  } else if (info.Length() > 0 && !info[0]->IsNull() && !info[0]->IsUndefined()) {
+    return Nan::ThrowTypeError("Argument 0 must be a MatrixPool or null");
+  }
+
+  if (v->pool) {
+    v->pool->Unref();
+  }
+  v->pool = pool;
+
+  return;
+}
+
 NAN_METHOD(VideoCaptureWrap::Release) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
 
+  if (v->prefetcher) {
+    v->prefetcher->Stop();
+    v->prefetcher->Unref();
+    v->prefetcher = NULL;
+  }
   v->cap.release();
 
   return;
 }
 
-class AsyncVCWorker: public Nan::AsyncWorker {
+class AsyncVCWorker: public AsyncBaseWorker {
 public:
   AsyncVCWorker(Nan::Callback *callback, VideoCaptureWrap* vc,
   bool retrieve = false, int channel = 0) :
-      Nan::AsyncWorker(callback),
+      AsyncBaseWorker(callback),
       vc(vc),
+      pool(vc->pool),
+      prefetcher(retrieve ? NULL : vc->prefetcher),
       retrieve(retrieve),
       channel(channel) {
+    // The capture must outlive the read even if JS drops the VideoCapture
+    SaveToPersistent("capture", vc->handle());
+    if (pool) {
+      pool->Ref();
+      mat.allocator = pool;
+    }
+    if (prefetcher) {
+      prefetcher->Ref();
+    } else {
+      vc->pendingReads++;
+    }
   }
 
   ~AsyncVCWorker() {
+    if (prefetcher) {
+      prefetcher->Unref();
+    }
+    if (pool) {
+      pool->Unref();
+    }
   }
 
   // Executed inside the worker-thread.
@@ -172,39 +258,46 @@ public:
   // here, so everything we need for input and output
   // should go on `this`.
   void Execute() {
-    if (retrieve) {
+    if (prefetcher) {
+      // Waits for the decode thread if it hasn't got a frame ready; at the
+      // end of the video the frame stays empty, as with cap.read.
+      prefetcher->Next(mat);
+    } else if (retrieve) {
       if (!this->vc->cap.retrieve(mat, channel)) {
         SetErrorMessage("retrieve failed");
       }
-      return;
+    } else {
+      this->vc->cap.read(mat);
+    }
+    imageSize = mat.size();
+  }
+
+  // Done with the capture; the callback may start prefetching
+  void WorkComplete() {
+    if (!prefetcher) {
+      vc->pendingReads--;
     }
-    this->vc->cap.read(mat);
+    AsyncBaseWorker::WorkComplete();
   }
 
   // Executed when the async work is complete
   // this function will be run inside the main event loop
   // so it is safe to use V8 again
-  void HandleOKCallback() {
-    Nan::HandleScope scope;
+  Local<Value> Result() {
+    Nan::EscapableHandleScope scope;
 
-    Local<Object> im_to_return= Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+    Local<Object> im_to_return= Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
     Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im_to_return);
     img->mat = mat;
+    img->SyncExternalMemory();
 
-    Local<Value> argv[] = {
-      Nan::Null()
-      , im_to_return
-    };
-
-    Nan::TryCatch try_catch;
-    callback->Call(2, argv);
-    if (try_catch.HasCaught()) {
-      Nan::FatalException(try_catch);
-    }
+    return scope.Escape(im_to_return);
   }
 
 private:
   VideoCaptureWrap *vc;
+  PooledAllocator *pool;
+  FramePrefetcher *prefetcher;
   cv::Mat mat;
   bool retrieve;
   int channel;
@@ -214,36 +307,49 @@ NAN_METHOD(VideoCaptureWrap::Read) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
 
-  REQ_FUN_ARG(0, cb);
+  // Without a callback, read returns a promise
+  OPT_FUN_ARG(0, callback);
 
-  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new AsyncVCWorker(callback, v));
-
-  return;
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(new AsyncVCWorker(callback, v)));
 }
 
 NAN_METHOD(VideoCaptureWrap::ReadSync) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
 
-  Local<Object> im_to_return= Nan::New(Matrix::constructor)->GetFunction()->NewInstance();
+  Local<Object> im_to_return= Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im_to_return);
 
-  v->cap.read(img->mat);
+  if (v->prefetcher) {
+    v->prefetcher->Next(img->mat);
+  } else {
+    if (v->pool) {
+      img->mat.allocator = v->pool;
+    }
+    v->cap.read(img->mat);
+  }
+  img->SyncExternalMemory();
 
   info.GetReturnValue().Set(im_to_return);
 }
 
-class AsyncGrabWorker: public Nan::AsyncWorker {
+class AsyncGrabWorker: public AsyncBaseWorker {
 public:
   AsyncGrabWorker(Nan::Callback *callback, VideoCaptureWrap* vc) :
-      Nan::AsyncWorker(callback),
+      AsyncBaseWorker(callback),
       vc(vc) {
+    SaveToPersistent("capture", vc->handle());
+    vc->pendingReads++;
   }
 
   ~AsyncGrabWorker() {
   }
 
+  void WorkComplete() {
+    vc->pendingReads--;
+    AsyncBaseWorker::WorkComplete();
+  }
+
   void Execute() {
     if (!this->vc->cap.grab()) {
       SetErrorMessage("grab failed");
@@ -257,25 +363,122 @@ private:
 NAN_METHOD(VideoCaptureWrap::Grab) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+  if (ThrowIfPrefetching(v)) {
+    return;
+  }
 
-  REQ_FUN_ARG(0, cb);
-
-  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new AsyncGrabWorker(callback, v));
+  OPT_FUN_ARG(0, callback);
 
-  return;
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(new AsyncGrabWorker(callback, v)));
 }
 
 NAN_METHOD(VideoCaptureWrap::Retrieve) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+  if (ThrowIfPrefetching(v)) {
+    return;
+  }
 
+  // retrieve(callback[, channel]) or, returning a promise, retrieve([channel])
   int channel = 0;
-  REQ_FUN_ARG(0, cb);
-  INT_FROM_ARGS(channel, 1);
+  Nan::Callback *callback = NULL;
+  if (info.Length() > 0 && info[0]->IsFunction()) {
+    callback = new Nan::Callback(info[0].As<Function>());
+    INT_FROM_ARGS(channel, 1);
+  } else if (info.Length() > 0) {
+    INT_FROM_ARGS(channel, 0);
+  }
 
-  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new AsyncVCWorker(callback, v, true, channel));
+  info.GetReturnValue().Set(AsyncBaseWorker::Queue(
+      new AsyncVCWorker(callback, v, true, channel)));
+}
 
-  return;
+// video.startPrefetch({size: 4, policy: 'dropOldest'})
+//
+// Starts decoding up to `size` frames ahead on a background thread. read()
+// then takes the oldest queued frame; readLatest() takes the newest one.
+// With policy 'dropOldest' a full queue discards old frames, with 'block'
+// decoding pauses until frames are read.
+NAN_METHOD(VideoCaptureWrap::StartPrefetch) {
+  Nan::HandleScope scope;
+  VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+
+  if (v->prefetcher) {
+    return Nan::ThrowError("Already prefetching");
+  }
+  // The decode thread would share the capture with them
+  if (v->pendingReads > 0) {
+    return Nan::ThrowError("Reads are still in flight, wait for them before prefetching");
+  }
+  if (!v->cap.isOpened()) {
+    return Nan::ThrowError("Video is not open");
+  }
+
+  int size = 4;
+  bool dropOldest = true;
+  if (info.Length() > 0 && info[0]->IsObject()) {
+    Local<Object> options = Nan::To<Object>(info[0]).ToLocalChecked();
+    if (Nan::Has(options, Nan::New("size").ToLocalChecked()).FromJust()) {
+      size = Nan::To<int64_t>(Nan::Get(options, Nan::New("size").ToLocalChecked()).ToLocalChecked()).FromJust();
+    }
+    if (Nan::Has(options, Nan::New("policy").ToLocalChecked()).FromJust()) {
+      std::string policy(*Nan::Utf8String(Nan::Get(options, Nan::New("policy").ToLocalChecked()).ToLocalChecked()));
+      if (policy == "block") {
+        dropOldest = false;
+      } else if (policy != "dropOldest") {
+        return Nan::ThrowTypeError("policy must be 'dropOldest' or 'block'");
+      }
+    }
+  }
+
+  if (size < 1) {
+    return Nan::ThrowRangeError("size must be at least 1");
+  }
+
+  v->prefetcher = new FramePrefetcher(&v->cap, v->pool, size, dropOldest);
+}
+
+// Stops the decode thread. Frames still queued are dropped.
+NAN_METHOD(VideoCaptureWrap::StopPrefetch) {
+  Nan::HandleScope scope;
+  VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+
+  if (v->prefetcher) {
+    v->prefetcher->Stop();
+    v->prefetcher->Unref();
+    v->prefetcher = NULL;
+  }
+}
+
+// Returns the newest decoded frame, dropping any older ones, or null when no
+// frame is ready. Never waits.
+NAN_METHOD(VideoCaptureWrap::ReadLatest) {
+  Nan::HandleScope scope;
+  VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+
+  if (!v->prefetcher) {
+    return Nan::ThrowError("readLatest needs startPrefetch() first");
+  }
+
+  cv::Mat frame;
+  if (!v->prefetcher->Latest(frame)) {
+    return info.GetReturnValue().Set(Nan::Null());
+  }
+
+  Local<Object> im_to_return= Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
+  Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im_to_return);
+  img->mat = frame;
+  img->SyncExternalMemory();
+
+  info.GetReturnValue().Set(im_to_return);
+}
+
+// Number of decoded frames waiting to be read, 0 when not prefetching
+NAN_METHOD(VideoCaptureWrap::QueueDepth) {
+  Nan::HandleScope scope;
+  VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+
+  size_t depth = v->prefetcher ? v->prefetcher->Depth() : 0;
+
+  info.GetReturnValue().Set(Nan::New<Number>(depth));
 }
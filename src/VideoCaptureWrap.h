@@ -1,8 +1,18 @@
 #include "OpenCV.h"
 
+class PooledAllocator;
+class FramePrefetcher;
+
 class VideoCaptureWrap: public Nan::ObjectWrap {
 public:
   cv::VideoCapture cap;
+  // When set, frames are decoded into buffers from this cv.MatrixPool
+  PooledAllocator *pool;
+  // Set between startPrefetch() and stopPrefetch(); owns `cap` meanwhile
+  FramePrefetcher *prefetcher;
+  // Reads, grabs and retrieves queued on the thread pool that use `cap`
+  // directly. Main thread only.
+  int pendingReads;
 
   static Nan::Persistent<FunctionTemplate> constructor;
   static void Init(Local<Object> target);
@@ -10,6 +20,7 @@ public:
 
   VideoCaptureWrap(const std::string& filename);
   VideoCaptureWrap(int device);
+  ~VideoCaptureWrap();
 
   static NAN_METHOD(Read);
   static NAN_METHOD(ReadSync);
@@ -27,6 +38,14 @@ public:
 
   static NAN_METHOD(GetFrameAt);
 
+  static NAN_METHOD(SetPool);
+
+  // Decoding ahead on a background thread
+  static NAN_METHOD(StartPrefetch);
+  static NAN_METHOD(StopPrefetch);
+  static NAN_METHOD(ReadLatest);
+  static NAN_METHOD(QueueDepth);
+
   // release the stream
   static NAN_METHOD(Release);
 };
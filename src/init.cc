@@ -2,6 +2,11 @@
 
 #include "Point.h"
 #include "Matrix.h"
+#include "MatrixPool.h"
+#include "ThreadPool.h"
+#include "OpStats.h"
+#include "OpTrace.h"
+#include "Pipeline.h"
 #include "CascadeClassifierWrap.h"
 #include "VideoCaptureWrap.h"
 #include "Contours.h"
@@ -18,10 +23,16 @@
 
 extern "C" void init(Local<Object> target) {
   Nan::HandleScope scope;
+  // First, so that every method registered after it is counted
+  OpStats::Init(target);
+  OpTrace::Init();
   OpenCV::Init(target);
+  ThreadPool::Init(target);
 
   Point::Init(target);
   Matrix::Init(target);
+  MatrixPool::Init(target);
+  Pipeline::Init(target);
   CascadeClassifierWrap::Init(target);
   VideoCaptureWrap::Init(target);
   Contour::Init(target);
@@ -99,6 +99,86 @@ test('Matrix accessors', function(assert){
   assert.end()
 })
 
+test('Matrix header properties', function(assert){
+  var mat = new cv.Matrix(6, 7, cv.Constants.CV_8UC3);
+  assert.equal(mat.rows, 6);
+  assert.equal(mat.cols, 7);
+  assert.equal(mat.type, cv.Constants.CV_8UC3);
+  assert.equal(mat.depth, cv.Constants.CV_8U);
+  assert.equal(mat.elemSize, 3);
+  assert.equal(mat.step, 21);
+  assert.equal(mat.total, 42);
+  assert.equal(mat.isContinuous, true);
+
+  mat.rows = 1;
+  assert.equal(mat.rows, 6, "read only");
+
+  mat.resize(8, 9);
+  assert.deepEqual([mat.rows, mat.cols], [9, 8], "follows the data");
+  assert.equal(Object.create(mat).rows, 9, "read through the prototype");
+
+  var roi = new cv.Matrix(6, 7, cv.Constants.CV_8UC3).roi(0, 0, 2, 2);
+  assert.equal(roi.isContinuous, false);
+  assert.equal(roi.step, 21);
+
+  assert.deepEqual(new cv.Matrix(6, 7, cv.Constants.CV_32F).describe(), {
+    rows: 6, cols: 7, type: cv.Constants.CV_32F, depth: cv.Constants.CV_32F,
+    channels: 1, step: 28, isContinuous: true, total: 42, elemSize: 4,
+    empty: false
+  });
+  assert.equal(new cv.Matrix().describe().empty, true);
+  assert.equal(new cv.Matrix(2, 3).inspect(), "[ Matrix 2x3 ]");
+  assert.end()
+})
+
+test('Matrix regions as typed arrays', function(assert){
+  var mat = new cv.Matrix(4, 5, cv.Constants.CV_8UC3, [1, 2, 3]);
+  var region = mat.getRegion([1, 1, 2, 3]);
+  assert.ok(region instanceof Uint8Array);
+  assert.equal(region.length, 2 * 3 * 3);
+  assert.deepEqual(Array.prototype.slice.call(region, 0, 6), [1, 2, 3, 1, 2, 3]);
+  assert.equal(mat.getRegion().length, 4 * 5 * 3, "whole matrix by default");
+
+  for (var i = 0; i < region.length; i++) region[i] = i;
+  mat.setRegion({x: 1, y: 1, width: 2, height: 3}, region);
+  assert.deepEqual(mat.pixel(1, 1), [0, 1, 2]);
+  assert.deepEqual(mat.pixel(3, 2), [15, 16, 17]);
+  assert.deepEqual(mat.pixel(0, 0), [1, 2, 3], "outside the region is untouched");
+
+  // Regions of a sub-matrix skip the parent's padding
+  var roi = mat.roi(1, 1, 2, 3);
+  assert.deepEqual(Array.prototype.slice.call(roi.getRegion()),
+      Array.prototype.slice.call(region));
+
+  var floats = new cv.Matrix(3, 3, cv.Constants.CV_32F);
+  floats.setRegion([0, 0, 3, 3], new Float32Array([0, 1, 2, 3, 4.5, 5, 6, 7, 8]));
+  assert.ok(floats.getRegion() instanceof Float32Array);
+  assert.equal(floats.get(1, 1), 4.5);
+  assert.ok(new cv.Matrix(2, 2, cv.Constants.CV_64F).getRegion() instanceof Float64Array);
+  assert.ok(new cv.Matrix(2, 2, cv.Constants.CV_16UC1).getRegion() instanceof Uint16Array);
+
+  var view = floats.rowData(2);
+  assert.ok(view instanceof Float32Array);
+  assert.deepEqual(Array.prototype.slice.call(view), [6, 7, 8]);
+  view[0] = 60;
+  assert.equal(floats.get(2, 0), 60, "rowData is a view");
+
+  var col = floats.colData(1);
+  assert.deepEqual(Array.prototype.slice.call(col), [1, 4.5, 7]);
+  col[0] = 10;
+  assert.equal(floats.get(0, 1), 1, "colData is a copy");
+
+  assert.throws(function(){ mat.getRegion([3, 0, 3, 1]) }, RangeError);
+  assert.throws(function(){ mat.getRegion([1, 0, 2147483647, 1]) }, RangeError, "no int overflow");
+  assert.throws(function(){ mat.setRegion([0, 1, 1, 2147483647], new Uint8Array(3)) }, RangeError);
+  assert.throws(function(){ mat.getRegion({x: 0, y: 0, height: 1}) }, TypeError, "width is required");
+  assert.throws(function(){ floats.setRegion([0, 0, 3, 3], new Float64Array(9)) }, TypeError);
+  assert.throws(function(){ floats.setRegion([0, 0, 3, 3], new Float32Array(8)) }, RangeError);
+  assert.throws(function(){ floats.rowData(3) }, RangeError);
+  assert.throws(function(){ floats.colData(-1) }, RangeError);
+  assert.end()
+})
+
 test('Matrix functions', function(assert) {
   // convertTo
   var mat = new cv.Matrix(75, 75, cv.Constants.CV_32F, [2.0]);
@@ -136,6 +216,177 @@ test(".norm", function(assert){
   });
 })
 
+test("Matrix getData without copy", function(assert){
+  var mat = new cv.Matrix(2, 3, cv.Constants.CV_8UC3, [1, 2, 3]);
+  var copied = mat.getData();
+  var shared = mat.getData({copy: false});
+
+  assert.equal(shared.length, 2 * 3 * 3);
+  assert.deepEqual(shared, copied);
+
+  // Writes through the shared buffer are visible on the matrix
+  shared[0] = 42;
+  assert.deepEqual(mat.pixel(0, 0), [42, 2, 3]);
+
+  // Later calls view the same memory through the same ArrayBuffer
+  var again = mat.getData({copy: false});
+  assert.equal(again.buffer, shared.buffer);
+  assert.equal(again.byteOffset, shared.byteOffset);
+  assert.equal(again[0], 42);
+  assert.equal(mat.rowData(1).buffer, shared.buffer, "rowData too");
+  assert.end()
+})
+
+test("Matrix fromBuffer", function(assert){
+  var buf = new Buffer([1, 2, 3, 4, 5, 6]);
+
+  var copied = cv.Matrix.fromBuffer(buf, 2, 3, cv.Constants.CV_8UC1);
+  assert.deepEqual(copied.size(), [2, 3]);
+  assert.equal(copied.pixel(1, 2), 6);
+
+  var shared = cv.Matrix.fromBuffer(buf, 2, 3, cv.Constants.CV_8UC1, {copy: false});
+  buf[5] = 60;
+  assert.equal(shared.pixel(1, 2), 60);
+  assert.equal(copied.pixel(1, 2), 6);
+
+  // Views of a shared matrix keep the buffer alive after it is released
+  var crop = (function(){
+    var parent = cv.Matrix.fromBuffer(new Buffer([1, 2, 3, 4, 5, 6]), 2, 3,
+        cv.Constants.CV_8UC1, {copy: false});
+    var view = parent.crop(1, 1, 2, 1);
+    parent.release();
+    return view;
+  })();
+  var data = crop.getData({copy: false});
+  crop.release();
+  if (global.gc) global.gc();
+  assert.deepEqual(Array.prototype.slice.call(data), [5, 6]);
+
+  var floats = new Float32Array([0.5, 1.5]);
+  assert.equal(cv.Matrix.fromBuffer(floats, 1, 2, cv.Constants.CV_32FC1).get(0, 1), 1.5);
+
+  assert.throws(function () {
+    cv.Matrix.fromBuffer(buf, 4, 4, cv.Constants.CV_8UC1);
+  }, RangeError, "buffer too small");
+  assert.end()
+})
+
+test("MatrixPool", function(assert){
+  var pool = new cv.MatrixPool({rows: 4, cols: 5, type: cv.Constants.CV_8UC3, capacity: 2});
+  assert.equal(pool.stats().available, 2);
+
+  var mat = pool.allocate();
+  assert.deepEqual(mat.size(), [4, 5]);
+  assert.equal(pool.stats().available, 1);
+
+  var copy = new cv.Matrix(4, 5, cv.Constants.CV_8UC3, [1, 2, 3]).clone(pool);
+  assert.deepEqual(copy.pixel(3, 4), [1, 2, 3]);
+  assert.equal(pool.stats().available, 0);
+
+  mat.release();
+  copy.release();
+  assert.equal(pool.stats().available, 2);
+  assert.equal(pool.stats().hits, 2);
+  assert.end()
+})
+
+test("readImage options", function(assert){
+  var buf = fs.readFileSync('./examples/files/coin1.jpg')
+
+  cv.readImage(buf, function(err, full){
+    assert.error(err)
+
+    cv.readImage(buf, {grayscale: true, reduce: 2}).then(function(small){
+      assert.equal(small.channels(), 1)
+      assert.equal(small.width(), Math.ceil(full.width() / 2))
+      assert.equal(small.height(), Math.ceil(full.height() / 2))
+      assert.throws(function(){ cv.readImage(buf, {reduce: 3}) })
+
+      return cv.readImage(new Buffer("not an image"))
+    }).then(function(){
+      assert.fail("should not decode")
+      assert.end()
+    }, function(err){
+      assert.ok(err instanceof Error)
+      assert.end()
+    })
+  })
+})
+
+test("readImage with an empty options slot", function(assert){
+  var buf = fs.readFileSync('./examples/files/coin1.jpg')
+
+  var ret = cv.readImage(buf, null, function(err, im){
+    assert.error(err)
+    assert.ok(im.width() > 0)
+    cv.readImages([buf], undefined, function(err, images){
+      assert.error(err)
+      assert.equal(images.length, 1)
+      assert.end()
+    })
+  })
+  assert.equal(ret, undefined, "calls back instead of returning a promise")
+})
+
+test("readImage maxDimension", function(assert){
+  cv.readImage("./examples/files/coin1.jpg", function(err, full){
+    cv.readImage("./examples/files/coin1.jpg", {maxDimension: 100}, function(err, thumb){
+      assert.error(err)
+      assert.equal(Math.max(thumb.width(), thumb.height()), 100)
+      assert.ok(Math.abs(thumb.width() / thumb.height() - full.width() / full.height()) < 0.05)
+
+      var large = Math.max(full.width(), full.height()) * 2
+      cv.readImage(fs.readFileSync("./examples/files/coin1.jpg"), {maxDimension: large}, function(err, im){
+        assert.error(err)
+        assert.deepEqual(im.size(), full.size(), "never scaled up")
+        assert.end()
+      })
+    })
+  })
+})
+
+test("readImage thumbnails have the same channels at any scale", function(assert){
+  cv.readImage("./examples/files/alpha-test.png", {maxDimension: 10}, function(err, thumb){
+    assert.error(err)
+    assert.equal(thumb.channels(), 3, "alpha is dropped")
+
+    // A small grayscale JPEG, decoded both reduced and at full size
+    var gray = new cv.Matrix(30, 40, cv.Constants.CV_8UC1)
+      , jpeg = gray.toBuffer({ext: ".jpg"})
+
+    cv.readImage(jpeg, {maxDimension: 20}).then(function(reduced){
+      assert.equal(reduced.width(), 20)
+      assert.equal(reduced.channels(), 3)
+      return cv.readImage(jpeg, {maxDimension: 100})
+    }).then(function(full){
+      assert.equal(full.width(), 40)
+      assert.equal(full.channels(), 3)
+      return cv.readImage(jpeg)
+    }).then(function(plain){
+      assert.equal(plain.channels(), 1, "plain reads keep the file's channels")
+      assert.end()
+    }, assert.end)
+  })
+})
+
+test("readImages", function(assert){
+  var sources = [
+    fs.readFileSync("./examples/files/coin1.jpg"),
+    new Buffer("not an image"),
+    "./examples/files/mona.png"
+  ]
+
+  cv.readImages(sources, {maxDimension: 100}).then(function(images){
+    assert.equal(images.length, 3)
+    assert.ok(images[0] instanceof cv.Matrix)
+    assert.equal(Math.max(images[0].width(), images[0].height()), 100)
+    assert.ok(images[1] instanceof Error)
+    assert.ok(images[2] instanceof cv.Matrix)
+    assert.throws(function(){ cv.readImages([42]) })
+    assert.end()
+  })
+})
+
 test("Matrix toBuffer", function(assert){
   var buf = fs.readFileSync('./examples/files/mona.png')
 
@@ -172,6 +423,387 @@ test("detectObject", function(assert){
   })
 })
 
+test("Promises", function(assert){
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    im.detectObject(cv.FACE_CASCADE, {})
+      .then(function(faces){
+        assert.equal(faces.length, 1)
+        return im.toBufferAsync({ext: ".png"})
+      })
+      .then(function(buf){
+        assert.ok(Buffer.isBuffer(buf))
+        assert.ok(buf.length > 0)
+        assert.end()
+      }, function(err){
+        assert.error(err)
+        assert.end()
+      })
+  })
+})
+
+test("ThreadPool", function(assert){
+  var threads = cv.getNumThreads()
+  assert.ok(threads >= 1)
+
+  cv.setNumThreads(2)
+  assert.equal(cv.getNumThreads(), 2)
+  assert.throws(function(){ cv.setNumThreads(0) })
+
+  var mat = new cv.Matrix(10, 10)
+  mat.toBufferAsync(function(err, buf){
+    assert.error(err)
+    var stats = cv.getThreadPoolStats()
+    assert.equal(stats.threads, 2)
+    assert.ok(stats.completed >= 1)
+    assert.ok(stats.opencvThreads >= 1)
+    cv.setNumThreads(threads)
+    assert.end()
+  })
+})
+
+test("native stats", function(assert){
+  cv.enableStats()
+  cv.resetStats()
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    assert.error(err)
+    im.clone()
+
+    var stats = cv.stats()
+    assert.equal(stats.readImage.callCount, 1)
+    assert.equal(stats.readImage.runCount, 1)
+    assert.ok(stats.readImage.queuedTotal >= 0)
+    assert.ok(stats.readImage.bytes >= im.width() * im.height() * 3)
+    assert.equal(stats["Matrix.clone"].callCount, 1)
+    assert.ok(stats["Matrix.clone"].callP99 >= stats["Matrix.clone"].callP50)
+    assert.ok(stats["Matrix.clone"].bytes > 0)
+    assert.equal(stats["Matrix.clone"].runCount, undefined)
+
+    cv.enableStats(false)
+    im.clone()
+    assert.equal(cv.stats()["Matrix.clone"].callCount, 1, "not counted when disabled")
+
+    cv.resetStats()
+    assert.equal(cv.stats()["Matrix.clone"], undefined)
+    assert.end()
+  })
+})
+
+test("native stats count allocations", function(assert){
+  var im = new cv.Matrix(40, 30, cv.Constants.CV_8UC3)
+  cv.enableStats()
+  cv.resetStats()
+
+  im.crop(0, 0, 10, 10)
+  assert.equal(cv.stats()["Matrix.crop"].bytes, 0, "views share their parent's data")
+
+  im.convertGrayscale()
+  assert.ok(cv.stats()["Matrix.convertGrayscale"].bytes >= 40 * 30, "in-place ops charge their new buffer")
+
+  im.clone()
+  assert.equal(cv.stats()["Matrix.clone"].bytes, 40 * 30)
+
+  cv.enableStats(false)
+  cv.resetStats()
+  assert.end()
+})
+
+test("async work while tracing", function(assert){
+  var major = parseInt(process.versions.node.split('.')[0], 10)
+  if (major < 12) {
+    assert.skip("tracing needs node 12")
+    return assert.end()
+  }
+
+  var path = require('path')
+    , os = require('os')
+    , child_process = require('child_process')
+    , dir = fs.mkdtempSync(path.join(os.tmpdir(), 'opencv-trace-'))
+    , log = path.join(dir, 'trace.log')
+    , script = "var cv = require(" + JSON.stringify(path.resolve(__dirname, '../lib/opencv')) + ");"
+        + "cv.readImage(" + JSON.stringify(path.resolve(__dirname, '../examples/files/mona.png')) + ","
+        + " function(err, im){ if (err) throw err; im.resizeAsync(50, 50); })"
+
+  var res = child_process.spawnSync(process.execPath, ['--trace-event-categories', 'node.opencv',
+      '--trace-event-file-pattern', log, '-e', script])
+  assert.equal(res.status, 0, String(res.stderr))
+
+  var events = JSON.parse(fs.readFileSync(log)).traceEvents.filter(function(e){
+    return e.cat === 'node.opencv'
+  })
+  fs.unlinkSync(log)
+  fs.rmdirSync(dir)
+
+  function find(name, ph, id){
+    return events.filter(function(e){
+      return e.name === name && e.ph === ph && (id === undefined || e.id === id)
+    })[0]
+  }
+
+  var begin = find('Matrix.resizeAsync', 'b')
+  assert.ok(begin, "a span for the method")
+  assert.ok(find('Matrix.resizeAsync', 'e', begin && begin.id), "the span ends")
+  assert.ok(begin && begin.args.width > 0 && begin.args.height > 0, "tagged with the image size")
+  ;['queued', 'execute', 'callback'].forEach(function(name){
+    var inner = find(name, 'b', begin && begin.id)
+    assert.ok(inner && find(name, 'e', begin.id), name + " span inside it")
+    assert.ok(inner && inner.ts >= begin.ts, name + " starts after the method")
+  })
+  assert.ok(find('readImage', 'b'), "cv functions are traced too")
+  assert.end()
+})
+
+test("pipeline", function(assert){
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    var size = im.size()
+
+    cv.pipeline().convertGrayscale().gaussianBlur([5, 5]).canny(5, 300).dilate(2)
+      .run(im, function(err, edges){
+        assert.error(err)
+        assert.deepEqual(edges.size(), size)
+        assert.equal(edges.channels(), 1)
+        assert.equal(im.channels(), 3, "source is untouched")
+
+        cv.pipeline().convertGrayscale().canny(5, 300).findContours().run(im)
+          .then(function(contours){
+            assert.ok(contours.size() > 0)
+            var unknown = cv.pipeline()
+            unknown.ops.push({name: "sharpen", args: []})
+            assert.throws(function(){ unknown.run(im) })
+            assert.throws(function(){ cv.pipeline().findContours().canny(5, 300).run(im) })
+            assert.end()
+          })
+      })
+  })
+})
+
+test("async image processing", function(assert){
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    var size = im.size()
+    var data = im.getData()
+
+    im.gaussianBlurAsync([5, 5], function(err, blurred){
+      assert.error(err)
+      assert.ok(blurred instanceof cv.Matrix)
+      assert.notEqual(blurred, im, "resolves a new Matrix")
+      assert.deepEqual(blurred.size(), size)
+      assert.ok(im.getData().equals(data), "leaves the matrix untouched")
+
+      im.thresholdAsync(80, 255).then(function(binary){
+        assert.ok(binary instanceof cv.Matrix)
+        assert.notEqual(binary, im)
+        assert.deepEqual(binary.size(), size)
+        assert.throws(function(){ im.medianBlurAsync(4) })
+        assert.end()
+      })
+    })
+  })
+})
+
+test("matchTemplateAsync draws on a copy", function(assert){
+  cv.readImage("./examples/files/car1.jpg", function(err, im){
+    var data = im.getData()
+
+    im.matchTemplateAsync("./examples/files/car1_template.jpg", 3, true).then(function(res){
+      assert.equal(res.length, 6)
+      assert.deepEqual(res.slice(1, 3), [42, 263], "finds the match")
+      assert.ok(res[5] instanceof cv.Matrix)
+      assert.notOk(res[5].getData().equals(data), "the copy has the match drawn on it")
+      assert.ok(im.getData().equals(data), "leaves the matrix untouched")
+      assert.end()
+    }, function(err){
+      assert.error(err)
+      assert.end()
+    })
+  })
+})
+
+test("async work outlives release", function(assert){
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    var size = im.size()
+    var encoding = im.toBufferAsync()
+    var saving = im.saveAsync("./examples/tmp/release.png")
+    var blurring = im.gaussianBlurAsync([5, 5])
+    im.release()
+
+    Promise.all([encoding, saving, blurring]).then(function(results){
+      assert.ok(results[0].length > 0)
+      assert.ok(results[1])
+      assert.deepEqual(results[2].size(), size, "works on the data it started with")
+      assert.notEqual(results[2], im, "result goes to a new Matrix")
+      assert.ok(im.empty(), "the released matrix is left alone")
+      assert.end()
+    }, function(err){
+      assert.error(err)
+      assert.end()
+    })
+  })
+})
+
+test("async work reads a snapshot of the matrix", function(assert){
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    cv.readImage("./examples/files/mona.png", function(err, expected){
+      expected.gaussianBlur([5, 5])
+      // A view of the buffer the blur reads, without copying it
+      var data = im.getData({copy: false})
+      var original = new Buffer(data)
+
+      var blurring = im.gaussianBlurAsync([5, 5])
+      // Sync methods give the matrix a new buffer while the blur runs
+      im.gaussianBlur([15, 15])
+      im.convertGrayscale()
+      assert.ok(data.equals(original), "sync methods leave the shared buffer alone")
+
+      blurring.then(function(result){
+        assert.notEqual(result, im)
+        assert.equal(im.channels(), 1, "the matrix keeps its sync changes")
+        assert.equal(result.channels(), 3)
+        assert.ok(result.getData().equals(expected.getData()), "blurs the data it started with")
+        assert.end()
+      }, function(err){
+        assert.error(err)
+        assert.end()
+      })
+    })
+  })
+})
+
+test("contours as typed arrays", function(assert){
+  cv.readImage("./examples/files/coin1.jpg", function(err, im){
+    im.convertGrayscale()
+    im.canny(5, 300)
+    var contours = im.findContours()
+    assert.ok(contours.size() > 0)
+
+    var all = contours.toTypedArrays()
+    assert.ok(all.points instanceof Int32Array)
+    assert.equal(all.offsets.length, contours.size() + 1)
+    assert.equal(all.hierarchy.length, contours.size() * 4)
+    assert.equal(all.points.length, all.offsets[contours.size()] * 2)
+
+    for (var i = 0; i < contours.size(); i++) {
+      var points = contours.points(i)
+      var buffer = contours.pointsBuffer(i)
+      assert.equal(buffer.length, points.length * 2)
+      assert.equal(all.offsets[i + 1] - all.offsets[i], points.length)
+      if (points.length) {
+        assert.equal(buffer[0], points[0].x)
+        assert.equal(buffer[1], points[0].y)
+        assert.equal(all.points[all.offsets[i] * 2], points[0].x)
+      }
+      assert.deepEqual([].slice.call(all.hierarchy, 4 * i, 4 * i + 4), contours.hierarchy(i))
+    }
+
+    assert.throws(function(){ contours.pointsBuffer(contours.size()) })
+    assert.end()
+  })
+})
+
+test("contours.computeAll", function(assert){
+  cv.readImage("./examples/files/coin1.jpg", function(err, im){
+    im.convertGrayscale()
+    im.canny(5, 300)
+    var contours = im.findContours()
+
+    var all = contours.computeAll({area: true, arcLength: true, bbox: true, minAreaRect: true, isConvex: true})
+    assert.equal(all.count, contours.size())
+    assert.ok(all.area instanceof Float64Array)
+    for (var i = 0; i < all.count; i++) {
+      var bbox = contours.boundingRect(i)
+      assert.equal(all.area[i], contours.area(i))
+      assert.equal(all.arcLength[i], contours.arcLength(i, true))
+      assert.deepEqual([].slice.call(all.bbox, 4 * i, 4 * i + 4), [bbox.x, bbox.y, bbox.width, bbox.height])
+      assert.equal(all.isConvex[i], contours.isConvex(i) ? 1 : 0)
+    }
+
+    var large = contours.computeAll({bbox: true, minArea: 100})
+    assert.equal(large.area, undefined, "only requested metrics")
+    assert.equal(large.bbox.length, large.count * 4)
+    for (var j = 0; j < large.count; j++) {
+      assert.ok(contours.area(large.index[j]) >= 100)
+    }
+
+    assert.throws(function(){ contours.computeAllAsync() })
+    contours.computeAllAsync({area: true, bbox: true, minArea: 100}, function(err, async){
+      assert.error(err)
+      assert.deepEqual(async.index, large.index, "same contours as computeAll")
+      assert.deepEqual(async.bbox, large.bbox)
+      assert.equal(async.area.length, async.count)
+      assert.end()
+    })
+  })
+})
+
+test("binary contour serialization", function(assert){
+  cv.readImage("./examples/files/coin1.jpg", function(err, im){
+    im.convertGrayscale()
+    im.canny(5, 300)
+    var contours = im.findContours()
+
+    var buf = contours.serializeBinary()
+    assert.ok(Buffer.isBuffer(buf))
+    assert.ok(buf.length < JSON.stringify(contours.serialize()).length / 4)
+
+    var restored = new cv.Contours()
+    restored.deserializeBinary(buf)
+    assert.deepEqual(restored.serialize(), contours.serialize())
+
+    assert.throws(function(){ restored.deserializeBinary(new Buffer("not contours")) })
+    assert.throws(function(){ restored.deserializeBinary(buf.slice(0, buf.length - 1)) })
+    assert.deepEqual(restored.serialize(), contours.serialize(), "unchanged after errors")
+    assert.end()
+  })
+})
+
+test("encodeStream", function(assert){
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    var expected = im.toBuffer({ext: ".png"})
+    var chunks = []
+
+    im.encodeStream({ext: ".png", chunkSize: 1024})
+      .on("data", function(chunk){
+        assert.ok(chunk.length <= 1024)
+        chunks.push(chunk)
+      })
+      .on("end", function(){
+        assert.ok(chunks.length > 1)
+        assert.ok(Buffer.concat(chunks).equals(expected))
+        assert.end()
+      })
+  })
+})
+
+test("concurrent detectObject", function(assert){
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    var pending = [0, 1, 2, 3].map(function(){
+      return im.detectObject(cv.FACE_CASCADE, {})
+    })
+    Promise.all(pending).then(function(results){
+      results.forEach(function(faces){
+        assert.equal(faces.length, 1)
+      })
+      assert.end()
+    }, function(err){
+      assert.error(err)
+      assert.end()
+    })
+  })
+})
+
+test("detectMultiScaleBatch", function(assert){
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    var classifier = new cv.CascadeClassifier(cv.FACE_CASCADE)
+    var blank = new cv.Matrix(100, 100)
+
+    classifier.detectMultiScaleBatch([blank, im, im], {}, function(err, found){
+      assert.error(err)
+      assert.ok(found instanceof Int32Array)
+      assert.equal(found.length, 10)
+      assert.deepEqual([found[0], found[5]], [1, 2])
+      assert.end()
+    })
+  })
+})
+
 test(".absDiff and .countNonZero", function(assert){
   cv.readImage("./examples/files/mona.png", function(err, im) {
     cv.readImage("./examples/files/mona.png", function(err, im2){
@@ -267,6 +899,44 @@ test("ImageStream", function(assert){
 })
 
 
+test("VideoStream backpressure", function(assert){
+  var video = new cv.VideoCapture("./examples/files/motion.mov")
+    , stream = video.toStream({highWaterMark: 2})
+    , frames = 0
+    , slow = new (require('stream').Writable)({objectMode: true, highWaterMark: 1})
+
+  slow._write = function(mat, encoding, cb){
+    frames++
+    assert.ok(stream._readableState.length <= 2, "reads no further ahead than highWaterMark")
+    setTimeout(cb, 5)
+  }
+
+  slow.on('finish', function(){
+    assert.ok(frames > 0)
+    assert.end()
+  })
+
+  stream.pipe(slow)
+})
+
+
+test("VideoCapture prefetch waits for reads in flight", function(assert){
+  var video = new cv.VideoCapture("./examples/files/motion.mov")
+
+  video.read(function(err, im){
+    assert.error(err)
+    video.startPrefetch({size: 2})
+    video.read(function(err, im){
+      assert.error(err)
+      assert.ok(im.width() > 0)
+      video.stopPrefetch()
+      video.release()
+      assert.end()
+    })
+  })
+  assert.throws(function(){ video.startPrefetch() }, /in flight/)
+})
+
 test("CamShift", function(assert){
   cv.readImage('./examples/files/coin1.jpg', function(e, im){
     cv.readImage('./examples/files/coin2.jpg', function(e, im2){